@@ -0,0 +1,238 @@
+#include "bmpstreamdecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+BmpStreamDecoder::BmpStreamDecoder(Sink& sink, uint16_t maxWidth, uint16_t maxHeight) :
+  _sink(sink), _maxWidth(maxWidth), _maxHeight(maxHeight)
+{
+}
+
+BmpStreamDecoder::~BmpStreamDecoder()
+{
+  free(_row);
+  free(_ditherRow);
+}
+
+void BmpStreamDecoder::reset()
+{
+  free(_row);
+  free(_ditherRow);
+  _row = nullptr;
+  _ditherRow = nullptr;
+  _dithered = false;
+  _state = BMP_HEADER;
+  _headerNeed = BMP_HEADER_MIN;
+  _pos = 0;
+  _rowFill = 0;
+  _rowIndex = 0;
+  _rows = 0;
+}
+
+void BmpStreamDecoder::reset(uint16_t maxWidth, uint16_t maxHeight)
+{
+  _maxWidth = maxWidth;
+  _maxHeight = maxHeight;
+  reset();
+}
+
+bool BmpStreamDecoder::_fail(const char *reason)
+{
+  printf("BMP NOT SUPPORTED: %s\n", reason);
+  _state = BMP_ERROR;
+  return false;
+}
+
+bool BmpStreamDecoder::_parseHeader()
+{
+  fileSize = _read32(&_header[2]);
+  imageOffset = _read32(&_header[10]);
+  headerSize = _read32(&_header[14]);
+  width = (int32_t)_read32(&_header[18]);
+  height = (int32_t)_read32(&_header[22]);
+  planes = _read16(&_header[26]);
+  depth = _read16(&_header[28]);
+  format = _read32(&_header[30]);
+
+  if (debug) {
+    printf("BMP HEADERS\nfilesize:%d\noffset:%d\nW:%d\nH:%d\nplanes:%d\ndepth:%d\nformat:%d\n",
+           (int)fileSize, (int)imageOffset, (int)width, (int)height, planes, depth, (int)format);
+  }
+  if (_read16(_header) != 0x4D42) return _fail("No BM signature");
+  if (planes != 1 || (format != 0 && format != 3)) return _fail("Only planes==1, format 0 or 3");
+  if (depth != 1 && depth != 4 && depth != 8) return _fail("Only 1, 4, and 8 bits depth are supported");
+  if (headerSize < 40 || width <= 0 || height == 0) return _fail("Wrong header");
+
+  uint32_t colors = _read32(&_header[46]);
+  if (colors == 0 || colors > (1u << depth)) colors = 1 << depth;
+  uint32_t paletteEnd = 14 + headerSize + 4 * colors;
+  if (paletteEnd > BMP_HEADER_MAX || paletteEnd > imageOffset) return _fail("Palette does not fit");
+
+  // Rows are padded to 4 bytes
+  rowSize = ((width * depth + 31) / 32) * 4;
+  // A new file without reset() keeps the buffers of the last one
+  free(_row);
+  _row = (uint8_t*)malloc(rowSize);
+  if (_row == nullptr) return _fail("Could not allocate the row buffer");
+  _rows = (height < 0) ? -height : height;
+  _drawWidth = (width > _maxWidth) ? _maxWidth : width;
+  _headerNeed = paletteEnd;
+  return true;
+}
+
+bool BmpStreamDecoder::_parsePalette()
+{
+  const uint8_t *p = &_header[14 + headerSize];
+  const uint16_t colors = (_headerNeed - 14 - headerSize) / 4;
+  // 1 bit bitmaps are black & white: whitish is decided by brightness
+  const bool color = withColor && depth > 1;
+  bool hasRed = false;
+  for (uint16_t pn = 0; pn < 256; pn++) {
+    if (pn >= colors) {
+      _lut[pn] = black;
+      continue;
+    }
+    uint16_t b = p[0];
+    uint16_t g = p[1];
+    uint16_t r = p[2];
+    p += 4;
+    bool whitish = color ? ((r > 0x80) && (g > 0x80) && (b > 0x80)) : ((r + g + b) > 3 * 0x80);
+    bool colored = (r > 0xF0) || ((g > 0xF0) && (b > 0xF0));  // reddish or yellowish?
+    if (whitish) {
+      _lut[pn] = white;
+    } else if (colored && color) {
+      _lut[pn] = red;
+      hasRed = true;
+    } else {
+      _lut[pn] = black;
+    }
+    if (debug) printf("0x00%02x%02x%02x : %x\n", r, g, b, _lut[pn]);
+  }
+
+  _dithered = dither != nullptr && dither->target != DITHER_7COLOR && depth > 1 && !hasRed;
+  if (_dithered) {
+    free(_ditherRow);
+    _ditherRow = (uint8_t*)malloc(2 * _drawWidth);
+    if (_ditherRow == nullptr || !dither->begin(_drawWidth)) return _fail("Could not allocate the dither rows");
+    // Same weights as Dither for RGB rows
+    p = &_header[14 + headerSize];
+    for (uint16_t pn = 0; pn < colors; pn++, p += 4) {
+      _lut[pn] = (p[2] * 77 + p[1] * 150 + p[0] * 29) >> 8;
+    }
+  }
+  _rowBitsDirect = depth == 1 && _lut[0] == black && _lut[1] == white;
+  _rowBitsInvert = depth == 1 && _lut[0] == white && _lut[1] == black;
+  return true;
+}
+
+void BmpStreamDecoder::_decodeRow(const uint8_t *src)
+{
+  // Bottom-up unless height is negative
+  uint32_t y = (height > 0) ? _rows - 1 - _rowIndex : _rowIndex;
+  if (y >= _maxHeight) return;
+
+  if (_rowBitsDirect || _rowBitsInvert) {
+    const uint8_t *bits = src;
+    if (_rowBitsInvert) {
+      for (uint16_t i = 0; i < (_drawWidth + 7) / 8; ++i) _row[i] = ~src[i];
+      bits = _row;
+    }
+    if (_sink.drawRowBits(y, bits, _drawWidth)) return;
+    // src may be inverted in place already
+    for (uint16_t x = 0; x < _drawWidth; ++x) {
+      _sink.drawPixel(x, y, (bits[x / 8] & (0x80 >> x % 8)) ? white : black);
+    }
+    return;
+  }
+
+  const uint8_t mask = (1 << depth) - 1;
+  if (_dithered) {
+    uint8_t *gray = _ditherRow;
+    uint8_t *out = _ditherRow + _drawWidth;
+    for (uint16_t x = 0; x < _drawWidth; ++x) {
+      uint32_t bit = (uint32_t)x * depth;
+      gray[x] = _lut[(src[bit / 8] >> (8 - depth - bit % 8)) & mask];
+    }
+    if (dither->target == DITHER_BW) {
+      dither->grayRowBits(gray, out);
+      if (_sink.drawRowBits(y, out, _drawWidth)) return;
+      for (uint16_t x = 0; x < _drawWidth; ++x) {
+        _sink.drawPixel(x, y, (out[x / 8] & (0x80 >> x % 8)) ? white : black);
+      }
+      return;
+    }
+    dither->grayRow(gray, out);
+    for (uint16_t x = 0; x < _drawWidth; ++x) _sink.drawPixel(x, y, dither->gray(out[x]));
+    return;
+  }
+
+  for (uint16_t x = 0; x < _drawWidth; ++x) {
+    uint32_t bit = (uint32_t)x * depth;
+    uint8_t index = (src[bit / 8] >> (8 - depth - bit % 8)) & mask;
+    _sink.drawPixel(x, y, _lut[index]);
+  }
+}
+
+bool BmpStreamDecoder::write(const uint8_t *data, size_t len)
+{
+  while (len) {
+    uint32_t n;
+    switch (_state) {
+      case BMP_HEADER:
+        n = _headerNeed - _pos;
+        if (n > len) n = len;
+        memcpy(&_header[_pos], data, n);
+        _pos += n;
+        data += n;
+        len -= n;
+        if (_pos < _headerNeed) return true;
+        // First the fixed fields, that tell how long the palette is
+        if (_headerNeed == BMP_HEADER_MIN && !_parseHeader()) return false;
+        if (_pos == _headerNeed) {
+          if (!_parsePalette()) return false;
+          _state = BMP_SKIP;
+          _sink.begin(*this);
+        }
+        break;
+
+      case BMP_SKIP:
+        n = imageOffset - _pos;
+        if (n > len) n = len;
+        _pos += n;
+        data += n;
+        len -= n;
+        if (_pos == imageOffset) _state = BMP_PIXELS;
+        break;
+
+      case BMP_PIXELS:
+        if (_rowFill == 0 && len >= rowSize) {
+          // Whole row in this chunk: no copy
+          _decodeRow(data);
+          n = rowSize;
+        } else {
+          n = rowSize - _rowFill;
+          if (n > len) n = len;
+          memcpy(&_row[_rowFill], data, n);
+          _rowFill += n;
+          if (_rowFill < rowSize) {
+            _pos += n;
+            return true;
+          }
+          _decodeRow(_row);
+          _rowFill = 0;
+        }
+        _pos += n;
+        data += n;
+        len -= n;
+        if (++_rowIndex == _rows) _state = BMP_DONE;
+        break;
+
+      case BMP_DONE:
+        return true;
+
+      case BMP_ERROR:
+        return false;
+    }
+  }
+  return _state != BMP_ERROR;
+}
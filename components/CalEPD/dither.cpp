@@ -0,0 +1,298 @@
+#include "dither.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Same order as the Epd7Color indexes (color/wave7colors.h)
+const uint8_t Dither::palette7Color[21] = {
+  0, 0, 0,  255, 255, 255,  0, 255, 0,  0, 0, 255,  255, 0, 0,  255, 255, 0,  255, 165, 0
+};
+
+// 8x8 Bayer matrix as 8 bit thresholds: rank * 4 + 2
+const uint8_t Dither::_bayer8[64] = {
+    2, 130,  34, 162,  10, 138,  42, 170,
+  194,  66, 226,  98, 202,  74, 234, 106,
+   50, 178,  18, 146,  58, 186,  26, 154,
+  242, 114, 210,  82, 250, 122, 218,  90,
+   14, 142,  46, 174,   6, 134,  38, 166,
+  206,  78, 238, 110, 198,  70, 230, 102,
+   62, 190,  30, 158,  54, 182,  22, 150,
+  254, 126, 222,  94, 246, 118, 214,  86,
+};
+
+// 32x32 blue noise, void and cluster with sigma 1.5 on a torus so it tiles. Rank / 4 as 8 bit thresholds
+const uint8_t Dither::_blueNoise[1024] = {
+  211, 144, 220, 169, 247, 142, 176, 240, 118, 162,   9, 252,  33, 196,  65, 244, 172,  52, 188,  32,  88, 201, 137,  23, 168, 147, 208,  40, 154, 230, 137,   2,
+  104,  29, 125,  86,  37, 109, 215,  73,  26, 201,  59, 145,  75, 167,  18, 141,  83,   4, 237, 148,  56, 246, 106, 222,  46,  90,  21, 176, 112,  30, 182,  63,
+  252, 185,  70, 228, 197,  13, 155,  50, 132, 222, 104, 180, 121, 231,  98, 199, 221, 120,  99, 217, 176,  15, 155,  66, 186, 124, 226,  68, 241,  81, 218, 122,
+   49, 158,  18, 150,  56, 179,  91, 251, 185,  79,  40, 240,  13,  48, 156,  33,  58, 166,  21,  68, 124,  42, 215,  97, 253,  14, 141, 200,   6, 135, 167,  15,
+  232, 203, 106, 245, 133, 209, 119,  22, 163,   1, 150, 195,  89, 215, 116, 242, 187, 136, 252, 201,  89, 184, 134,  30, 165,  58,  86, 160, 104,  54, 194,  93,
+   74, 130,  42,  88,   5,  76,  43, 220, 105, 236, 128,  65, 172, 138,  73,   7, 105,  79,  44, 144,   0, 231,  72, 204, 113, 193, 231,  28, 211, 244,  33, 146,
+  175,  23, 193, 217, 174, 241, 147, 191,  57,  87, 209,  31, 255,  19, 207, 160, 234,  26, 171, 208, 108, 158,  49, 239,   6, 150,  44, 122, 174,  85, 117, 213,
+  255,  66, 111, 142,  57, 100,  28, 126, 178,  15, 157, 113,  53,  94, 185,  45, 124, 219,  97,  61, 245,  24, 120, 177,  81, 102, 249,  71,  16, 155,  60,   1,
+   94, 161, 226,  14, 166, 229, 199,  70, 250,  46, 224, 196, 147, 229, 117,  67, 148, 188,  11, 133, 180,  77, 199, 143,  34, 208, 181, 132, 216, 189, 228, 140,
+  202,  29, 128,  82,  46, 119,   7,  90, 163, 137,  99,  69,  27, 174,   2, 245,  34,  82, 238,  46, 218,  99,   9, 222,  63, 156,  11,  51,  93,  31, 111,  43,
+  236,  62, 192, 249, 178, 205, 151, 233,  35, 190,  11, 241, 129,  79, 198, 103, 212, 167, 112, 149,  30, 163, 250, 129,  95, 238, 112, 225, 144, 247,  77, 168,
+   14, 107, 145,  37, 100,  66,  20, 114, 214,  61, 110, 165, 206,  36, 157, 134,  16,  55, 196,  69, 204, 116,  55,  38, 178,  23, 192,  69, 164,   5, 186, 131,
+   87, 207, 172,   4, 225, 135, 243, 167,  80, 133, 227,  49,  89, 247,  59, 223,  92, 253, 130,   5, 233,  86, 188, 143, 213,  83, 136,  41, 211, 121,  55, 221,
+   22, 241,  70, 114, 191,  86,  54,  31, 200,   4, 151, 186,  17, 118, 181,  25, 150,  40, 176, 101, 157,  20, 242,  72,   1, 159, 254,  96,  22, 237, 102, 155,
+  181,  52, 139, 162,  41, 213, 148, 178,  95, 254,  38, 104, 234, 140,  78, 205, 111, 235,  78, 219,  47, 126, 169, 106, 230,  51, 118, 203, 173,  74, 194,  38,
+  123,  98, 228,  24, 249, 103,  17, 234, 117,  67, 211, 166,  57, 217,   3, 160,  62, 189,  12, 141, 195,  64, 207,  39, 131, 190,  27,  61, 147,  10, 137, 251,
+  203,   9, 173,  81, 126, 186,  72, 138,  47, 183, 128,  84,  27, 175,  99, 248,  35, 123, 170,  32, 250,  95,  10, 221,  87, 171, 239, 109, 208, 225,  91,  56,
+   77, 220, 146,  48, 205,   1, 161, 207,  25, 225,   8, 148, 242, 117,  45, 143, 214,  91, 231,  71, 114, 162, 182, 144,  67,  19, 154,  84,  44, 121,  25, 165,
+  115,  34, 184, 106, 227,  60,  97, 244,  80, 156, 102, 197,  63, 210, 184,  74,  16, 199,  47, 136, 206,  24,  53, 246, 105, 227, 197,   3, 244, 151, 190, 232,
+  139,  64, 255,  19, 134, 174,  39, 122, 187,  53, 232,  36,  90,  12, 131, 235, 165, 109, 154,   0, 237,  88, 122, 195,  37, 125,  57, 135, 179,  69, 101,   6,
+  171, 210,  93, 159,  75, 238, 200, 145,  11, 110, 171, 136, 248, 159, 100,  33,  58, 255,  82, 190,  64, 158, 217,   8,  80, 169, 212,  94,  32, 218,  48, 243,
+   20, 120,  43, 194,   6, 108,  29,  70, 251, 204,  24,  76, 187,  49, 216, 197, 127, 182,  26, 223, 112,  32, 138, 180, 238, 149,  18, 253, 116, 160, 202,  84,
+  187,  59, 235, 130, 215, 153, 224,  91, 159,  60, 125, 220,   2, 114,  80, 152,  10,  97, 143,  50, 170, 247,  96,  52, 111,  71,  44, 191,  79,  12, 128, 146,
+  219, 105, 168,  28,  85,  54, 119, 181,  39, 229,  98, 153, 175, 240,  30, 226,  67, 236, 204, 121,   7,  75, 189,  21, 202, 229, 141, 172, 227,  61, 239,  39,
+    0, 149,  71, 248, 183, 206,  16, 242, 138,   8, 192,  42,  65, 139, 202, 120, 164,  35,  78, 179, 214, 146, 224, 129, 158,   2,  92, 123,  26, 109, 177,  95,
+  243, 192,  19, 125, 102,  38, 161,  73, 108, 213,  83, 253, 108,  15,  88,  50, 188, 110, 250,  18, 101,  54,  34,  87, 251,  41, 212,  55, 198, 153, 209,  74,
+  115,  51, 221, 154,  63, 233, 133, 198,  52, 168,  25, 184, 151, 224, 170, 243,   4, 152,  62, 127, 161, 240, 180, 118,  65, 169, 132, 232,  82,   8,  43, 134,
+   27, 173,  89, 200,   5, 177,  84,  13, 246, 145, 119,  60, 209,  35,  73, 135,  96, 201, 219,  31, 193,  72,   9, 218, 196,  98,  17, 179, 113, 252, 163, 216,
+   68, 237, 139,  42, 254, 116, 216, 103,  37, 223,  92,   0, 130, 101, 195,  23, 233,  45,  85, 142, 234,  93, 152,  28, 140,  53, 239,  36, 142,  58,  90, 189,
+  152,  10, 110,  77, 162,  29,  59, 153, 173,  68, 193, 235, 164, 246,  56, 177, 115, 156, 182,  20, 113,  48, 175, 248, 107, 212, 157,  78, 203, 223,  22, 123,
+   40, 228, 183, 205, 131, 230, 194, 127, 210,  21, 140,  47,  81,  14, 149, 222,  76,  12, 254,  64, 206, 226, 126,  41,  83,   3, 185, 127,  13, 170, 107, 245,
+  166,  92,  51,  17,  66,  96,   3,  45,  85, 230, 100, 183, 124, 214, 107,  36, 129, 210, 103, 132, 164,   7,  75, 191, 236, 115,  62, 249,  94,  50, 198,  76,
+};
+
+static inline uint8_t clamp8(int16_t v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// Same weights as the epdimage tool: 0.30 R, 0.59 G, 0.11 B
+static inline uint8_t luma(const uint8_t *rgb)
+{
+  return (rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8;
+}
+
+uint8_t Dither::levels()
+{
+  switch (target) {
+    case DITHER_4GRAY: return 4;
+    case DITHER_16GRAY: return 16;
+    case DITHER_7COLOR: return paletteSize;
+    default: return 2;
+  }
+}
+
+// Gray to level tables, rebuilt only when the target or the threshold change
+void Dither::_tables()
+{
+  if (_tablesFor == target && _tablesThreshold == threshold) return;
+  _tablesFor = target;
+  _tablesThreshold = threshold;
+  const uint8_t max = (target == DITHER_7COLOR) ? 1 : levels() - 1;
+  for (uint8_t l = 0; l <= max; ++l) _levelGray[l] = l * 255 / max;
+  for (uint16_t v = 0; v < 256; ++v) {
+    _quant[v] = (max == 1) ? v > threshold : (v * max + 127) / 255;
+    _base[v] = v * max / 255;
+    _frac[v] = v * max % 255;
+  }
+}
+
+bool Dither::_diffuse()
+{
+  return _err != nullptr && (mode == DITHER_FLOYD_STEINBERG || mode == DITHER_ATKINSON);
+}
+
+bool Dither::begin(uint16_t width)
+{
+  end();
+  _tables();
+  _width = width;
+  _y = 0;
+  _channels = (target == DITHER_7COLOR) ? 3 : 1;
+  if (mode != DITHER_FLOYD_STEINBERG && mode != DITHER_ATKINSON) return true;
+  const uint32_t rowLen = (width + 4) * _channels;
+  _err = (int16_t*)calloc(3 * rowLen, sizeof(int16_t));
+  if (_err == nullptr) return false;
+  for (uint8_t r = 0; r < 3; ++r) _rows[r] = _err + r * rowLen;
+  return true;
+}
+
+void Dither::end()
+{
+  free(_err);
+  _err = nullptr;
+}
+
+// Threshold row of the ordered modes. Error diffusion without error rows ends here too
+const uint8_t *Dither::_ordered(uint16_t y, uint8_t &mask)
+{
+  if (mode == DITHER_BLUE_NOISE) {
+    mask = 31;
+    return &_blueNoise[(y & 31) * 32];
+  }
+  mask = 7;
+  return &_bayer8[(y & 7) * 8];
+}
+
+uint8_t Dither::_nearest(int16_t r, int16_t g, int16_t b)
+{
+  uint8_t best = 0;
+  int32_t bestDistance = INT32_MAX;
+  const uint8_t *p = palette;
+  for (uint8_t i = 0; i < paletteSize; ++i, p += 3) {
+    int32_t dr = r - p[0];
+    int32_t dg = g - p[1];
+    int32_t db = b - p[2];
+    int32_t distance = dr * dr + dg * dg + db * db;
+    if (distance < bestDistance) {
+      bestDistance = distance;
+      best = i;
+    }
+  }
+  return best;
+}
+
+void Dither::_nextRow()
+{
+  if (_err != nullptr) {
+    int16_t *done = _rows[0];
+    _rows[0] = _rows[1];
+    _rows[1] = _rows[2];
+    _rows[2] = done;
+    memset(done, 0, (_width + 4) * _channels * sizeof(int16_t));
+  }
+  ++_y;
+}
+
+void Dither::_grayRow(const uint8_t *src, uint8_t stride, uint8_t *out, uint8_t *bits)
+{
+  const bool diffuse = _diffuse();
+  const bool atkinson = mode == DITHER_ATKINSON;
+  const int dir = (serpentine && (_y & 1)) ? -1 : 1;
+  // Errors in 1/16 of a gray step. Index 0 is the first pixel, there are 2 of padding at each side
+  int16_t *cur = diffuse ? _rows[0] + 2 : nullptr;
+  int16_t *next = diffuse ? _rows[1] + 2 : nullptr;
+  int16_t *next2 = diffuse ? _rows[2] + 2 : nullptr;
+  uint8_t mask;
+  const uint8_t *ordered = _ordered(_y, mask);
+  if (bits) memset(bits, 0, (_width + 7) / 8);
+
+  for (uint16_t i = 0; i < _width; ++i) {
+    const int x = (dir > 0) ? i : _width - 1 - i;
+    uint8_t v = (stride == 1) ? src[x] : luma(&src[x * 3]);
+    uint8_t level;
+    if (diffuse) {
+      v = clamp8(v + ((cur[x] + 8) >> 4));
+      level = _quant[v];
+      const int16_t e = v - _levelGray[level];
+      if (atkinson) {
+        const int16_t e8 = e * 2;
+        cur[x + dir] += e8;
+        cur[x + 2 * dir] += e8;
+        next[x - dir] += e8;
+        next[x] += e8;
+        next[x + dir] += e8;
+        next2[x] += e8;
+      } else {
+        cur[x + dir] += e * 7;
+        next[x - dir] += e * 3;
+        next[x] += e * 5;
+        next[x + dir] += e;
+      }
+    } else if (mode == DITHER_NONE) {
+      level = _quant[v];
+    } else {
+      level = _base[v] + (_frac[v] > ordered[x & mask]);
+    }
+    if (bits) {
+      if (_levelGray[level] & 0x80) bits[x / 8] |= 0x80 >> (x & 7);
+    } else {
+      out[x] = level;
+    }
+  }
+  _nextRow();
+}
+
+void Dither::_colorRow(const uint8_t *src, uint8_t stride, uint8_t *out)
+{
+  const bool diffuse = _diffuse();
+  const bool atkinson = mode == DITHER_ATKINSON;
+  const int dir = (serpentine && (_y & 1)) ? -1 : 1;
+  // Grays are sent as 3 equal channels
+  const uint8_t g = (stride == 3) ? 1 : 0;
+  const uint8_t b = (stride == 3) ? 2 : 0;
+  int16_t *cur = diffuse ? _rows[0] + 6 : nullptr;
+  int16_t *next = diffuse ? _rows[1] + 6 : nullptr;
+  int16_t *next2 = diffuse ? _rows[2] + 6 : nullptr;
+  uint8_t mask;
+  const uint8_t *ordered = _ordered(_y, mask);
+
+  for (uint16_t i = 0; i < _width; ++i) {
+    const int x = (dir > 0) ? i : _width - 1 - i;
+    const uint8_t *p = &src[x * stride];
+    int16_t want[3] = { p[0], p[g], p[b] };
+    if (diffuse) {
+      int16_t *e = &cur[x * 3];
+      for (uint8_t c = 0; c < 3; ++c) want[c] = clamp8(want[c] + ((e[c] + 8) >> 4));
+    } else if (mode != DITHER_NONE) {
+      // The widest spread that still keeps the palette colors themselves, yellow and orange are close
+      const int16_t offset = (ordered[x & mask] - 128) / 3;
+      for (uint8_t c = 0; c < 3; ++c) want[c] += offset;
+    }
+    const uint8_t best = _nearest(want[0], want[1], want[2]);
+    out[x] = best;
+    if (!diffuse) continue;
+
+    const uint8_t *color = &palette[best * 3];
+    const int d = dir * 3;
+    for (uint8_t c = 0; c < 3; ++c) {
+      const int16_t e = want[c] - color[c];
+      const int xc = x * 3 + c;
+      if (atkinson) {
+        const int16_t e8 = e * 2;
+        cur[xc + d] += e8;
+        cur[xc + 2 * d] += e8;
+        next[xc - d] += e8;
+        next[xc] += e8;
+        next[xc + d] += e8;
+        next2[xc] += e8;
+      } else {
+        cur[xc + d] += e * 7;
+        next[xc - d] += e * 3;
+        next[xc] += e * 5;
+        next[xc + d] += e;
+      }
+    }
+  }
+  _nextRow();
+}
+
+void Dither::grayRow(const uint8_t *gray, uint8_t *out)
+{
+  if (target == DITHER_7COLOR) {
+    _colorRow(gray, 1, out);
+  } else {
+    _grayRow(gray, 1, out, nullptr);
+  }
+}
+
+void Dither::rgbRow(const uint8_t *rgb, uint8_t *out)
+{
+  if (target == DITHER_7COLOR) {
+    _colorRow(rgb, 3, out);
+  } else {
+    _grayRow(rgb, 3, out, nullptr);
+  }
+}
+
+void Dither::grayRowBits(const uint8_t *gray, uint8_t *bits)
+{
+  _grayRow(gray, 1, nullptr, bits);
+}
+
+uint8_t Dither::pixel(uint8_t gray, uint16_t x, uint16_t y)
+{
+  _tables();
+  uint8_t mask;
+  const uint8_t *ordered = _ordered(y, mask);
+  if (target == DITHER_7COLOR) {
+    const int16_t want = gray + ((mode == DITHER_NONE) ? 0 : (ordered[x & mask] - 128) / 3);
+    return _nearest(want, want, want);
+  }
+  if (mode == DITHER_NONE) return _quant[gray];
+  return _base[gray] + (_frac[gray] > ordered[x & mask]);
+}
@@ -3,6 +3,9 @@
 #include <stdlib.h>
 #include "esp_log.h"
 #include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include <gdew_colors.h>
+#include <epdretain.h>
 
 // display.print / println handling
 // TODO: Implement printf
@@ -95,6 +98,376 @@ void Epd::newline() {
   write(10);
 }
 
+void Epd::updateAsync() {
+  waitForRefresh();
+  _refresh_async = true;
+  update();
+  _refresh_async = false;
+}
+
+bool Epd::drawPaged(void (*draw)(void *arg), void *arg) {
+  uint32_t rowBytes = _pageRowBytes();
+  if (!rowBytes) {
+    if (debug_enabled) printf("drawPaged: not supported. Drawing full buffer\n");
+    draw(arg);
+    update();
+    return true;
+  }
+  // Smaller bands when the heap is short: more draw() calls but it still works
+  uint16_t rows = (HEIGHT + EPD_PAGE_BANDS - 1) / EPD_PAGE_BANDS;
+  uint8_t *band = (uint8_t*)heap_caps_malloc(rowBytes * rows, MALLOC_CAP_8BIT);
+  while (band == NULL && rows > 1) {
+    rows /= 2;
+    band = (uint8_t*)heap_caps_malloc(rowBytes * rows, MALLOC_CAP_8BIT);
+  }
+  if (band == NULL) {
+    printf("drawPaged: no RAM for a %d bytes band\n", rowBytes);
+    return false;
+  }
+  if (debug_enabled) printf("drawPaged: bands of %d rows\n", rows);
+  waitForRefresh();
+  _dirtyClear();
+  _pageStart();
+  _page_buffer = band;
+  for (uint16_t y = 0; y < HEIGHT; y += rows) {
+    _page_y = y;
+    _page_rows = (HEIGHT - y < rows) ? HEIGHT - y : rows;
+    draw(arg);
+    _pageSend();
+  }
+  _page_rows = 0;
+  _page_buffer = nullptr;
+  free(band);
+  _pageFinish();
+  return true;
+}
+
+bool Epd::beginRawWrite() {
+  if (!_rawRowBytes()) return false;
+  waitForRefresh();
+  _rawStart();
+  _raw_writing = true;
+  return true;
+}
+
+void Epd::writeRawRow(uint16_t y, const uint8_t *row) {
+  if (!_raw_writing || y >= HEIGHT) return;
+  _rawRow(y, row);
+}
+
+void Epd::endRawWrite() {
+  if (!_raw_writing) return;
+  _raw_writing = false;
+  _rawFinish();
+}
+
+void Epd::cancelRawWrite() {
+  if (!_raw_writing) return;
+  _raw_writing = false;
+  _powerDown();
+}
+
+void Epd::updateRetained() {
+  uint32_t rowBytes = 0;
+  const uint8_t *buffer = _retainBuffer(rowBytes);
+  if (buffer == nullptr) {
+    update();
+    return;
+  }
+  waitForRefresh();
+  uint8_t *row = (uint8_t*)malloc(rowBytes);
+  if (row == nullptr || !EpdRetain::valid(WIDTH, HEIGHT, rowBytes) || EpdRetain::partials() >= EPD_RETAIN_FULL_EVERY) {
+    free(row);
+    _refresh_force_full = true;
+    update();
+    EpdRetain::store(buffer, WIDTH, HEIGHT, rowBytes, true);
+    return;
+  }
+  // Rows that differ from the image on the panel
+  int32_t y0 = -1;
+  int32_t y1 = -1;
+  EpdRetain changed;
+  for (uint16_t y = 0; y < HEIGHT; ++y) {
+    changed.readRow(row);
+    if (memcmp(row, &buffer[y * rowBytes], rowBytes) == 0) continue;
+    if (y0 < 0) y0 = y;
+    y1 = y;
+  }
+  _dirtyClear();
+  if (y0 < 0) {
+    free(row);
+    if (debug_enabled) printf("updateRetained: no changes\n");
+    return;
+  }
+  if (debug_enabled) printf("updateRetained: rows %d to %d, %d partial refreshes\n", y0, y1, EpdRetain::partials() + 1);
+
+  _retainStart(y0, y1);
+  EpdRetain old;
+  for (uint16_t y = 0; y < HEIGHT; ++y) {
+    old.readRow(row);
+    _retainOldRow(y, row);
+  }
+  free(row);
+  _retainFinish(y0, y1);
+  EpdRetain::store(buffer, WIDTH, HEIGHT, rowBytes, false);
+}
+
+void Epd::waitForRefresh() {
+  if (!_refresh_pending) return;
+  _refresh_pending = false;
+  _waitBusy("waitForRefresh");
+  _powerDown();
+}
+
+uint8_t Epd::_nextRefreshMode(bool oldImage, uint8_t fastest) {
+  uint8_t mode = (_refresh_mode > fastest) ? fastest : _refresh_mode;
+  if (mode == EPD_REFRESH_PARTIAL && !oldImage) mode = EPD_REFRESH_FULL;
+  if (mode != EPD_REFRESH_FULL && (_refresh_force_full ||
+      (_refresh_full_every && _refresh_count >= _refresh_full_every))) {
+    mode = EPD_REFRESH_FULL;
+  }
+  _refresh_force_full = false;
+  _refresh_count = (mode == EPD_REFRESH_FULL) ? 0 : _refresh_count + 1;
+  return mode;
+}
+
+int8_t Epd::temperature() {
+  int8_t t = _temperature_callback ? _temperature_callback(_temperature_arg) : _readTemperature();
+  if (t != EPD_TEMPERATURE_UNKNOWN) _temperature = t;
+  return t;
+}
+
+const epd_temperature_band* Epd::_temperatureBand(const epd_temperature_band *bands, int8_t temp) {
+  if (temp == EPD_TEMPERATURE_UNKNOWN) return nullptr;
+  while (temp > bands->maxTemperature) ++bands;
+  return bands;
+}
+
+void Epd::_powerUp(bool reinit) {
+  _powerLock();
+  _power_busy = true;
+  if (_idle_timer) esp_timer_stop(_idle_timer);
+  if (reinit || _power_state == EPD_POWER_OFF || _power_state == EPD_POWER_DEEP_SLEEP ||
+      (_power_state == EPD_POWER_INITIALIZED && !_panelPowerOn())) {
+    _wakeUp();
+  }
+  _power_state = EPD_POWER_ON;
+  _powerUnlock();
+}
+
+void Epd::_powerDown() {
+  _powerLock();
+  if (_power_hold) {
+    // Stays on
+  } else if (_idle_timeout) {
+    if (_panelPowerOff()) _power_state = EPD_POWER_INITIALIZED;
+    _idleStart();
+  } else {
+    _sleep();
+    _power_state = EPD_POWER_DEEP_SLEEP;
+  }
+  _power_busy = false;
+  _powerUnlock();
+}
+
+void Epd::_powerIdle() {
+  _powerLock();
+  if (_idle_timeout && !_power_hold) _idleStart();
+  _power_busy = false;
+  _powerUnlock();
+}
+
+void Epd::_idleStart() {
+  esp_timer_stop(_idle_timer);
+  _idle_deadline = esp_timer_get_time() + (int64_t)_idle_timeout * 1000;
+  esp_timer_start_once(_idle_timer, (uint64_t)_idle_timeout * 1000);
+}
+
+void Epd::_idleTimerCallback(void *arg) {
+  xTaskNotifyGive(((Epd*)arg)->_idle_task);
+}
+
+void Epd::_idleTask(void *arg) {
+  Epd *epd = (Epd*)arg;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    epd->_powerLock();
+    // An update may have run, or the timeout changed, while this task waited for the lock
+    if (!epd->_power_busy && !epd->_power_hold && epd->_idle_timeout &&
+        esp_timer_get_time() >= epd->_idle_deadline && epd->_power_state != EPD_POWER_DEEP_SLEEP) {
+      epd->_sleep();
+      epd->_power_state = EPD_POWER_DEEP_SLEEP;
+      if (epd->debug_enabled) printf("Epd idle timeout: deep sleep\n");
+    }
+    epd->_powerUnlock();
+  }
+}
+
+void Epd::setIdleTimeout(uint32_t ms) {
+  if (ms && _idle_timer == nullptr) {
+    if (_power_lock == nullptr) _power_lock = xSemaphoreCreateMutex();
+    // Stack for _sleep(): SPI commands, BUSY wait and printf
+    if (_power_lock && _idle_task == nullptr) xTaskCreate(_idleTask, "epd_idle", 3072, this, 1, &_idle_task);
+    esp_timer_create_args_t args = {};
+    args.callback = &Epd::_idleTimerCallback;
+    args.arg = this;
+    args.name = "epd_idle";
+    if (_power_lock == nullptr || _idle_task == nullptr || esp_timer_create(&args, &_idle_timer) != ESP_OK) {
+      printf("Epd: could not create the idle timer\n");
+      return;
+    }
+  }
+  _idle_timeout = ms;
+  if (ms == 0 && _idle_timer) esp_timer_stop(_idle_timer);
+}
+
+void Epd::release() {
+  waitForRefresh();
+  _powerLock();
+  _power_hold = false;
+  if (_idle_timer) esp_timer_stop(_idle_timer);
+  if (!_power_busy && (_power_state == EPD_POWER_ON || _power_state == EPD_POWER_INITIALIZED)) {
+    _sleep();
+    _power_state = EPD_POWER_DEEP_SLEEP;
+  }
+  _powerUnlock();
+}
+
+void Epd::_dirtyRect(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  // Grow a rectangle that is near. Otherwise take a free one or grow the one that gets less extra area
+  uint8_t best = 0;
+  int32_t bestGrow = INT32_MAX;
+  for (uint8_t i = 0; i < _dirty_count; ++i) {
+    epd_rect &r = _dirty[i];
+    int16_t nx0 = gx_uint16_min(r.x0, x0), ny0 = gx_uint16_min(r.y0, y0);
+    int16_t nx1 = gx_uint16_max(r.x1, x1), ny1 = gx_uint16_max(r.y1, y1);
+    if (x0 >= r.x0 - EPD_DIRTY_MERGE && x1 <= r.x1 + EPD_DIRTY_MERGE &&
+        y0 >= r.y0 - EPD_DIRTY_MERGE && y1 <= r.y1 + EPD_DIRTY_MERGE) {
+      r = {nx0, ny0, nx1, ny1};
+      _dirty_last = i;
+      return;
+    }
+    int32_t grow = (int32_t)(nx1 - nx0 + 1) * (ny1 - ny0 + 1) - (int32_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+    if (grow < bestGrow) {
+      bestGrow = grow;
+      best = i;
+    }
+  }
+  if (_dirty_count < EPD_DIRTY_RECTS) {
+    _dirty[_dirty_count] = {x0, y0, x1, y1};
+    _dirty_last = _dirty_count++;
+    return;
+  }
+  epd_rect &r = _dirty[best];
+  r = {(int16_t)gx_uint16_min(r.x0, x0), (int16_t)gx_uint16_min(r.y0, y0),
+       (int16_t)gx_uint16_max(r.x1, x1), (int16_t)gx_uint16_max(r.y1, y1)};
+  _dirty_last = best;
+}
+
+bool Epd::_clip(int16_t& x, int16_t& y, int16_t& w, int16_t& h) {
+  if (x < 0) { w += x; x = 0; }
+  if (y < 0) { h += y; y = 0; }
+  if (x + w > width()) w = width() - x;
+  if (y + h > height()) h = height() - y;
+  return w > 0 && h > 0;
+}
+
+void Epd::_dirtySpan(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (!_dirty_tracking || !_clip(x, y, w, h)) return;
+  _dirtyRect(x, y, x + w - 1, y + h - 1);
+}
+
+// Span primitives: clip once, mark dirty once and let the model write whole bytes.
+// Models without _fillSpan() go through the GFX per pixel path
+void Epd::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  int16_t w = 1;
+  if (!_clip(x, y, w, h)) return;
+  if (_dirty_tracking) _dirtyRect(x, y, x, y + h - 1);
+  if (!_fillSpan(x, y, 1, h, color)) Adafruit_GFX::drawFastVLine(x, y, h, color);
+}
+
+void Epd::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  int16_t h = 1;
+  if (!_clip(x, y, w, h)) return;
+  if (_dirty_tracking) _dirtyRect(x, y, x + w - 1, y);
+  if (!_fillSpan(x, y, w, 1, color)) Adafruit_GFX::drawFastHLine(x, y, w, color);
+}
+
+void Epd::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (!_clip(x, y, w, h)) return;
+  if (_dirty_tracking) _dirtyRect(x, y, x + w - 1, y + h - 1);
+  if (!_fillSpan(x, y, w, h, color)) Adafruit_GFX::fillRect(x, y, w, h, color);
+}
+
+void Epd::writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) {
+  if (y < 0 || y >= height() || w == 0) return;
+  if (w > width()) w = width();
+  if (_dirty_tracking) _dirtyRect(0, y, w - 1, y);
+  if (_writeRowBits(y, bits, w)) return;
+  for (uint16_t x = 0; x < w; ++x) {
+    drawPixel(x, y, (bits[x / 8] & (0x80 >> x % 8)) ? EPD_WHITE : EPD_BLACK);
+  }
+}
+
+void Epd::setRotation(uint8_t r) {
+  uint8_t previous = getRotation();
+  Adafruit_GFX::setRotation(r);
+  if (_dirty_count && getRotation() != previous) {
+    _dirtyClear();
+    _dirtySpan(0, 0, width(), height());
+  }
+}
+
+void Epd::_updateStart(uint8_t mode) {
+  _dirtyClear();
+  if (mode == EPD_REFRESH_FULL) {
+    _ghost.cleanAll();
+  } else {
+    _ghost.partial(0, 0, width(), height());
+  }
+}
+
+void Epd::updateDirty() {
+  if (!_dirty_tracking) {
+    update();
+    return;
+  }
+  if (_dirty_count == 0) return;
+  int32_t area = 0;
+  for (uint8_t i = 0; i < _dirty_count; ++i) {
+    area += (int32_t)(_dirty[i].x1 - _dirty[i].x0 + 1) * (_dirty[i].y1 - _dirty[i].y0 + 1);
+  }
+  if (area * 100 > (int32_t)width() * height() * EPD_DIRTY_FULL_PERCENT) {
+    if (debug_enabled) printf("updateDirty: %d px changed, full update\n", area);
+    update();
+    return;
+  }
+  // Copy since updateWindow() may end calling update() that clears the list
+  epd_rect dirty[EPD_DIRTY_RECTS];
+  uint8_t count = _dirty_count;
+  memcpy(dirty, _dirty, sizeof(dirty));
+  _dirtyClear();
+  if (_ghost.budget) {
+    // GFX coordinates: a rotation that swaps them starts a new map
+    if (_ghost.width() != width() || _ghost.height() != height()) _ghost.begin(width(), height());
+    bool over = false;
+    for (uint8_t i = 0; i < count; ++i) {
+      if (_ghost.partial(dirty[i].x0, dirty[i].y0, dirty[i].x1 - dirty[i].x0 + 1, dirty[i].y1 - dirty[i].y0 + 1)) over = true;
+    }
+    if (over) {
+      if (debug_enabled) printf("updateDirty: ghosting budget spent, full update\n");
+      _refresh_force_full = true;
+      update();
+      return;
+    }
+  }
+  for (uint8_t i = 0; i < count; ++i) {
+    if (debug_enabled) printf("updateDirty: window x:%d y:%d w:%d h:%d\n",
+      dirty[i].x0, dirty[i].y0, dirty[i].x1 - dirty[i].x0 + 1, dirty[i].y1 - dirty[i].y0 + 1);
+    updateWindow(dirty[i].x0, dirty[i].y0, dirty[i].x1 - dirty[i].x0 + 1, dirty[i].y1 - dirty[i].y0 + 1, true);
+  }
+}
+
 /* 
   // Optionally if we would need to access GFX
   // Adafruit_GFX::setTextColor(color);
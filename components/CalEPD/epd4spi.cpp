@@ -1,9 +1,14 @@
 /* SPI Master IO class */
 #include <epd4spi.h>
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "soc/rtc_wdt.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 #ifdef CONFIG_IDF_TARGET_ESP32
     #define EPD_HOST    HSPI_HOST
@@ -24,6 +29,27 @@ __________
 -----------
 */
 
+static void IRAM_ATTR epd4spi_cs_level(uint8_t csMask, uint32_t level)
+{
+    if (csMask & EPD4SPI_M1) gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_M1_CS, level);
+    if (csMask & EPD4SPI_S1) gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_S1_CS, level);
+    if (csMask & EPD4SPI_M2) gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_M2_CS, level);
+    if (csMask & EPD4SPI_S2) gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_S2_CS, level);
+}
+
+/* Queued transactions carry the CS mask in t->user. Polling ones leave it at 0
+ * and keep toggling CS by hand, so the callbacks do nothing for them
+ */
+static void IRAM_ATTR epd4spi_pre_transfer(spi_transaction_t *t)
+{
+    epd4spi_cs_level((uint8_t)(intptr_t)t->user, 0);
+}
+
+static void IRAM_ATTR epd4spi_post_transfer(spi_transaction_t *t)
+{
+    epd4spi_cs_level((uint8_t)(intptr_t)t->user, 1);
+}
+
 void Epd4Spi::init(uint8_t frequency=4,bool debug=false){
     debug_enabled = debug;
     printf("PIN SETUP:\nSPI_M1_CS:%d <- all set as output GPIOs\nSPI_S1_CS:%d\nSPI_M2_CS:%d\nSPI_S2_CS:%d\n",
@@ -85,9 +111,12 @@ void Epd4Spi::init(uint8_t frequency=4,bool debug=false){
         .clock_speed_hz=frequency*multiplier*1000,  // DEBUG: 50000 - No debug usually 4 Mhz
         .input_delay_ns=0,
         .flags = (SPI_DEVICE_HALFDUPLEX | SPI_DEVICE_3WIRE),
-        .queue_size=5
+        .queue_size=EPD4SPI_QUEUE_SIZE,
+        .pre_cb=epd4spi_pre_transfer,
+        .post_cb=epd4spi_post_transfer
     };
     // Note: .spics_io_num=-1 is disabled since there are 4 Chip selects
+    //       ESP32 hosts have only 3 hardware CS so they are set in pre_cb/post_cb for queued transfers
 
     ret=spi_bus_initialize(EPD_HOST, &buscfg, DMA_CHAN);
     ESP_ERROR_CHECK(ret);
@@ -113,6 +142,7 @@ void Epd4Spi::data(const uint8_t data) {
 /* M1 */
 void Epd4Spi::cmdM1(const uint8_t cmd)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
         printf("M1C %x\n",cmd);
     }
@@ -134,6 +164,7 @@ void Epd4Spi::cmdM1(const uint8_t cmd)
 
 void Epd4Spi::dataM1(uint8_t data)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
       printf("D %x\n",data);
     }
@@ -151,6 +182,7 @@ void Epd4Spi::dataM1(uint8_t data)
 /* S1 */
 void Epd4Spi::cmdS1(const uint8_t cmd)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
         printf("S1C %x\n",cmd);
     }
@@ -172,6 +204,7 @@ void Epd4Spi::cmdS1(const uint8_t cmd)
 
 void Epd4Spi::dataS1(uint8_t data)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
       printf("D %x\n",data);
     }
@@ -189,6 +222,7 @@ void Epd4Spi::dataS1(uint8_t data)
 /* M2 */
 void Epd4Spi::cmdM2(const uint8_t cmd)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
         printf("M2C %x\n",cmd);
     }
@@ -210,6 +244,7 @@ void Epd4Spi::cmdM2(const uint8_t cmd)
 
 void Epd4Spi::dataM2(uint8_t data)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
       printf("D %x\n",data);
     }
@@ -227,6 +262,7 @@ void Epd4Spi::dataM2(uint8_t data)
 /* S2 */
 void Epd4Spi::cmdS2(const uint8_t cmd)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
         printf("S2C %x\n",cmd);
     }
@@ -248,6 +284,7 @@ void Epd4Spi::cmdS2(const uint8_t cmd)
 
 void Epd4Spi::dataS2(uint8_t data)
 {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
       printf("D %x\n",data);
     }
@@ -264,6 +301,7 @@ void Epd4Spi::dataS2(uint8_t data)
 
 // Send a command to all 4 displays
 void Epd4Spi::cmdM1S1M2S2(uint8_t cmd) {
+    if (_queueInFlight) queueEnd();
     if (debug_enabled) {
         printf("All4 C %x\n",cmd);
     }
@@ -293,6 +331,7 @@ void Epd4Spi::cmdM1S1M2S2(uint8_t cmd) {
 // Send data to the 4 displays
 void Epd4Spi::dataM1S1M2S2(uint8_t data)
 {
+    if (_queueInFlight) queueEnd();
     /* if (debug_enabled) {
       printf("D %x\n",data);
     } */
@@ -327,6 +366,7 @@ void Epd4Spi::data(const uint8_t *data, int len)
  */
 void Epd4Spi::dataM1(const uint8_t *data, int len)
 {
+    if (_queueInFlight) queueEnd();
     if (len==0) return;
     gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_M1_CS, 0);
     esp_err_t ret;
@@ -340,6 +380,7 @@ void Epd4Spi::dataM1(const uint8_t *data, int len)
 }
 void Epd4Spi::dataM2(const uint8_t *data, int len)
 {
+    if (_queueInFlight) queueEnd();
     if (len==0) return;
     gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_M2_CS, 0);
     esp_err_t ret;
@@ -353,6 +394,7 @@ void Epd4Spi::dataM2(const uint8_t *data, int len)
 }
 void Epd4Spi::dataS1(const uint8_t *data, int len)
 {
+    if (_queueInFlight) queueEnd();
     if (len==0) return;
     gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_S1_CS, 0);
     esp_err_t ret;
@@ -366,6 +408,7 @@ void Epd4Spi::dataS1(const uint8_t *data, int len)
 }
 void Epd4Spi::dataS2(const uint8_t *data, int len)
 {
+    if (_queueInFlight) queueEnd();
     if (len==0) return;
     gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_S2_CS, 0);
     esp_err_t ret;
@@ -386,3 +429,113 @@ void Epd4Spi::reset(uint8_t millis=20) {
     gpio_set_level((gpio_num_t)CONFIG_EINK_M2S2_RST, 1);
     vTaskDelay(millis / portTICK_RATE_MS);
 }
+
+static inline uint32_t epd4spi_pin_level(uint32_t in, uint32_t in1, int pin)
+{
+    return (pin < 32) ? (in >> pin) & 1 : (in1 >> (pin - 32)) & 1;
+}
+
+/* Reads the 4 BUSY lines from the GPIO input registers at once instead of
+ * calling gpio_get_level() per controller
+ */
+uint8_t Epd4Spi::readBusy()
+{
+    uint32_t in = REG_READ(GPIO_IN_REG);
+#ifdef GPIO_IN1_REG
+    uint32_t in1 = REG_READ(GPIO_IN1_REG);
+#else
+    uint32_t in1 = 0;
+#endif
+    uint8_t busy = 0;
+    if (!epd4spi_pin_level(in, in1, CONFIG_EINK_SPI_M1_BUSY)) busy |= EPD4SPI_M1;
+    if (!epd4spi_pin_level(in, in1, CONFIG_EINK_SPI_S1_BUSY)) busy |= EPD4SPI_S1;
+    if (!epd4spi_pin_level(in, in1, CONFIG_EINK_SPI_M2_BUSY)) busy |= EPD4SPI_M2;
+    if (!epd4spi_pin_level(in, in1, CONFIG_EINK_SPI_S2_BUSY)) busy |= EPD4SPI_S2;
+    return busy;
+}
+
+bool Epd4Spi::waitBusy(uint8_t mask, uint32_t timeoutMs)
+{
+    int64_t start = esp_timer_get_time();
+    uint8_t busy;
+    while ((busy = readBusy() & mask) != 0) {
+        // Same as Waveshare reference: GET STATUS while waiting
+        cmdM1(0x71);
+        vTaskDelay(1);
+        if (esp_timer_get_time() - start > (int64_t)timeoutMs * 1000) {
+            if (debug_enabled) printf("Epd4Spi::waitBusy timeout. Still busy mask:%x\n", busy);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Sends the same byte len times. CS stays low for all the controllers in csMask
+ * and a single DMA buffer is transmitted in EPD4SPI_FILL_CHUNK blocks
+ */
+void Epd4Spi::dataFill(uint8_t csMask, uint8_t value, uint32_t len)
+{
+    if (_queueInFlight) queueEnd();
+    if (len==0) return;
+    uint32_t chunk = (len < EPD4SPI_FILL_CHUNK) ? len : EPD4SPI_FILL_CHUNK;
+    uint8_t *fillBuf = (uint8_t*)heap_caps_malloc(chunk, MALLOC_CAP_DMA);
+    assert(fillBuf!=NULL);
+    memset(fillBuf, value, chunk);
+
+    esp_err_t ret;
+    spi_transaction_t t;
+    epd4spi_cs_level(csMask, 0);
+    while (len) {
+        uint32_t n = (len < chunk) ? len : chunk;
+        memset(&t, 0, sizeof(t));
+        t.length=n*8;
+        t.tx_buffer=fillBuf;
+        ret=spi_device_polling_transmit(spi, &t);
+        assert(ret==ESP_OK);
+        len -= n;
+    }
+    epd4spi_cs_level(csMask, 1);
+    free(fillBuf);
+}
+
+
+/* Copies the row into one of EPD4SPI_QUEUE_SIZE DMA slots and queues it. Returns
+ * as soon as it is queued so the caller can prepare the next row while this one
+ * is on the wire. Only waits when all slots are in flight
+ */
+void Epd4Spi::queueData(uint8_t csMask, const uint8_t *data, int len)
+{
+    if (len==0) return;
+    assert(len <= EPD4SPI_QUEUE_SLOT);
+    esp_err_t ret;
+    if (_queueBuf[_queueIdx] == NULL) {
+        _queueBuf[_queueIdx] = (uint8_t*)heap_caps_malloc(EPD4SPI_QUEUE_SLOT, MALLOC_CAP_DMA);
+        assert(_queueBuf[_queueIdx]!=NULL);
+    }
+    if (_queueInFlight == EPD4SPI_QUEUE_SIZE) {
+        spi_transaction_t *rt;
+        ret=spi_device_get_trans_result(spi, &rt, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        --_queueInFlight;
+    }
+    memcpy(_queueBuf[_queueIdx], data, len);
+    spi_transaction_t *t = &_queueTrans[_queueIdx];
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length=len*8;
+    t->tx_buffer=_queueBuf[_queueIdx];
+    t->user=(void*)(intptr_t)csMask;
+    ret=spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret==ESP_OK);
+    ++_queueInFlight;
+    _queueIdx = (_queueIdx+1) % EPD4SPI_QUEUE_SIZE;
+}
+
+void Epd4Spi::queueEnd()
+{
+    spi_transaction_t *rt;
+    while (_queueInFlight) {
+        esp_err_t ret=spi_device_get_trans_result(spi, &rt, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        --_queueInFlight;
+    }
+}
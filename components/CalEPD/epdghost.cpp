@@ -0,0 +1,88 @@
+#include "epdghost.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool EpdGhostMap::begin(uint16_t width, uint16_t height)
+{
+  end();
+  if (tile == 0) tile = EPD_GHOST_TILE;
+  _width = width;
+  _height = height;
+  _cols = (width + tile - 1) / tile;
+  _rows = (height + tile - 1) / tile;
+  _count = (uint8_t*)calloc((size_t)_cols * _rows, 1);
+  if (_count == nullptr) {
+    printf("EpdGhostMap: could not allocate %d tiles\n", _cols * _rows);
+    return false;
+  }
+  return true;
+}
+
+void EpdGhostMap::end()
+{
+  free(_count);
+  _count = nullptr;
+  // Callers begin() it again when width() is 0, with the new budget and tile
+  _width = _height = 0;
+  _cols = _rows = 0;
+}
+
+bool EpdGhostMap::partial(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+  if (_count == nullptr || budget == 0 || w == 0 || h == 0 || x >= _width || y >= _height) return false;
+  uint16_t c1 = (x + w - 1) / tile;
+  uint16_t r1 = (y + h - 1) / tile;
+  if (c1 >= _cols) c1 = _cols - 1;
+  if (r1 >= _rows) r1 = _rows - 1;
+  bool over = false;
+  for (uint16_t r = y / tile; r <= r1; ++r) {
+    uint8_t *count = &_count[r * _cols];
+    for (uint16_t c = x / tile; c <= c1; ++c) {
+      if (count[c] < 255) count[c]++;
+      if (count[c] > budget) over = true;
+    }
+  }
+  return over;
+}
+
+bool EpdGhostMap::overBudget(uint16_t &x, uint16_t &y, uint16_t &w, uint16_t &h)
+{
+  if (_count == nullptr || budget == 0) return false;
+  uint16_t c0 = _cols, r0 = _rows, c1 = 0, r1 = 0;
+  for (uint16_t r = 0; r < _rows; ++r) {
+    for (uint16_t c = 0; c < _cols; ++c) {
+      if (_count[r * _cols + c] <= budget) continue;
+      if (c < c0) c0 = c;
+      if (c > c1) c1 = c;
+      if (r < r0) r0 = r;
+      r1 = r;
+    }
+  }
+  if (c0 == _cols) return false;
+  x = c0 * tile;
+  y = r0 * tile;
+  w = ((c1 + 1) * tile > _width) ? _width - x : (c1 + 1) * tile - x;
+  h = ((r1 + 1) * tile > _height) ? _height - y : (r1 + 1) * tile - y;
+  return true;
+}
+
+void EpdGhostMap::clean(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+  if (_count == nullptr || w == 0 || h == 0) return;
+  // Tiles fully inside. The last ones may be cut by the screen edge
+  uint32_t xe = (uint32_t)x + w;
+  uint32_t ye = (uint32_t)y + h;
+  uint16_t c0 = (x + tile - 1) / tile;
+  uint16_t r0 = (y + tile - 1) / tile;
+  uint16_t c1 = (xe >= _width) ? _cols : xe / tile;
+  uint16_t r1 = (ye >= _height) ? _rows : ye / tile;
+  for (uint16_t r = r0; r < r1; ++r) {
+    for (uint16_t c = c0; c < c1; ++c) _count[r * _cols + c] = 0;
+  }
+}
+
+void EpdGhostMap::cleanAll()
+{
+  if (_count) memset(_count, 0, (size_t)_cols * _rows);
+}
@@ -0,0 +1,234 @@
+#include "epdimagedecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+EpdImageDecoder::EpdImageDecoder(Sink& sink, uint16_t maxWidth, uint16_t maxHeight) :
+  _sink(sink), _maxWidth(maxWidth), _maxHeight(maxHeight)
+{
+}
+
+EpdImageDecoder::~EpdImageDecoder()
+{
+  free(_row);
+}
+
+bool EpdImageDecoder::isEpdImage(const uint8_t *data, size_t len)
+{
+  return len >= 4 && memcmp(data, "EPDI", 4) == 0;
+}
+
+void EpdImageDecoder::reset()
+{
+  free(_row);
+  _row = nullptr;
+  _state = EPDI_HEADER;
+  _pos = 0;
+  _rowFill = 0;
+  _y = 0;
+  _count = 0;
+  _repeat = false;
+  _repeatByte = false;
+}
+
+void EpdImageDecoder::reset(uint16_t maxWidth, uint16_t maxHeight)
+{
+  _maxWidth = maxWidth;
+  _maxHeight = maxHeight;
+  reset();
+}
+
+bool EpdImageDecoder::_fail(const char *reason)
+{
+  printf("EPDI NOT SUPPORTED: %s\n", reason);
+  _state = EPDI_ERROR;
+  return false;
+}
+
+uint8_t EpdImageDecoder::bpp()
+{
+  switch (format) {
+    case EPDI_2BPP_GRAY: return 2;
+    case EPDI_4BPP_GRAY:
+    case EPDI_7COLOR: return 4;
+    default: return 1;
+  }
+}
+
+bool EpdImageDecoder::_parseHeader()
+{
+  version = _header[4];
+  format = _header[5];
+  flags = _header[6];
+  width = _read16(&_header[8]);
+  height = _read16(&_header[10]);
+  payloadSize = _header[12] | (_header[13] << 8) | (_header[14] << 16) | ((uint32_t)_header[15] << 24);
+
+  if (debug) {
+    printf("EPDI HEADER\nversion:%d\nformat:%x\nflags:%x\nW:%d\nH:%d\npayload:%d\n",
+           version, format, flags, width, height, (int)payloadSize);
+  }
+  if (!isEpdImage(_header, EPDI_HEADER_SIZE)) return _fail("No EPDI signature");
+  if (version != EPDI_VERSION) return _fail("Unknown version");
+  if (format != EPDI_1BPP && format != EPDI_2BPP_GRAY && format != EPDI_4BPP_GRAY &&
+      format != EPDI_3COLOR && format != EPDI_7COLOR) return _fail("Unknown format");
+  if (width == 0 || height == 0) return _fail("Wrong header");
+
+  rowSize = ((uint32_t)width * bpp() + 7) / 8;
+  if (format == EPDI_3COLOR) rowSize *= 2;
+  free(_row);
+  _row = (uint8_t*)malloc(rowSize);
+  if (_row == nullptr) return _fail("Could not allocate the row buffer");
+  _drawWidth = (width > _maxWidth) ? _maxWidth : width;
+  return true;
+}
+
+uint8_t EpdImageDecoder::_pixel(const uint8_t *src, uint16_t x, uint8_t bpp)
+{
+  uint32_t bit = (uint32_t)x * bpp;
+  uint8_t shift = (flags & EPDI_LSB_FIRST) ? bit % 8 : 8 - bpp - bit % 8;
+  return (src[bit / 8] >> shift) & ((1 << bpp) - 1);
+}
+
+void EpdImageDecoder::_decodeRow(const uint8_t *src)
+{
+  const uint16_t y = _y;
+  if (y >= _maxHeight) return;
+  const uint32_t planeSize = (_drawWidth + 7) / 8;
+
+  switch (format) {
+    case EPDI_3COLOR:
+      {
+        // Rows without color are sent as black & white bits
+        const uint8_t *plane = src + rowSize / 2;
+        uint32_t i = 0;
+        while (i < planeSize && plane[i] == 0) ++i;
+        if (i < planeSize) {
+          for (uint16_t x = 0; x < _drawWidth; ++x) {
+            uint16_t color = _pixel(plane, x, 1) ? red : (_pixel(src, x, 1) ? white : black);
+            _sink.drawPixel(x, y, color);
+          }
+          return;
+        }
+      }
+      // Fall through
+    case EPDI_1BPP:
+      if (flags & EPDI_LSB_FIRST) {
+        // Bit order to MSB first. LSB first rows are always copied to _row
+        uint8_t *bits = (uint8_t*)src;
+        for (uint32_t i = 0; i < planeSize; ++i) {
+          uint8_t b = bits[i];
+          b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+          b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+          bits[i] = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+        }
+      }
+      if (_sink.drawRowBits(y, src, _drawWidth)) return;
+      for (uint16_t x = 0; x < _drawWidth; ++x) {
+        _sink.drawPixel(x, y, (src[x / 8] & (0x80 >> x % 8)) ? white : black);
+      }
+      return;
+
+    case EPDI_7COLOR:
+      for (uint16_t x = 0; x < _drawWidth; ++x) {
+        _sink.drawPixel(x, y, colors7[_pixel(src, x, 4) & 7]);
+      }
+      return;
+
+    default:
+      {
+        const uint8_t depth = bpp();
+        const uint8_t max = (1 << depth) - 1;
+        for (uint16_t x = 0; x < _drawWidth; ++x) {
+          _sink.drawPixel(x, y, _pixel(src, x, depth) * 255 / max);
+        }
+      }
+  }
+}
+
+void EpdImageDecoder::_rowDone()
+{
+  _decodeRow(_row);
+  _rowFill = 0;
+  if (++_y == height) _state = EPDI_DONE;
+}
+
+bool EpdImageDecoder::write(const uint8_t *data, size_t len)
+{
+  while (len) {
+    uint32_t n;
+    switch (_state) {
+      case EPDI_HEADER:
+        n = EPDI_HEADER_SIZE - _pos;
+        if (n > len) n = len;
+        memcpy(&_header[_pos], data, n);
+        _pos += n;
+        data += n;
+        len -= n;
+        if (_pos < EPDI_HEADER_SIZE) return true;
+        if (!_parseHeader()) return false;
+        _state = EPDI_ROWS;
+        _sink.begin(*this);
+        break;
+
+      case EPDI_ROWS:
+        if (!(flags & EPDI_PACKBITS)) {
+          // Uncompressed: whole rows in the chunk are read in place, unless they need the bit order swapped
+          if (_rowFill == 0 && len >= rowSize && !(flags & EPDI_LSB_FIRST)) {
+            _decodeRow(data);
+            data += rowSize;
+            len -= rowSize;
+            if (++_y == height) _state = EPDI_DONE;
+            break;
+          }
+          n = rowSize - _rowFill;
+          if (n > len) n = len;
+          memcpy(&_row[_rowFill], data, n);
+          _rowFill += n;
+          data += n;
+          len -= n;
+          if (_rowFill == rowSize) _rowDone();
+          break;
+        }
+        // PackBits. Literals and runs may continue in the next chunk or row
+        if (_count == 0) {
+          int8_t c = (int8_t)*data++;
+          len--;
+          if (c == -128) break;
+          _repeat = c < 0;
+          _count = _repeat ? 1 - c : c + 1;
+          _repeatByte = _repeat;
+          break;
+        }
+        if (_repeatByte) {
+          _value = *data++;
+          len--;
+          _repeatByte = false;
+        }
+        while (_count && _state == EPDI_ROWS) {
+          n = rowSize - _rowFill;
+          if (n > _count) n = _count;
+          if (_repeat) {
+            memset(&_row[_rowFill], _value, n);
+          } else {
+            if (n > len) n = len;
+            if (n == 0) break;
+            memcpy(&_row[_rowFill], data, n);
+            data += n;
+            len -= n;
+          }
+          _rowFill += n;
+          _count -= n;
+          if (_rowFill == rowSize) _rowDone();
+        }
+        break;
+
+      case EPDI_DONE:
+        return true;
+
+      case EPDI_ERROR:
+        return false;
+    }
+  }
+  return _state != EPDI_ERROR;
+}
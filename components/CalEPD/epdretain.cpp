@@ -0,0 +1,109 @@
+#include "epdretain.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+
+#define EPD_RETAIN_MAGIC 0x52445045  // "EPDR"
+
+typedef struct {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint32_t rowBytes;
+    uint32_t size;       // Compressed bytes in data
+    uint16_t partials;
+} epd_retain_header;
+
+RTC_DATA_ATTR static epd_retain_header retain_header = {0, 0, 0, 0, 0, 0};
+RTC_DATA_ATTR static uint8_t retain_data[EPD_RETAIN_SIZE];
+
+bool EpdRetain::valid(uint16_t width, uint16_t height, uint32_t rowBytes)
+{
+  return retain_header.magic == EPD_RETAIN_MAGIC && retain_header.width == width &&
+         retain_header.height == height && retain_header.rowBytes == rowBytes;
+}
+
+void EpdRetain::invalidate()
+{
+  retain_header.magic = 0;
+}
+
+uint16_t EpdRetain::partials()
+{
+  return retain_header.partials;
+}
+
+// PackBits, same as EPDI: a count n, 0..127 copies the next n + 1 bytes, 129..255 repeats the next byte 257 - n times.
+// Rows are encoded on their own so they can be read one by one. Returns false if retain_data is full
+static bool packRow(const uint8_t *row, uint32_t rowBytes, uint32_t &o)
+{
+  uint32_t i = 0;
+  while (i < rowBytes) {
+    uint32_t run = 1;
+    while (i + run < rowBytes && run < 128 && row[i + run] == row[i]) run++;
+    if (run >= 3) {
+      if (o + 2 > EPD_RETAIN_SIZE) return false;
+      retain_data[o++] = (uint8_t)(257 - run);
+      retain_data[o++] = row[i];
+      i += run;
+      continue;
+    }
+    // Literal until the next run of 3
+    uint32_t start = i;
+    while (i < rowBytes && i - start < 128) {
+      if (i + 2 < rowBytes && row[i] == row[i + 1] && row[i] == row[i + 2]) break;
+      i++;
+    }
+    uint32_t n = i - start;
+    if (o + 1 + n > EPD_RETAIN_SIZE) return false;
+    retain_data[o++] = (uint8_t)(n - 1);
+    memcpy(&retain_data[o], &row[start], n);
+    o += n;
+  }
+  return true;
+}
+
+bool EpdRetain::store(const uint8_t *buffer, uint16_t width, uint16_t height, uint32_t rowBytes, bool full)
+{
+  uint32_t o = 0;
+  for (uint16_t y = 0; y < height; ++y) {
+    if (!packRow(&buffer[y * rowBytes], rowBytes, o)) {
+      printf("EpdRetain: image does not fit in %d bytes, next update is a full one\n", EPD_RETAIN_SIZE);
+      invalidate();
+      return false;
+    }
+  }
+  retain_header.magic = EPD_RETAIN_MAGIC;
+  retain_header.width = width;
+  retain_header.height = height;
+  retain_header.rowBytes = rowBytes;
+  retain_header.size = o;
+  retain_header.partials = full ? 0 : retain_header.partials + 1;
+  return true;
+}
+
+EpdRetain::EpdRetain()
+{
+}
+
+void EpdRetain::readRow(uint8_t *row)
+{
+  uint32_t fill = 0;
+  const uint32_t rowBytes = retain_header.rowBytes;
+  while (fill < rowBytes && _pos < retain_header.size) {
+    int8_t c = (int8_t)retain_data[_pos++];
+    if (c == -128) continue;
+    if (c < 0) {
+      uint32_t n = 1 - c;
+      if (n > rowBytes - fill) n = rowBytes - fill;
+      memset(&row[fill], retain_data[_pos++], n);
+      fill += n;
+    } else {
+      uint32_t n = c + 1;
+      if (n > rowBytes - fill) n = rowBytes - fill;
+      memcpy(&row[fill], &retain_data[_pos], n);
+      _pos += c + 1;
+      fill += n;
+    }
+  }
+}
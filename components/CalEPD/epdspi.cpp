@@ -1,8 +1,11 @@
 /* SPI Master IO class */
 #include <epdspi.h>
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #ifdef CONFIG_IDF_TARGET_ESP32
     #define EPD_HOST    HSPI_HOST
     #define DMA_CHAN    2
@@ -17,6 +20,21 @@
     #define DMA_CHAN    SPI_DMA_CH_AUTO
 #endif
 
+// Values of spi_transaction_t.user read by the pre transfer callback
+#define EPD_SPI_DC_UNTOUCHED 0
+#define EPD_SPI_DC_CMD       1
+#define EPD_SPI_DC_DATA      2
+
+/* Drives DC only for transactions queued by sequence(). The polling cmd()/data()
+ * leave user=NULL and keep toggling DC themselves
+ */
+static void IRAM_ATTR epd_spi_pre_transfer(spi_transaction_t *t)
+{
+    int dc = (int)(intptr_t)t->user;
+    if (dc == EPD_SPI_DC_UNTOUCHED) return;
+    gpio_set_level((gpio_num_t)CONFIG_EINK_DC, (dc == EPD_SPI_DC_DATA) ? 1 : 0);
+}
+
 void EpdSpi::init(uint8_t frequency=4,bool debug=false){
     debug_enabled = debug;
 
@@ -26,6 +44,14 @@ void EpdSpi::init(uint8_t frequency=4,bool debug=false){
     gpio_set_direction((gpio_num_t)CONFIG_EINK_RST, GPIO_MODE_OUTPUT);
     gpio_set_direction((gpio_num_t)CONFIG_EINK_BUSY, GPIO_MODE_INPUT);
     gpio_set_pull_mode((gpio_num_t)CONFIG_EINK_BUSY, GPIO_PULLUP_ONLY);
+    // BUSY edge interrupt, only enabled while waitBusy() is sleeping
+    gpio_set_intr_type((gpio_num_t)CONFIG_EINK_BUSY, GPIO_INTR_DISABLE);
+    esp_err_t isr_ret = gpio_install_isr_service(0);
+    // ESP_ERR_INVALID_STATE: Already installed by another component
+    if (isr_ret != ESP_OK && isr_ret != ESP_ERR_INVALID_STATE) {
+        ESP_ERROR_CHECK(isr_ret);
+    }
+    gpio_isr_handler_add((gpio_num_t)CONFIG_EINK_BUSY, _busyIsr, this);
 
     gpio_set_level((gpio_num_t)CONFIG_EINK_SPI_CS, 1);
     gpio_set_level((gpio_num_t)CONFIG_EINK_DC, 1);
@@ -55,10 +81,11 @@ void EpdSpi::init(uint8_t frequency=4,bool debug=false){
         .input_delay_ns=0,
         .spics_io_num=CONFIG_EINK_SPI_CS,
         .flags = (SPI_DEVICE_HALFDUPLEX | SPI_DEVICE_3WIRE),
-        .queue_size=5
+        .queue_size=EPD_SPI_QUEUE_SIZE,
+        .pre_cb=epd_spi_pre_transfer
     };
-    // DISABLED Callbacks pre_cb/post_cb. SPI does not seem to behave the same
-    // CS / DC GPIO states the usual way
+    // pre_cb only drives DC on transactions tagged by sequence(). The rest
+    // keep handling CS / DC GPIO states the usual way
 
     //Initialize the SPI bus
     ret=spi_bus_initialize(EPD_HOST, &buscfg, DMA_CHAN);
@@ -90,6 +117,9 @@ void EpdSpi::cmd(const uint8_t cmd)
         printf("C %x\n",cmd);
     } 
 
+    // Polling transactions cannot be mixed with queued ones still in flight
+    if (_streamInFlight) streamEnd();
+
     esp_err_t ret;
     spi_transaction_t t;
     memset(&t, 0, sizeof(t));       //Zero out the transaction
@@ -110,6 +140,7 @@ void EpdSpi::data(uint8_t data)
     /* if (debug_enabled) {
       printf("D %x\n",data);
     } */
+    if (_streamInFlight) streamEnd();
     esp_err_t ret;
     spi_transaction_t t;
     memset(&t, 0, sizeof(t));       //Zero out the transaction
@@ -147,6 +178,7 @@ void EpdSpi::data(const uint8_t *data, int len)
         }
         printf("\n");
     }
+    if (_streamInFlight) streamEnd();
     esp_err_t ret;
     spi_transaction_t t;
                 
@@ -157,6 +189,197 @@ void EpdSpi::data(const uint8_t *data, int len)
     assert(ret==ESP_OK);            //Should have had no issues.
 }
 
+void EpdSpi::readData(uint8_t *data, uint8_t len)
+{
+    if (_streamInFlight) streamEnd();
+    if (len > 4) len = 4;
+    esp_err_t ret;
+    spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
+    t.rxlength=len*8;               //Half duplex: no TX phase
+    t.flags=SPI_TRANS_USE_RXDATA;   //Up to 4 bytes land in t.rx_data
+    ret=spi_device_polling_transmit(spi, &t);
+    assert(ret==ESP_OK);
+    memcpy(data, t.rx_data, len);
+}
+
+/* Queued DMA streaming. Uses spi_device_queue_trans so the CPU can pack the next
+ * line in a second DMA capable buffer while the previous one is on the wire.
+ * Usage: buf = streamBegin(n); fill buf; buf = streamPush(n); ... streamEnd();
+ */
+uint8_t* EpdSpi::streamBegin(uint16_t lineBytes)
+{
+    if (_streamInFlight) streamEnd();
+    if (lineBytes > _streamBufSize) {
+        for (uint8_t b = 0; b < EPD_SPI_STREAM_BUFFERS; b++) {
+            free(_streamBuf[b]);
+            _streamBuf[b] = (uint8_t*)heap_caps_malloc(lineBytes, MALLOC_CAP_DMA);
+            assert(_streamBuf[b]!=NULL);
+        }
+        _streamBufSize = lineBytes;
+        if (debug_enabled) {
+            printf("EpdSpi::streamBegin %d DMA buffers of %d bytes\n", EPD_SPI_STREAM_BUFFERS, lineBytes);
+        }
+    }
+    _streamIdx = 0;
+    return _streamBuf[_streamIdx];
+}
+
+uint8_t* EpdSpi::streamPush(uint16_t len)
+{
+    assert(len <= _streamBufSize);
+    esp_err_t ret;
+    spi_transaction_t* t = &_streamTrans[_streamIdx];
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length=len*8;
+    t->tx_buffer=_streamBuf[_streamIdx];
+    ret=spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret==ESP_OK);
+    ++_streamInFlight;
+
+    _streamIdx = (_streamIdx + 1) % EPD_SPI_STREAM_BUFFERS;
+    // Transactions are returned in order: the oldest one owns the next buffer
+    if (_streamInFlight == EPD_SPI_STREAM_BUFFERS) {
+        spi_transaction_t* rt;
+        ret=spi_device_get_trans_result(spi, &rt, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        --_streamInFlight;
+    }
+    return _streamBuf[_streamIdx];
+}
+
+void EpdSpi::streamEnd()
+{
+    spi_transaction_t* rt;
+    while (_streamInFlight) {
+        esp_err_t ret=spi_device_get_trans_result(spi, &rt, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        --_streamInFlight;
+    }
+}
+
+/* Runs a compact EPD_SEQ_* sequence (See iointerface.h) queuing the transactions
+ * instead of one polling transaction per byte.
+ * Data goes out one byte per transaction like data(uint8_t) does: some controllers
+ * (UC8179, UC8176, UC8159) do not take register data as one multi byte transaction
+ * with a single CS low. So this won't work: IO.data(epd_wakeup_power.data, databytes)
+ * Usage: while ((seq = IO.sequence(seq)) != NULL) _waitBusy("...");
+ */
+const uint8_t* EpdSpi::sequence(const uint8_t *seq)
+{
+    if (_streamInFlight) streamEnd();
+    while (true) {
+        uint8_t op = *seq++;
+        switch (op) {
+        case EPD_SEQ_CMD:
+            if (debug_enabled) printf("C %x\n", seq[0]);
+            _seqQueue(false, seq, 1);
+            for (uint8_t i = 0; i < seq[1]; ++i) _seqQueue(true, seq + 2 + i, 1);
+            seq += 2 + seq[1];
+            break;
+        case EPD_SEQ_DATA:
+            for (uint8_t i = 0; i < seq[0]; ++i) _seqQueue(true, seq + 1 + i, 1);
+            seq += 1 + seq[0];
+            break;
+        case EPD_SEQ_DELAY:
+            _seqEnd();
+            vTaskDelay(*seq++ / portTICK_RATE_MS);
+            break;
+        case EPD_SEQ_WAIT_BUSY:
+            _seqEnd();
+            return seq;
+        case EPD_SEQ_END:
+            _seqEnd();
+            return NULL;
+        default:
+            ESP_LOGE("EpdSpi", "sequence() unknown opcode %x", op);
+            _seqEnd();
+            return NULL;
+        }
+    }
+}
+
+void EpdSpi::_seqQueue(bool isData, const uint8_t *data, uint8_t len)
+{
+    esp_err_t ret;
+    spi_transaction_t* rt;
+    // Recycle the oldest transaction when the device queue is full
+    if (_seqInFlight == EPD_SPI_QUEUE_SIZE) {
+        ret=spi_device_get_trans_result(spi, &rt, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        --_seqInFlight;
+    }
+    spi_transaction_t* t = &_seqTrans[_seqIdx];
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length=len*8;
+    t->user=(void*)(isData ? EPD_SPI_DC_DATA : EPD_SPI_DC_CMD);
+    if (len <= 4) {
+        t->flags=SPI_TRANS_USE_TXDATA;
+        memcpy(t->tx_data, data, len);
+    } else {
+        t->tx_buffer=data;
+    }
+    ret=spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret==ESP_OK);
+    ++_seqInFlight;
+    _seqIdx = (_seqIdx + 1) % EPD_SPI_QUEUE_SIZE;
+}
+
+void EpdSpi::_seqEnd()
+{
+    spi_transaction_t* rt;
+    while (_seqInFlight) {
+        esp_err_t ret=spi_device_get_trans_result(spi, &rt, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        --_seqInFlight;
+    }
+    // Polling data() expects DC high
+    gpio_set_level((gpio_num_t)CONFIG_EINK_DC, 1);
+}
+
+void IRAM_ATTR EpdSpi::_busyIsr(void *arg)
+{
+    EpdSpi* io = (EpdSpi*)arg;
+    if (io->_busyTask == NULL) return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(io->_busyTask, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/* Waits until the BUSY pin reads idleLevel. Instead of polling it with vTaskDelay(1)
+ * the task blocks on a notification given by the BUSY edge ISR so the core is free
+ * for other tasks during the refresh.
+ */
+bool EpdSpi::waitBusy(uint8_t idleLevel, uint32_t timeoutMs)
+{
+    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == idleLevel) return true;
+
+    int64_t start = esp_timer_get_time();
+    int64_t timeout = (int64_t)timeoutMs * 1000;
+    _busyTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0); // Clear any stale notification
+    gpio_set_intr_type((gpio_num_t)CONFIG_EINK_BUSY, idleLevel ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE);
+    gpio_intr_enable((gpio_num_t)CONFIG_EINK_BUSY);
+
+    bool idle = false;
+    while (true) {
+        // Check after enabling the interrupt so an edge in between is not lost
+        if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == idleLevel) {
+            idle = true;
+            break;
+        }
+        int64_t remaining = timeout - (esp_timer_get_time() - start);
+        if (remaining <= 0) break;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(remaining / 1000) + 1);
+    }
+    gpio_intr_disable((gpio_num_t)CONFIG_EINK_BUSY);
+    gpio_set_intr_type((gpio_num_t)CONFIG_EINK_BUSY, GPIO_INTR_DISABLE);
+    _busyTask = NULL;
+    return idle;
+}
+
 void EpdSpi::reset(uint8_t millis=20) {
     gpio_set_level((gpio_num_t)CONFIG_EINK_RST, 0);
     vTaskDelay(millis / portTICK_RATE_MS);
@@ -0,0 +1,185 @@
+#include "gzipstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "sdkconfig.h"
+#ifdef CONFIG_IDF_TARGET_ESP32
+    #include "esp32/rom/miniz.h"
+#elif defined CONFIG_IDF_TARGET_ESP32S2
+    #include "esp32s2/rom/miniz.h"
+#elif defined CONFIG_IDF_TARGET_ESP32C3
+    #include "esp32c3/rom/miniz.h"
+#endif
+
+// gzip header flags
+#define GZ_FLAG_HCRC    0x02
+#define GZ_FLAG_EXTRA   0x04
+#define GZ_FLAG_NAME    0x08
+#define GZ_FLAG_COMMENT 0x10
+
+GzipStream::Encoding GzipStream::encoding(const char *contentEncoding)
+{
+  if (contentEncoding == nullptr) return GZ_IDENTITY;
+  if (strcasecmp(contentEncoding, "gzip") == 0 || strcasecmp(contentEncoding, "x-gzip") == 0) return GZ_GZIP;
+  if (strcasecmp(contentEncoding, "deflate") == 0) return GZ_DEFLATE;
+  return GZ_IDENTITY;
+}
+
+bool GzipStream::_fail(const char *reason)
+{
+  printf("GZIP: %s\n", reason);
+  _state = GZ_ERROR;
+  return false;
+}
+
+bool GzipStream::begin(Encoding encoding)
+{
+  _encoding = encoding;
+  _size = 0;
+  _pos = 0;
+  _windowPos = 0;
+  if (encoding == GZ_IDENTITY) {
+    _state = GZ_PASS;
+    return true;
+  }
+  if (_inflator == nullptr) _inflator = malloc(sizeof(tinfl_decompressor));
+  if (_window == nullptr) _window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+  if (_inflator == nullptr || _window == nullptr) {
+    end();
+    return _fail("Could not allocate the inflater");
+  }
+  tinfl_init((tinfl_decompressor*)_inflator);
+  _state = (encoding == GZ_GZIP) ? GZ_HEADER : GZ_INFLATE;
+  return true;
+}
+
+void GzipStream::end()
+{
+  free(_inflator);
+  free(_window);
+  _inflator = nullptr;
+  _window = nullptr;
+}
+
+// After the fixed header or a field: the next optional field present in _flags
+void GzipStream::_nextHeaderField()
+{
+  _pos = 0;
+  if (_flags & GZ_FLAG_EXTRA) {
+    _flags &= ~GZ_FLAG_EXTRA;
+    _state = GZ_EXTRA_LEN;
+  } else if (_flags & GZ_FLAG_NAME) {
+    _flags &= ~GZ_FLAG_NAME;
+    _state = GZ_NAME;
+  } else if (_flags & GZ_FLAG_COMMENT) {
+    _flags &= ~GZ_FLAG_COMMENT;
+    _state = GZ_COMMENT;
+  } else if (_flags & GZ_FLAG_HCRC) {
+    _flags &= ~GZ_FLAG_HCRC;
+    _skip = 2;
+    _state = GZ_HEADER_CRC;
+  } else {
+    _state = GZ_INFLATE;
+  }
+}
+
+bool GzipStream::_inflate(const uint8_t *&data, size_t &len)
+{
+  tinfl_decompressor *inflator = (tinfl_decompressor*)_inflator;
+  const mz_uint32 flags = TINFL_FLAG_HAS_MORE_INPUT |
+    ((_encoding == GZ_DEFLATE) ? TINFL_FLAG_PARSE_ZLIB_HEADER : 0);
+  for (;;) {
+    size_t in = len;
+    size_t out = TINFL_LZ_DICT_SIZE - _windowPos;
+    tinfl_status status = tinfl_decompress(inflator, data, &in, _window, &_window[_windowPos], &out, flags);
+    data += in;
+    len -= in;
+    if (out) {
+      _size += out;
+      if (!_output(&_window[_windowPos], out, _arg)) return _fail("Output stopped");
+      _windowPos = (_windowPos + out) & (TINFL_LZ_DICT_SIZE - 1);
+    }
+    if (status < TINFL_STATUS_DONE) return _fail("Corrupted deflate stream");
+    if (status == TINFL_STATUS_DONE) {
+      _pos = 0;
+      _state = (_encoding == GZ_GZIP) ? GZ_TRAILER : GZ_DONE;
+      return true;
+    }
+    // More output is pending even if the input is over
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) return true;
+  }
+}
+
+bool GzipStream::write(const uint8_t *data, size_t len)
+{
+  while (len) {
+    switch (_state) {
+      case GZ_PASS:
+        _size += len;
+        if (!_output(data, len, _arg)) return _fail("Output stopped");
+        return true;
+
+      case GZ_HEADER:
+        _header[_pos++] = *data++;
+        len--;
+        if (_pos < sizeof(_header)) break;
+        if (_header[0] != 0x1F || _header[1] != 0x8B || _header[2] != 8) return _fail("Not a gzip deflate stream");
+        _flags = _header[3];
+        _nextHeaderField();
+        break;
+
+      case GZ_EXTRA_LEN:
+        _header[_pos++] = *data++;
+        len--;
+        if (_pos < 2) break;
+        _skip = _header[0] | (_header[1] << 8);
+        if (_skip) {
+          _state = GZ_EXTRA;
+        } else {
+          _nextHeaderField();
+        }
+        break;
+
+      case GZ_EXTRA:
+      case GZ_HEADER_CRC:
+        {
+          size_t n = (len < _skip) ? len : _skip;
+          data += n;
+          len -= n;
+          _skip -= n;
+          if (_skip == 0) _nextHeaderField();
+        }
+        break;
+
+      case GZ_NAME:
+      case GZ_COMMENT:
+        // Zero terminated
+        len--;
+        if (*data++ == 0) _nextHeaderField();
+        break;
+
+      case GZ_INFLATE:
+        if (!_inflate(data, len)) return false;
+        break;
+
+      case GZ_TRAILER:
+        _header[_pos++] = *data++;
+        len--;
+        if (_pos < 8) break;
+        // ISIZE is the plain size modulo 2^32. TCP already checks the bytes, CRC32 is not computed
+        if ((uint32_t)(_header[4] | (_header[5] << 8) | (_header[6] << 16) | ((uint32_t)_header[7] << 24)) != _size) {
+          return _fail("Size does not match");
+        }
+        _state = GZ_DONE;
+        break;
+
+      case GZ_DONE:
+        return true;
+
+      case GZ_ERROR:
+        return false;
+    }
+  }
+  return _state != GZ_ERROR;
+}
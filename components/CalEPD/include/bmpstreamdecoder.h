@@ -0,0 +1,114 @@
+/**
+ * Streaming BMP decoder: feed it the HTTP chunks as they arrive and it draws the rows into a Sink.
+ * Supports uncompressed 1, 4 and 8 bit palette bitmaps, bottom-up or top-down.
+ *
+ * Chunks are read in place: only the header, the palette and a row that is split
+ * between two chunks are copied. The palette is converted once to display colors in a LUT.
+ * 1 bit rows with a black & white palette are handed to the Sink as whole bytes.
+ * With a Dither set, 4 and 8 bit bitmaps are dithered by the palette grays instead of a fixed threshold.
+ *
+ * Only depends on the C library so it can be tested in a Linux host with a Sink that
+ * writes into memory. EpdBmpSink (epdbmpsink.h) draws into any Epd model.
+ */
+#ifndef bmpstreamdecoder_h
+#define bmpstreamdecoder_h
+#include <stdint.h>
+#include <stddef.h>
+#include <gdew_colors.h>
+#include <dither.h>
+
+// File header (14) + biggest info header (BITMAPV5HEADER 124) + 256 color palette
+#define BMP_HEADER_MAX 1162
+// Bytes needed to read the BITMAPINFOHEADER fields
+#define BMP_HEADER_MIN 54
+
+class BmpStreamDecoder
+{
+  public:
+    class Sink
+    {
+      public:
+        virtual ~Sink() {};
+        // Called once the header and palette are read, before the first row
+        virtual void begin(BmpStreamDecoder& bmp) {};
+        virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+        // Optional: w pixels of a row from x = 0. MSB first, bit 1 is white.
+        // Returning false draws the row with drawPixel()
+        virtual bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) { return false; };
+    };
+
+    // Rows and columns outside maxWidth x maxHeight are skipped
+    BmpStreamDecoder(Sink& sink, uint16_t maxWidth, uint16_t maxHeight);
+    ~BmpStreamDecoder();
+
+    // Ready for a new file. Use the second one if the display rotation changed
+    void reset();
+    void reset(uint16_t maxWidth, uint16_t maxHeight);
+    // Decodes the next chunk. Returns false if the bitmap is not supported, then the rest is ignored
+    bool write(const uint8_t *data, size_t len);
+    // All the rows were decoded
+    bool done() { return _state == BMP_DONE; };
+    bool failed() { return _state == BMP_ERROR; };
+    // Rows go to Sink::drawRowBits(): 1 bit bitmap with a black & white palette, or dithered to DITHER_BW
+    bool rowBits() { return _rowBitsDirect || _rowBitsInvert || (_dithered && dither->target == DITHER_BW); };
+
+    // Colors sent to the Sink. Palette entries are whitish, colored (reddish or yellowish) or black
+    uint16_t white = EPD_WHITE;
+    uint16_t black = EPD_BLACK;
+    uint16_t red = EPD_RED;
+    // When false colored entries are black. 1 bit bitmaps never use red
+    bool withColor = true;
+    // Dithers 4 and 8 bit bitmaps unless they have colored entries drawn in red. DITHER_BW rows go to
+    // Sink::drawRowBits(), the other gray targets send 8 bit grays to drawPixel(). DITHER_7COLOR is ignored.
+    // Its begin() is called for each bitmap
+    Dither *dither = nullptr;
+    bool debug = false;
+
+    // Header fields, valid after the first BMP_HEADER_MIN bytes
+    uint32_t fileSize = 0;
+    uint32_t imageOffset = 0;
+    uint32_t headerSize = 0;
+    int32_t width = 0;
+    int32_t height = 0;  // Negative for top-down bitmaps
+    uint16_t planes = 0;
+    uint16_t depth = 0;
+    uint32_t format = 0;
+    uint32_t rowSize = 0;
+
+  private:
+    enum {
+      BMP_HEADER,   // Gathering the header and palette in _header
+      BMP_SKIP,     // Skipping until imageOffset
+      BMP_PIXELS,
+      BMP_DONE,
+      BMP_ERROR
+    } _state = BMP_HEADER;
+
+    Sink& _sink;
+    uint16_t _maxWidth;
+    uint16_t _maxHeight;
+
+    uint8_t _header[BMP_HEADER_MAX];
+    uint16_t _headerNeed = BMP_HEADER_MIN;
+    uint32_t _pos = 0;        // Bytes of the file consumed
+
+    uint16_t _lut[256];       // Palette index to color, or to gray when dithered
+    bool _dithered = false;
+    uint8_t *_ditherRow = nullptr;  // Grays of a row and the dithered output
+    bool _rowBitsDirect = false;  // 1 bit palette is black 0, white 1: rows go as they come
+    bool _rowBitsInvert = false;  // 1 bit palette is white 0, black 1
+
+    uint8_t *_row = nullptr;  // Row split between chunks, also used to invert 1 bit rows
+    uint32_t _rowFill = 0;
+    uint32_t _rowIndex = 0;   // Rows decoded so far, in file order
+    uint32_t _rows = 0;
+    uint16_t _drawWidth = 0;
+
+    static uint16_t _read16(const uint8_t *p) { return p[0] | (p[1] << 8); };
+    static uint32_t _read32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); };
+    bool _parseHeader();
+    bool _parsePalette();
+    void _decodeRow(const uint8_t *src);
+    bool _fail(const char *reason);
+};
+#endif
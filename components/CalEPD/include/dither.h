@@ -0,0 +1,96 @@
+/**
+ * Row by row dithering for any decoder: rows of 8 bit gray or RGB in, display levels or palette indexes out.
+ * Rows must be sent top-down. Error diffusion keeps three rows of int16 errors with 4 fractional bits,
+ * so there are no divides per pixel and a 800 px wide display needs ~5 KB (~15 KB for RGB).
+ * Ordered modes need no buffers at all and can also be used pixel by pixel with pixel().
+ *
+ * Modes:
+ *   DITHER_NONE             Nearest level
+ *   DITHER_FLOYD_STEINBERG  7/16 3/16 5/16 1/16, serpentine. Best for photos
+ *   DITHER_ATKINSON         6/8 of the error to 6 neighbours over 3 rows. More contrast, clean flat areas
+ *   DITHER_BAYER            8x8 ordered. Stable patterns that do not crawl between partial refreshes
+ *   DITHER_BLUE_NOISE       32x32 void and cluster map. Ordered, but without the Bayer cross-hatch
+ * Targets:
+ *   DITHER_BW, DITHER_4GRAY, DITHER_16GRAY  Levels from 0 black to levels() - 1 white
+ *   DITHER_7COLOR                          Epd7Color indexes (black, white, green, blue, red, yellow, orange),
+ *                                          or any other palette set in palette / paletteSize
+ */
+#ifndef dither_h
+#define dither_h
+#include <stdint.h>
+#include <stddef.h>
+
+// Modes
+#define DITHER_NONE            0
+#define DITHER_FLOYD_STEINBERG 1
+#define DITHER_ATKINSON        2
+#define DITHER_BAYER           3
+#define DITHER_BLUE_NOISE      4
+// Targets
+#define DITHER_BW              0
+#define DITHER_4GRAY           1
+#define DITHER_16GRAY          2
+#define DITHER_7COLOR          3
+
+class Dither
+{
+  public:
+    Dither(uint8_t mode = DITHER_FLOYD_STEINBERG, uint8_t target = DITHER_BW) : mode(mode), target(target) {};
+    ~Dither() { end(); };
+
+    // Ready for a new image of width pixels. Returns false if the error rows can not be allocated,
+    // then error diffusion modes fall back to DITHER_BAYER
+    bool begin(uint16_t width);
+    // Frees the error rows
+    void end();
+
+    // One row of 8 bit grays, 0 is black
+    void grayRow(const uint8_t *gray, uint8_t *out);
+    // One row of RGB888. Gray targets use the luminance
+    void rgbRow(const uint8_t *rgb, uint8_t *out);
+    // Gray targets packed 1 bpp MSB first, 1 is white: the rows Epd::writeRowBits() takes
+    void grayRowBits(const uint8_t *gray, uint8_t *bits);
+    // Ordered dithering of a single pixel, for decoders that do not draw whole rows.
+    // Error diffusion modes use DITHER_BAYER here. Does not need begin()
+    uint8_t pixel(uint8_t gray, uint16_t x, uint16_t y);
+
+    uint8_t levels();
+    // 8 bit gray of a level: 0 black, 255 white
+    uint8_t gray(uint8_t level) { return _levelGray[level]; };
+
+    uint8_t mode;
+    uint8_t target;
+    // DITHER_BW: grays above are white. Moves the midpoint, for example to keep light backgrounds clean
+    uint8_t threshold = 127;
+    // Error diffusion goes right to left in odd rows: no diagonal worms
+    bool serpentine = true;
+    // DITHER_7COLOR palette: RGB triplets in index order
+    const uint8_t *palette = palette7Color;
+    uint8_t paletteSize = 7;
+    static const uint8_t palette7Color[21];
+
+  private:
+    uint16_t _width = 0;
+    uint16_t _y = 0;
+    int16_t *_err = nullptr;  // 3 rows of (_width + 4) * channels errors, 2 of padding at each side
+    int16_t *_rows[3];        // This row, the next one and the one after
+    uint8_t _channels = 1;
+    uint8_t _tablesFor = 0xFF;  // Target and threshold of the tables below
+    uint8_t _tablesThreshold = 0;
+    uint8_t _quant[256];      // Gray to nearest level
+    uint8_t _base[256];       // Gray to the level below and the position between it and the next one
+    uint8_t _frac[256];
+    uint8_t _levelGray[16];
+
+    static const uint8_t _bayer8[64];
+    static const uint8_t _blueNoise[1024];
+
+    void _tables();
+    bool _diffuse();
+    const uint8_t *_ordered(uint16_t y, uint8_t &mask);
+    uint8_t _nearest(int16_t r, int16_t g, int16_t b);
+    void _grayRow(const uint8_t *src, uint8_t stride, uint8_t *out, uint8_t *bits);
+    void _colorRow(const uint8_t *src, uint8_t stride, uint8_t *out);
+    void _nextRow();
+};
+#endif
@@ -6,7 +6,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include <stdint.h>
 #include <math.h>
 #include "sdkconfig.h"
@@ -14,6 +17,7 @@
 #include <string>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
+#include <epdghost.h>
 
 // Shared struct(s) for different models
 typedef struct {
@@ -89,6 +93,52 @@ typedef struct {
 } epd_power_4;
 
 
+// Dirty rectangles tracked for updateDirty()
+#ifndef EPD_DIRTY_RECTS
+  #define EPD_DIRTY_RECTS 4
+#endif
+// Pixels closer than this to a dirty rectangle grow it instead of starting a new one
+#define EPD_DIRTY_MERGE 16
+// When the dirty area is bigger than this % of the screen updateDirty() runs a full update()
+#define EPD_DIRTY_FULL_PERCENT 50
+
+// drawPaged() splits the native rows in this number of bands
+#ifndef EPD_PAGE_BANDS
+  #define EPD_PAGE_BANDS 8
+#endif
+
+// Controller power states, see hold()
+#define EPD_POWER_OFF         0  // Not initialized yet
+#define EPD_POWER_INITIALIZED 1  // Registers and RAM kept, booster off
+#define EPD_POWER_ON          2
+#define EPD_POWER_DEEP_SLEEP  3  // Needs a reset and the init table
+
+// Refresh modes, see setRefreshMode()
+#define EPD_REFRESH_FULL    0  // OTP waveform: slow, flashes, clears ghosting
+#define EPD_REFRESH_FAST    1  // Shorter register LUT, still flashes the whole screen
+#define EPD_REFRESH_PARTIAL 2  // Only the pixels that changed move. Needs the previous image in the controller
+// Fast and partial refreshes leave some ghosting: every N of them one runs with the full waveform
+#ifndef EPD_REFRESH_FULL_EVERY
+  #define EPD_REFRESH_FULL_EVERY 20
+#endif
+
+// temperature() when there is no callback and the controller has no sensor
+#define EPD_TEMPERATURE_UNKNOWN -128
+
+// Settings for a temperature band. Models keep a table sorted by maxTemperature, the last one 127
+typedef struct {
+    int8_t maxTemperature;   // °C, inclusive
+    uint8_t refreshMode;     // Fastest EPD_REFRESH_* allowed: full, fast, partial
+    uint16_t busyTimeout;    // ms
+} epd_temperature_band;
+
+typedef struct {
+    int16_t x0;
+    int16_t y0;
+    int16_t x1;  // Inclusive. x1 < x0 means empty
+    int16_t y1;
+} epd_rect;
+
 // Note: GDEW0213I5F is our test display that will be the default initializing this class
 class Epd : public virtual Adafruit_GFX
 {
@@ -104,6 +154,92 @@ class Epd : public virtual Adafruit_GFX
     virtual void init(bool debug = false) = 0;
     virtual void update() = 0; 
 
+    // Non blocking update: returns as soon as the buffer is sent and the refresh started
+    // so the app can draw the next frame or start WiFi while the panel refreshes.
+    // Models that do not support it simply run a blocking update()
+    void updateAsync();
+    // Waits the end of a refresh started by updateAsync() and sends the display to sleep
+    void waitForRefresh();
+    bool isRefreshing() { return _refresh_pending; }
+
+    // Waveform of the next update() calls. fullEvery 0 never forces a full one.
+    // Models without register LUTs always refresh full
+    void setRefreshMode(uint8_t mode, uint16_t fullEvery = EPD_REFRESH_FULL_EVERY) {
+      _refresh_mode = mode;
+      _refresh_full_every = fullEvery;
+    };
+    uint8_t refreshMode() { return _refresh_mode; };
+
+    // Panel temperature in °C. The callback, for example a sensor next to the panel, has priority
+    // over the controller sensor. Models with a temperature band table use it to pick the fastest
+    // waveform and the busy timeout. EPD_TEMPERATURE_UNKNOWN keeps the conservative settings
+    typedef int8_t (*TemperatureCallback)(void *arg);
+    void setTemperatureCallback(TemperatureCallback read, void *arg = nullptr) {
+      _temperature_callback = read;
+      _temperature_arg = arg;
+    };
+    int8_t temperature();
+
+    // Power management. By default every update wakes the controller (reset + init table) and sends
+    // it to deep sleep. Between hold() and release() it stays powered, so back-to-back updates skip
+    // both. With an idle timeout the booster is switched off after each update and the controller goes
+    // to deep sleep when no update comes in ms: the next update within it skips the reset and init.
+    // Only models that call _powerUp() / _powerDown() are managed, the others keep the old behaviour
+    void hold() { _power_hold = true; };
+    // Ends hold() and sends the controller to deep sleep now
+    void release();
+    // 0 disables it
+    void setIdleTimeout(uint32_t ms);
+    uint8_t powerState() { return _power_state; };
+
+    // Paged drawing: draw(arg) is called once per band of HEIGHT/EPD_PAGE_BANDS native rows and each band
+    // is sent to the controller RAM before rendering the next. Then the display is refreshed.
+    // draw() should paint the whole screen every time, starting with fillScreen().
+    // When the band cannot be allocated it is halved down to a single row.
+    // Models without paging call draw() once and update().
+    // Returns false if not even a one row band fits in RAM: nothing is drawn
+    bool drawPaged(void (*draw)(void *arg), void *arg);
+
+    // Direct stream: rows go to the controller RAM as they come, the framebuffer is not used.
+    // A raw row is rawRowBytes() in the controller format (rotation 0). Rows may come in any
+    // order, bottom-up bitmaps included. endRawWrite() refreshes the display.
+    // beginRawWrite() returns false if the model does not support it.
+    // cancelRawWrite() sends the controller to sleep without refreshing, the panel keeps the old image
+    bool beginRawWrite();
+    void writeRawRow(uint16_t y, const uint8_t *row);
+    void endRawWrite();
+    void cancelRawWrite();
+    uint32_t rawRowBytes() { return _rawRowBytes(); };
+
+    // Deep sleep partial refresh: the image on the panel is kept in RTC memory (See epdretain.h).
+    // It is written back as the controller "old" image and only the rows that changed are partially
+    // refreshed. Runs update() on the first boot, when the image did not fit, every EPD_RETAIN_FULL_EVERY
+    // calls or in models that do not support it. When nothing changed the display is not woken up
+    void updateRetained();
+
+    // Sends only the areas drawn since the last update using updateWindow()
+    // Falls back to update() when the change is big or the model does not track them
+    void updateDirty();
+    // Ghosting scheduler for updateDirty(): windows are counted in tiles and a full update() runs
+    // instead only when a tile over the budget changes again (See epdghost.h). 0 disables it
+    void setGhostBudget(uint8_t budget, uint8_t tile = EPD_GHOST_TILE) {
+      _ghost.budget = budget;
+      _ghost.tile = tile;
+      _ghost.end();
+    };
+    // Partial refresh. Models that support it override this, default is a full update()
+    virtual void updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool using_rotation = true) {
+      update();
+    };
+    // Span primitives clip and mark the dirty area once, then use the model _fillSpan()
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    // Dirty rectangles are kept in rotated coordinates: changing rotation marks the whole screen
+    void setRotation(uint8_t r) override;
+    // Decoded 1 bpp image row at GFX row y from x = 0: MSB first, bit 1 is white (See BmpStreamDecoder)
+    void writeRowBits(int16_t y, const uint8_t *bits, uint16_t w);
+
     // Partial methods are going to be implemented by each model clases
     //virtual void updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool using_rotation = true);
     // partial update of rectangle at (xs,ys) from buffer to screen at (xd,yd), does not power off
@@ -123,6 +259,48 @@ class Epd : public virtual Adafruit_GFX
     static inline uint16_t gx_uint16_max(uint16_t a, uint16_t b) {return (a > b ? a : b);};
     bool _using_partial_mode = false;
     bool debug_enabled = true;
+    // Set by models that call _dirtyPixel() in drawPixel and implement updateWindow()
+    bool _dirty_tracking = false;
+    // Band being rendered by drawPaged(). _page_rows is 0 when not paging
+    uint8_t* _page_buffer = nullptr;
+    uint16_t _page_y = 0;
+    uint16_t _page_rows = 0;
+    // Called from drawPixel (rotated coordinates, already in bounds). Cheap when the pixel
+    // is inside the last touched rectangle, which is the common case drawing text or shapes
+    inline void _dirtyPixel(int16_t x, int16_t y) {
+      epd_rect &r = _dirty[_dirty_last];
+      if (x >= r.x0 && x <= r.x1 && y >= r.y0 && y <= r.y1) return;
+      _dirtyRect(x, y, x, y);
+    };
+    void _dirtyRect(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+    // Same for spans in x,y,w,h form. Clips and does nothing if the model does not track
+    void _dirtySpan(int16_t x, int16_t y, int16_t w, int16_t h);
+    void _dirtyClear() { _dirty_count = 0; _dirty_last = 0; _dirty[0] = {0, 0, -1, -1}; };
+    // Called by update() when it redraws the whole screen: the dirty list restarts. A full refresh also
+    // restarts the ghosting counters, partial and fast ones count in every tile. Models with setRefreshMode()
+    // pass the mode _nextRefreshMode() returned
+    void _updateStart(uint8_t mode = EPD_REFRESH_FULL);
+    // Called by update() right after the refresh command. Returns true when update()
+    // runs on behalf of updateAsync() and should return leaving the wait to waitForRefresh()
+    bool _deferRefresh() {
+      if (!_refresh_async) return false;
+      _refresh_pending = true;
+      return true;
+    };
+    // Called by models that support setRefreshMode() when an update starts: the mode to load this time.
+    // oldImage false means the controller lost the previous image, then partial runs full
+    // fastest is the limit of the temperature band
+    uint8_t _nextRefreshMode(bool oldImage = true, uint8_t fastest = EPD_REFRESH_PARTIAL);
+    // Last known temperature() or EPD_TEMPERATURE_UNKNOWN
+    int8_t _temperature = EPD_TEMPERATURE_UNKNOWN;
+    // The band of temp in a table, nullptr when it is unknown
+    static const epd_temperature_band* _temperatureBand(const epd_temperature_band *bands, int8_t temp);
+    // Models call _powerUp() instead of _wakeUp() and _powerDown() instead of _sleep().
+    // _powerUp() only runs _wakeUp() when the controller is not initialized or reinit is true.
+    // _powerIdle() ends an update that leaves the controller awake, the idle timeout may sleep it
+    void _powerUp(bool reinit = false);
+    void _powerDown();
+    void _powerIdle();
     // Very smart template from EPD to swap x,y:
     template <typename T> static inline void
     swap(T& a, T& b)
@@ -137,7 +315,65 @@ class Epd : public virtual Adafruit_GFX
     virtual void _wakeUp() = 0;
     virtual void _sleep() = 0;
     virtual void _waitBusy(const char* message) = 0;
+    // Booster on / off keeping registers and RAM. Returning false means the model can not, then the idle
+    // timeout keeps it powered until the deep sleep
+    virtual bool _panelPowerOn() { return false; };
+    virtual bool _panelPowerOff() { return false; };
+    // Controller temperature sensor. Only called when there is no callback
+    virtual int8_t _readTemperature() { return EPD_TEMPERATURE_UNKNOWN; };
+    // Models with a Framebuffer fill the clipped span (GFX coordinates) writing whole bytes.
+    // Returning false draws it pixel by pixel with the Adafruit_GFX implementation
+    virtual bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { return false; };
+    // Same for writeRowBits(). Returning false draws the row pixel by pixel
+    virtual bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) { return false; };
+    bool _clip(int16_t& x, int16_t& y, int16_t& w, int16_t& h);
+    // Paging hooks. _pageRowBytes() returns the bytes of a native row or 0 if the model does not support it
+    virtual uint32_t _pageRowBytes() { return 0; };
+    virtual void _pageStart() {};   // Wake up and start the RAM write
+    virtual void _pageSend() {};    // Send the _page_rows rows in _page_buffer starting at _page_y
+    virtual void _pageFinish() {};  // Refresh the display
+    // Direct stream hooks. _rawRowBytes() returns the bytes of a native row or 0 if the model does not support it
+    virtual uint32_t _rawRowBytes() { return 0; };
+    virtual void _rawStart() {};    // Wake up and start the RAM write
+    virtual void _rawRow(uint16_t y, const uint8_t *row) {};
+    virtual void _rawFinish() {};   // Refresh the display
+    // Retained image hooks. _retainBuffer() returns the 1 bpp framebuffer in RAM row order or nullptr if
+    // the model does not support it. _retainOldRow() gets every row of the previous image, in order
+    virtual const uint8_t* _retainBuffer(uint32_t& rowBytes) { return nullptr; };
+    virtual void _retainStart(uint16_t y0, uint16_t y1) {};  // Wake up in partial mode, start the old image
+    virtual void _retainOldRow(uint16_t y, const uint8_t *row) {};
+    virtual void _retainFinish(uint16_t y0, uint16_t y1) {}; // Send the new rows, refresh y0..y1 and sleep
     
+    bool _refresh_async = false;
+    bool _refresh_pending = false;
+    bool _raw_writing = false;
+    uint8_t _refresh_mode = EPD_REFRESH_FULL;
+    uint16_t _refresh_full_every = EPD_REFRESH_FULL_EVERY;
+    uint16_t _refresh_count = 0;      // Fast and partial refreshes since the last full one
+    bool _refresh_force_full = false;
+    TemperatureCallback _temperature_callback = nullptr;
+    void *_temperature_arg = nullptr;
+
+    uint8_t _power_state = EPD_POWER_OFF;
+    bool _power_hold = false;
+    volatile bool _power_busy = false;  // Between _powerUp() and _powerDown(): the idle timer does nothing
+    uint32_t _idle_timeout = 0;
+    esp_timer_handle_t _idle_timer = nullptr;
+    int64_t _idle_deadline = 0;         // esp_timer_get_time() when the idle timeout ends
+    // esp_timer callbacks must not block: the timer only notifies _idleTask(), that sleeps the controller
+    TaskHandle_t _idle_task = nullptr;
+    SemaphoreHandle_t _power_lock = nullptr;
+    static void _idleTimerCallback(void *arg);
+    static void _idleTask(void *arg);
+    void _idleStart();
+    void _powerLock() { if (_power_lock) xSemaphoreTake(_power_lock, portMAX_DELAY); };
+    void _powerUnlock() { if (_power_lock) xSemaphoreGive(_power_lock); };
+
+    epd_rect _dirty[EPD_DIRTY_RECTS] = {{0, 0, -1, -1}};
+    uint8_t _dirty_count = 0;
+    uint8_t _dirty_last = 0;
+    EpdGhostMap _ghost;
+
     uint8_t _unicodePerChar(uint8_t c);
     uint8_t _unicodeEasy(uint8_t c);
     // Command & data structs should be implemented by every MODELX display
@@ -5,6 +5,19 @@
 
 #ifndef epd4spi_h
 #define epd4spi_h
+// Controller bits used by readBusy(), waitBusy() and dataFill() masks
+#define EPD4SPI_M1  0x01
+#define EPD4SPI_S1  0x02
+#define EPD4SPI_M2  0x04
+#define EPD4SPI_S2  0x08
+#define EPD4SPI_ALL 0x0F
+// DMA buffer size used by dataFill(). Should be lower than buscfg.max_transfer_sz
+#define EPD4SPI_FILL_CHUNK 4092
+// Transactions in flight for queueData(). Also used as SPI device queue_size
+#define EPD4SPI_QUEUE_SIZE 5
+// Biggest transfer accepted by queueData() (One 82 bytes row per controller)
+#define EPD4SPI_QUEUE_SLOT 128
+
 class Epd4Spi : IoInterface
 {
   public:
@@ -20,7 +33,16 @@ class Epd4Spi : IoInterface
     void dataS2(uint8_t data);
     void cmdM1S1M2S2(uint8_t cmd);
     void dataM1S1M2S2(uint8_t data);
-    void readBusy(gpio_num_t pin);
+    // Mask of the controllers that are still busy (BUSY low) from a single GPIO input read
+    uint8_t readBusy();
+    // Waits until none of the controllers in mask is busy polling all of them at once
+    bool waitBusy(uint8_t mask, uint32_t timeoutMs);
+    // Sends value len times to the controllers in csMask repeating one DMA buffer
+    void dataFill(uint8_t csMask, uint8_t value, uint32_t len);
+    // Queues a DMA data transfer for the controllers in csMask. CS is driven in the SPI pre/post callbacks
+    void queueData(uint8_t csMask, const uint8_t *data, int len);
+    // Waits until all queued transfers are done
+    void queueEnd();
 
     void cmd(const uint8_t cmd) override;
     void data(uint8_t data) override;
@@ -33,6 +55,10 @@ class Epd4Spi : IoInterface
     void init(uint8_t frequency, bool debug) override;
   private:
     bool debug_enabled = true;
+    spi_transaction_t _queueTrans[EPD4SPI_QUEUE_SIZE];
+    uint8_t* _queueBuf[EPD4SPI_QUEUE_SIZE] = {};
+    uint8_t _queueIdx = 0;
+    uint8_t _queueInFlight = 0;
 };
 #endif
 // Note: using override compiler will issue an error for "changing the type"
@@ -10,6 +10,7 @@
 #include "esp_log.h"
 #include <string>
 #include <Adafruit_GFX.h>
+#include <epdghost.h>
 
 class EpdParallel : public virtual Adafruit_GFX
 {
@@ -27,6 +28,14 @@ class EpdParallel : public virtual Adafruit_GFX
     virtual void powerOn() = 0;
     virtual void powerOff() = 0;
 
+    // Ghosting scheduler for updateWindow() with partial modes (DU, GL16): the refreshes are counted in
+    // tiles and only the tiles over the budget get a clean GC16 refresh (See epdghost.h). 0 disables it
+    void setGhostBudget(uint8_t budget, uint8_t tile = EPD_GHOST_TILE) {
+      _ghost.budget = budget;
+      _ghost.tile = tile;
+      _ghost.end();
+    };
+
     // This are common methods every MODELX will inherit
     // hook to Adafruit_GFX::write
     size_t write(uint8_t);
@@ -42,6 +51,8 @@ class EpdParallel : public virtual Adafruit_GFX
     static inline uint16_t gx_uint16_max(uint16_t a, uint16_t b) {return (a > b ? a : b);};
     bool _using_partial_mode = false;
     bool debug_enabled = true;
+    // Native coordinates. Models begin() it on the first partial updateWindow()
+    EpdGhostMap _ghost;
     // Very smart template from EPD to swap x,y:
     template <typename T> static inline void
     swap(T& a, T& b)
@@ -0,0 +1,94 @@
+/**
+ * BmpStreamDecoder::Sink and EpdImageDecoder::Sink that draws into any Epd model.
+ * 1 bit rows are stored with Epd::writeRowBits() that copies whole bytes in Framebuffer models
+ *
+ * EpdDirectBmpSink sends black & white images straight to the controller RAM with
+ * the Epd direct stream, no framebuffer involved. Other bitmaps, rotated displays or
+ * models without direct stream are drawn in the framebuffer. Call update() at the end
+ */
+#ifndef epdbmpsink_h
+#define epdbmpsink_h
+#include <epd.h>
+#include <bmpstreamdecoder.h>
+#include <epdimagedecoder.h>
+#include <stdlib.h>
+#include <string.h>
+
+class EpdBmpSink : public BmpStreamDecoder::Sink, public EpdImageDecoder::Sink
+{
+  public:
+    EpdBmpSink(Epd& display) : _display(display) {};
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+      _display.drawPixel(x, y, color);
+    };
+    bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      _display.writeRowBits(y, bits, w);
+      return true;
+    };
+
+  protected:
+    Epd& _display;
+};
+
+class EpdDirectBmpSink : public EpdBmpSink
+{
+  public:
+    EpdDirectBmpSink(Epd& display) : EpdBmpSink(display) {};
+    ~EpdDirectBmpSink() { free(_row); };
+
+    void begin(BmpStreamDecoder& bmp) override {
+      _begin(bmp.rowBits());
+    };
+    void begin(EpdImageDecoder& img) override {
+      _begin(img.rowBits());
+    };
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+      if (!_direct) _display.drawPixel(x, y, color);
+    };
+    bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      if (!_direct) return EpdBmpSink::drawRowBits(y, bits, w);
+      uint16_t full = w / 8;
+      if (full > _rowBytes) full = _rowBytes;
+      memcpy(_row, bits, full);
+      // Pixels after the bitmap width are white
+      if (w % 8 && full < _rowBytes) _row[full] = bits[full] | (0xFF >> w % 8);
+      _display.writeRawRow(y, _row);
+      return true;
+    };
+    // Refreshes the display with the direct stream or the framebuffer
+    void update() {
+      if (_direct) {
+        _display.endRawWrite();
+        _direct = false;
+      } else {
+        _display.update();
+      }
+    };
+    // Leaves the display as it is. The framebuffer keeps the decoded image
+    void cancel() {
+      if (_direct) {
+        _display.cancelRawWrite();
+        _direct = false;
+      }
+    };
+
+  private:
+    bool _direct = false;
+    uint8_t *_row = nullptr;
+    uint32_t _rowBytes = 0;
+
+    void _begin(bool rowBits) {
+      free(_row);
+      _row = nullptr;
+      _direct = false;
+      // Direct stream models take 1 bpp rows with white as 1, same as the decoder rows
+      if (!rowBits || _display.getRotation() != 0 || !_display.rawRowBytes()) return;
+      _rowBytes = _display.rawRowBytes();
+      _row = (uint8_t*)malloc(_rowBytes);
+      if (_row == nullptr) return;
+      memset(_row, 0xFF, _rowBytes);
+      _direct = _display.beginRawWrite();
+    };
+};
+#endif
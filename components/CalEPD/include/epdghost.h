@@ -0,0 +1,55 @@
+/**
+ * Ghosting budget per tile. Partial waveforms (DU, GL16, the partial LUTs) leave a faint copy of
+ * the previous image that adds up with every refresh in the same place. The screen is split in
+ * tiles of tile x tile px that count the partial refreshes touching them. Only the tiles over the
+ * budget need a clean refresh, the rest of the screen keeps using the cheap path.
+ * A 960x540 screen in 32 px tiles takes 510 bytes.
+ *
+ * Coordinates are the caller ones, the same for every call (Epd uses GFX, EpdParallel native).
+ */
+#ifndef epdghost_h
+#define epdghost_h
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef EPD_GHOST_TILE
+  #define EPD_GHOST_TILE 32
+#endif
+// Partial refreshes a tile takes before it needs a clean one
+#ifndef EPD_GHOST_BUDGET
+  #define EPD_GHOST_BUDGET 8
+#endif
+
+class EpdGhostMap
+{
+  public:
+    EpdGhostMap(uint8_t budget = 0, uint8_t tile = EPD_GHOST_TILE) : budget(budget), tile(tile) {};
+    ~EpdGhostMap() { end(); };
+
+    // Every tile clean. Returns false if the counters can not be allocated, then partial() never asks for a clean
+    bool begin(uint16_t width, uint16_t height);
+    // Frees the counters. width() is 0 until the next begin()
+    void end();
+    uint16_t width() { return _width; };
+    uint16_t height() { return _height; };
+
+    // Counts a partial refresh of the rectangle. Returns true if one of its tiles went over the budget
+    bool partial(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+    // Tile aligned bounding box of the tiles over the budget, clipped to the screen. False if there are none
+    bool overBudget(uint16_t &x, uint16_t &y, uint16_t &w, uint16_t &h);
+    // The rectangle had a clean refresh: the tiles fully inside restart from 0
+    void clean(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+    void cleanAll();
+
+    // 0 disables the budget: partial() always returns false
+    uint8_t budget;
+    uint8_t tile;
+
+  private:
+    uint8_t *_count = nullptr;
+    uint16_t _width = 0;
+    uint16_t _height = 0;
+    uint16_t _cols = 0;
+    uint16_t _rows = 0;
+};
+#endif
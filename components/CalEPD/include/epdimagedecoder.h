@@ -0,0 +1,124 @@
+/**
+ * Streaming decoder for EPDI, a compact image format in the native pixel layouts of the epapers.
+ * The server (or tools/epdimage/epdimage) dithers the image beforehand so the device only expands rows.
+ *
+ * Header, 16 bytes little endian:
+ *   0  'E' 'P' 'D' 'I'
+ *   4  version (EPDI_VERSION)
+ *   5  format  EPDI_1BPP, EPDI_2BPP_GRAY, EPDI_4BPP_GRAY, EPDI_3COLOR or EPDI_7COLOR
+ *   6  flags   EPDI_LSB_FIRST: first pixel in the low bits of the byte. EPDI_PACKBITS: rows are compressed
+ *   7  reserved, 0
+ *   8  width
+ *   10 height
+ *   12 payload bytes after the header
+ * Then height rows, top-down. A row is (width * bpp + 7) / 8 bytes:
+ *   EPDI_1BPP       1 is white
+ *   EPDI_*_GRAY     0 is black, the highest value white
+ *   EPDI_3COLOR     a 1 bpp black & white plane followed by a 1 bpp color plane (1 is red/yellow)
+ *   EPDI_7COLOR     4 bit Epd7Color indexes: black, white, green, blue, red, yellow, orange
+ * With EPDI_PACKBITS the rows are PackBits encoded: a count byte n, 0..127 copies the next n + 1 bytes,
+ * 129..255 repeats the next byte 257 - n times, 128 is ignored. It needs no history, so rows can be
+ * expanded while they arrive and go straight to the framebuffer or the controller RAM.
+ *
+ * Uses the same Sink shape as BmpStreamDecoder. EpdBmpSink (epdbmpsink.h) draws into any Epd model.
+ */
+#ifndef epdimagedecoder_h
+#define epdimagedecoder_h
+#include <stdint.h>
+#include <stddef.h>
+#include <gdew_colors.h>
+
+#define EPDI_HEADER_SIZE 16
+#define EPDI_VERSION 1
+// Formats
+#define EPDI_1BPP       0x01
+#define EPDI_2BPP_GRAY  0x02
+#define EPDI_4BPP_GRAY  0x04
+#define EPDI_3COLOR     0x13
+#define EPDI_7COLOR     0x47
+// Flags
+#define EPDI_LSB_FIRST  0x01
+#define EPDI_PACKBITS   0x02
+
+class EpdImageDecoder
+{
+  public:
+    class Sink
+    {
+      public:
+        virtual ~Sink() {};
+        // Called once the header is read, before the first row
+        virtual void begin(EpdImageDecoder& img) {};
+        virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+        // Optional: w pixels of a row from x = 0. MSB first, bit 1 is white.
+        // Returning false draws the row with drawPixel()
+        virtual bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) { return false; };
+    };
+
+    // Rows and columns outside maxWidth x maxHeight are skipped
+    EpdImageDecoder(Sink& sink, uint16_t maxWidth, uint16_t maxHeight);
+    ~EpdImageDecoder();
+
+    // True if data starts like an EPDI image
+    static bool isEpdImage(const uint8_t *data, size_t len);
+
+    // Ready for a new file. Use the second one if the display rotation changed
+    void reset();
+    void reset(uint16_t maxWidth, uint16_t maxHeight);
+    // Decodes the next chunk. Returns false if the image is not supported, then the rest is ignored
+    bool write(const uint8_t *data, size_t len);
+    bool done() { return _state == EPDI_DONE; };
+    bool failed() { return _state == EPDI_ERROR; };
+    // All rows go to Sink::drawRowBits()
+    bool rowBits() { return format == EPDI_1BPP; };
+    uint8_t bpp();
+
+    // Colors sent to the Sink. Gray levels are sent as 8 bit gray: 0 black, 255 white
+    uint16_t white = EPD_WHITE;
+    uint16_t black = EPD_BLACK;
+    uint16_t red = EPD_RED;
+    // Epd7Color indexes, same values as color/wave7colors.h
+    uint16_t colors7[8] = { 0x0000, 0xFFFF, 0x07E0, 0x001F, 0xF800, 0xFFE0, 0xFD20, 0x41E8 };
+    bool debug = false;
+
+    // Header fields, valid when begin() is called
+    uint8_t version = 0;
+    uint8_t format = 0;
+    uint8_t flags = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint32_t payloadSize = 0;
+    uint32_t rowSize = 0;   // Bytes of a row, both planes for EPDI_3COLOR
+
+  private:
+    enum {
+      EPDI_HEADER,
+      EPDI_ROWS,
+      EPDI_DONE,
+      EPDI_ERROR
+    } _state = EPDI_HEADER;
+
+    Sink& _sink;
+    uint16_t _maxWidth;
+    uint16_t _maxHeight;
+
+    uint8_t _header[EPDI_HEADER_SIZE];
+    uint8_t _pos = 0;
+    uint8_t *_row = nullptr;
+    uint32_t _rowFill = 0;
+    uint16_t _y = 0;
+    uint16_t _drawWidth = 0;
+    // PackBits: bytes left of the current literal or run. _count == 0 expects a count byte
+    uint8_t _count = 0;
+    bool _repeat = false;
+    bool _repeatByte = false;  // Count read, waiting for the byte to repeat
+    uint8_t _value = 0;
+
+    static uint16_t _read16(const uint8_t *p) { return p[0] | (p[1] << 8); };
+    bool _parseHeader();
+    uint8_t _pixel(const uint8_t *src, uint16_t x, uint8_t bpp);
+    void _decodeRow(const uint8_t *src);
+    void _rowDone();
+    bool _fail(const char *reason);
+};
+#endif
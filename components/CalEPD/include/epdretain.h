@@ -0,0 +1,42 @@
+/**
+ * The image on the panel, kept PackBits compressed in RTC slow memory so it survives deep sleep.
+ * After a wake up the controller RAM is lost, so partial refresh has no "old" image to compare with.
+ * Epd::updateRetained() writes this one back as the old image and partially refreshes only the rows
+ * that changed. A clock or a dashboard compresses to a few hundred bytes: a 200x200 one is 5000
+ * bytes raw, a 800x480 one 48000.
+ *
+ * When the image does not fit in EPD_RETAIN_SIZE it is dropped and the next update is a full one.
+ */
+#ifndef epdretain_h
+#define epdretain_h
+#include <stdint.h>
+#include <stddef.h>
+
+// Bytes of RTC slow memory taken. ESP32 has 8 KB and RTC_DATA_ATTR variables of the app share it
+#ifndef EPD_RETAIN_SIZE
+  #define EPD_RETAIN_SIZE 4096
+#endif
+// Partial refreshes leave some ghosting: every N updateRetained() calls the refresh is a full one
+#ifndef EPD_RETAIN_FULL_EVERY
+  #define EPD_RETAIN_FULL_EVERY 30
+#endif
+
+class EpdRetain
+{
+  public:
+    // True if there is an image of this geometry
+    static bool valid(uint16_t width, uint16_t height, uint32_t rowBytes);
+    // Stores height rows of rowBytes. full resets the partial refresh count, otherwise it is incremented
+    static bool store(const uint8_t *buffer, uint16_t width, uint16_t height, uint32_t rowBytes, bool full);
+    static void invalidate();
+    // Partial refreshes since the last full one
+    static uint16_t partials();
+
+    // Reads the stored rows in order
+    EpdRetain();
+    void readRow(uint8_t *row);
+
+  private:
+    uint32_t _pos = 0;
+};
+#endif
@@ -1,10 +1,20 @@
 /* Implement IoInterface for SPI communication */
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "iointerface.h"
 
 #ifndef epdspi_h
 #define epdspi_h
+// Number of DMA line buffers used by the queued streaming mode. 2 is enough to
+// pack row N+1 while row N is on the wire. Must not exceed devcfg.queue_size
+#ifndef EPD_SPI_STREAM_BUFFERS
+  #define EPD_SPI_STREAM_BUFFERS 2
+#endif
+// Same as devcfg.queue_size: transactions a sequence() can have in flight
+#define EPD_SPI_QUEUE_SIZE 5
+
 class EpdSpi : IoInterface
 {
   public:
@@ -14,12 +24,45 @@ class EpdSpi : IoInterface
     void data(uint8_t data) override;
     void dataBuffer(uint8_t data);
     void data(const uint8_t *data, int len) override;
+    // Reads up to 4 bytes after a cmd(). The bus is 3 wire: the controller answers on MOSI
+    void readData(uint8_t *data, uint8_t len);
     
     void reset(uint8_t millis) override;
     void init(uint8_t frequency, bool debug) override;
+
+    // Queued DMA streaming: CPU packs the next line while the previous one is clocked out
+    // Returns a DMA capable buffer of lineBytes to be filled with the first line
+    uint8_t* streamBegin(uint16_t lineBytes);
+    // Queues len bytes of the current buffer and returns the next free one
+    uint8_t* streamPush(uint16_t len);
+    // Waits until every queued line is sent. Called also by cmd()
+    void streamEnd();
+
+    // Runs an EPD_SEQ_* sequence as queued transactions, DC is driven by pre_cb
+    // Returns the position after an EPD_SEQ_WAIT_BUSY or NULL at EPD_SEQ_END
+    const uint8_t* sequence(const uint8_t *seq);
+
+    // Sleeps the calling task until BUSY reads idleLevel using a GPIO edge interrupt
+    // Returns false on timeout
+    bool waitBusy(uint8_t idleLevel, uint32_t timeoutMs);
   private:
     bool debug_enabled = true;
+
+    uint8_t* _streamBuf[EPD_SPI_STREAM_BUFFERS] = {};
+    spi_transaction_t _streamTrans[EPD_SPI_STREAM_BUFFERS];
+    uint16_t _streamBufSize = 0;
+    uint8_t _streamIdx = 0;
+    uint8_t _streamInFlight = 0;
+
+    spi_transaction_t _seqTrans[EPD_SPI_QUEUE_SIZE];
+    uint8_t _seqIdx = 0;
+    uint8_t _seqInFlight = 0;
+    void _seqQueue(bool isData, const uint8_t *data, uint8_t len);
+    void _seqEnd();
+
+    TaskHandle_t _busyTask = NULL;
+    static void IRAM_ATTR _busyIsr(void *arg);
 };
 #endif
 // Note: using override compiler will issue an error for "changing the type"
-//       in case the type is changed.
\ No newline at end of file
+//       in case the type is changed.
@@ -0,0 +1,214 @@
+/**
+ * Compile-time framebuffer geometry and pixel writers shared by the models
+ * W, H:       RAM size in pixels
+ * BPP:        1, 2 or 4 bits per pixel
+ * BitOrder:   FB_MSB_FIRST when the leftmost pixel is in the highest bits of the byte
+ * WhiteValue: 1 bpp only. Bit written for a color != 0 (EPD_WHITE)
+ * VisibleW:   Width used to mirror x when rotating pixels if the RAM is wider than the glass.
+ *             RAM x outside [0, VisibleW) is not written: GFX coordinates up to W still pass
+ *             the model bounds check when rotated, the rotation math is signed
+ *
+ * Everything is static and inlined in the model drawPixel so every rotation gets its
+ * own writer with constant geometry instead of the bounds/rotation/index copy per model.
+ * fillRect() rotates a span once and writes whole bytes with masked edges.
+ * The *Band() variants write into a band buffer that holds only the RAM rows [y0, y0 + rows)
+ * writeRowBits() stores a decoded 1 bpp image row (See BmpStreamDecoder)
+ */
+#ifndef framebuffer_h
+#define framebuffer_h
+#include <stdint.h>
+#include <string.h>
+
+#define FB_MSB_FIRST 0
+#define FB_LSB_FIRST 1
+
+template <uint16_t W, uint16_t H, uint8_t BPP = 1, uint8_t BitOrder = FB_MSB_FIRST,
+          uint8_t WhiteValue = 1, uint16_t VisibleW = W>
+class Framebuffer
+{
+  static_assert(BPP == 1 || BPP == 2 || BPP == 4, "Framebuffer BPP should be 1, 2 or 4");
+
+  public:
+    static constexpr uint16_t width = W;
+    static constexpr uint16_t height = H;
+    static constexpr uint8_t pixelsPerByte = 8 / BPP;
+    static constexpr uint32_t rowBytes = ((uint32_t)W * BPP + 7) / 8;
+    static constexpr uint32_t size = rowBytes * H;
+    // 8 pixels white / black in 1 bpp
+    static constexpr uint8_t white8 = WhiteValue ? 0xFF : 0x00;
+    static constexpr uint8_t black8 = WhiteValue ? 0x00 : 0xFF;
+
+    // Value stored for color: for BPP > 1 color is a 8 bit gray and the top BPP bits are kept
+    static inline uint8_t pixelValue(uint16_t color)
+    {
+      if (BPP == 1) return ((color != 0) == (WhiteValue != 0)) ? 1 : 0;
+      return (color >> (8 - BPP)) & ((1 << BPP) - 1);
+    }
+
+    // Pixel in RAM coordinates (rotation 0)
+    static inline void setPixel(uint8_t *buf, uint16_t x, uint16_t y, uint16_t color)
+    {
+      uint8_t *p = &buf[x / pixelsPerByte + (uint32_t)y * rowBytes];
+      constexpr uint8_t mask = (1 << BPP) - 1;
+      const uint8_t shift = (BitOrder == FB_MSB_FIRST) ?
+        (pixelsPerByte - 1 - x % pixelsPerByte) * BPP : (x % pixelsPerByte) * BPP;
+      if (BPP == 1) {
+        if ((color != 0) == (WhiteValue != 0)) {
+          *p |= (1 << shift);
+        } else {
+          *p &= ~(1 << shift);
+        }
+        return;
+      }
+      *p = (*p & ~(mask << shift)) | (((color >> (8 - BPP)) & mask) << shift);
+    }
+
+    // GFX coordinates to RAM ones. Returns false if the RAM x is outside [0, VisibleW)
+    static inline bool rotatePixel(int16_t &x, int16_t &y, uint8_t rotation)
+    {
+      int16_t t;
+      switch (rotation)
+      {
+        case 1:
+          t = x; x = (int16_t)VisibleW - y - 1; y = t;
+          break;
+        case 2:
+          x = (int16_t)VisibleW - x - 1;
+          y = (int16_t)H - y - 1;
+          break;
+        case 3:
+          t = x; x = y; y = (int16_t)H - t - 1;
+          break;
+      }
+      return x >= 0 && x < (int16_t)VisibleW && y >= 0 && y < (int16_t)H;
+    }
+
+    // Same for a rectangle. w and h are swapped in rotations 1 and 3
+    static inline void rotateRect(int16_t &x, int16_t &y, int16_t &w, int16_t &h, uint8_t rotation)
+    {
+      int16_t t;
+      switch (rotation)
+      {
+        case 1:
+          t = x; x = (int16_t)VisibleW - y - h; y = t;
+          t = w; w = h; h = t;
+          break;
+        case 2:
+          x = (int16_t)VisibleW - x - w;
+          y = (int16_t)H - y - h;
+          break;
+        case 3:
+          t = x; x = y; y = (int16_t)H - t - w;
+          t = w; w = h; h = t;
+          break;
+      }
+    }
+
+    // Pixel in GFX coordinates. Bounds are checked by the caller against width() / height()
+    static inline void drawPixel(uint8_t *buf, int16_t x, int16_t y, uint16_t color, uint8_t rotation)
+    {
+      if (rotatePixel(x, y, rotation)) setPixel(buf, x, y, color);
+    }
+
+    // Rectangle in RAM coordinates. x is clipped to [0, VisibleW), y should be in the buffer
+    static inline void fillRaw(uint8_t *buf, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+    {
+      if (x < 0) { w += x; x = 0; }
+      if (x + w > (int16_t)VisibleW) w = (int16_t)VisibleW - x;
+      if (w <= 0 || h <= 0) return;
+      // Pixel value repeated in all the byte: 1 bpp * 0xFF, 2 bpp * 0x55, 4 bpp * 0x11
+      const uint8_t pattern = pixelValue(color) * (0xFF / ((1 << BPP) - 1));
+      const uint32_t xb0 = x / pixelsPerByte;
+      const uint32_t xb1 = (x + w - 1) / pixelsPerByte;
+      const uint8_t first = (x % pixelsPerByte) * BPP;
+      const uint8_t last = (pixelsPerByte - 1 - (x + w - 1) % pixelsPerByte) * BPP;
+      uint8_t m0, m1;
+      if (BitOrder == FB_MSB_FIRST) {
+        m0 = 0xFF >> first;
+        m1 = (uint8_t)(0xFF << last);
+      } else {
+        m0 = (uint8_t)(0xFF << first);
+        m1 = 0xFF >> last;
+      }
+      if (xb0 == xb1) m0 &= m1;
+      uint8_t *row = &buf[(uint32_t)y * rowBytes];
+      for (uint16_t r = 0; r < h; ++r, row += rowBytes) {
+        row[xb0] = (row[xb0] & ~m0) | (pattern & m0);
+        if (xb1 > xb0) {
+          memset(&row[xb0 + 1], pattern, xb1 - xb0 - 1);
+          row[xb1] = (row[xb1] & ~m1) | (pattern & m1);
+        }
+      }
+    }
+
+    // Rectangle in GFX coordinates, clipped by the caller. Rotation is resolved once per span
+    static inline void fillRect(uint8_t *buf, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, uint8_t rotation)
+    {
+      rotateRect(x, y, w, h, rotation);
+      if (y < 0) { h += y; y = 0; }
+      if (y + h > (int16_t)H) h = (int16_t)H - y;
+      fillRaw(buf, x, y, w, h, color);
+    }
+
+    static inline void drawPixelBand(uint8_t *band, int16_t x, int16_t y, uint16_t color, uint8_t rotation,
+                                     uint16_t y0, uint16_t rows)
+    {
+      if (!rotatePixel(x, y, rotation)) return;
+      if (y < y0 || y >= y0 + rows) return;
+      setPixel(band, x, y - y0, color);
+    }
+
+    static inline void fillRectBand(uint8_t *band, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color,
+                                    uint8_t rotation, uint16_t y0, uint16_t rows)
+    {
+      rotateRect(x, y, w, h, rotation);
+      int16_t y1 = y + h;
+      if (y < y0) y = y0;
+      if (y1 > y0 + rows) y1 = y0 + rows;
+      if (y >= y1) return;
+      fillRaw(band, x, y - y0, w, y1 - y, color);
+    }
+
+    // GFX row y from x = 0: w pixels of 1 bpp, MSB first, bit 1 is white. Clipped by the caller.
+    // Rotation 0 in 1 bpp RAM copies whole bytes, the rest goes pixel by pixel
+    static inline void writeRowBits(uint8_t *buf, int16_t y, const uint8_t *bits, uint16_t w, uint8_t rotation)
+    {
+      if (BPP == 1 && BitOrder == FB_MSB_FIRST && rotation == 0) {
+        uint8_t *row = &buf[(uint32_t)y * rowBytes];
+        const uint16_t full = w / 8;
+        for (uint16_t i = 0; i < full; ++i) row[i] = WhiteValue ? bits[i] : ~bits[i];
+        if (w % 8) {
+          const uint8_t mask = (uint8_t)(0xFF << (8 - w % 8));
+          const uint8_t value = WhiteValue ? bits[full] : ~bits[full];
+          row[full] = (row[full] & ~mask) | (value & mask);
+        }
+        return;
+      }
+      for (uint16_t x = 0; x < w; ++x) {
+        drawPixel(buf, x, y, (bits[x / 8] & (0x80 >> x % 8)) ? 0xFFFF : 0x0000, rotation);
+      }
+    }
+
+    // Converts a window in GFX coordinates to RAM coordinates (Used by updateWindow). Same math as
+    // rotateRect(), the part outside the RAM is cut. Nothing left returns x = W, that updateWindow() skips
+    static inline void rotateWindow(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h, uint8_t rotation)
+    {
+      int16_t rx = x, ry = y, rw = w, rh = h;
+      rotateRect(rx, ry, rw, rh, rotation);
+      if (rx < 0) { rw += rx; rx = 0; }
+      if (ry < 0) { rh += ry; ry = 0; }
+      if (rx + rw > (int16_t)VisibleW) rw = (int16_t)VisibleW - rx;
+      if (ry + rh > (int16_t)H) rh = (int16_t)H - ry;
+      if (rw <= 0 || rh <= 0) {
+        x = W;
+        y = H;
+        w = h = 0;
+        return;
+      }
+      x = rx;
+      y = ry;
+      w = rw;
+      h = rh;
+    }
+};
+#endif
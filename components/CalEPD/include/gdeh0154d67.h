@@ -10,6 +10,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include <gdew_colors.h>
@@ -45,6 +46,15 @@ class Gdeh0154d67 : public Epd
     void updateWindow(int16_t x, int16_t y, int16_t w, int16_t h, bool using_rotation = true);
 
   private:
+    typedef Framebuffer<GDEH0154D67_WIDTH, GDEH0154D67_HEIGHT, 1, FB_MSB_FIRST, 0> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
     uint8_t _buffer[GDEH0154D67_BUFFER_SIZE];
     bool color = false;
@@ -52,6 +62,7 @@ class Gdeh0154d67 : public Epd
     bool _partial_mode = false;
     bool _debug_buffer = false;
     void _PowerOn();
+    static const uint8_t epd_wakeup_sequence[];
     void _setRamDataEntryMode(uint8_t em);
     void _SetRamArea(uint8_t Xstart, uint8_t Xend, uint8_t Ystart, uint8_t Ystart1, uint8_t Yend, uint8_t Yend1);
     void _SetRamPointer(uint8_t addrX, uint8_t addrY, uint8_t addrY1);
@@ -62,4 +73,19 @@ class Gdeh0154d67 : public Epd
     void _waitBusy(const char* message, uint16_t busy_time);
     void _waitBusy(const char* message);
     void _rotate(int16_t& x, int16_t& y, int16_t& w, int16_t& h);
+    // Direct stream: controller format, white is 1
+    uint32_t _rawRowBytes() override { return Fb::rowBytes; };
+    void _rawStart() override;
+    void _rawRow(uint16_t y, const uint8_t *row) override;
+    void _rawFinish() override;
+    uint16_t _raw_y = 0;         // RAM row the controller writes next
+    int8_t _raw_step = 1;        // +1 or -1 following the Y entry mode
+    // Retained image: the whole old (0x26) and new (0x24) RAM are written, the partial refresh compares them
+    const uint8_t* _retainBuffer(uint32_t& rowBytes) override {
+      rowBytes = Fb::rowBytes;
+      return _buffer;
+    };
+    void _retainStart(uint16_t y0, uint16_t y1) override;
+    void _retainOldRow(uint16_t y, const uint8_t *row) override;
+    void _retainFinish(uint16_t y0, uint16_t y1) override;
 };
\ No newline at end of file
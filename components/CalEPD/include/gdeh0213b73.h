@@ -9,6 +9,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include <gdew_colors.h>
@@ -52,6 +53,15 @@ class Gdeh0213b73 : public Epd
     void updateToWindow(uint16_t xs, uint16_t ys, uint16_t xd, uint16_t yd, uint16_t w, uint16_t h, bool using_rotation = true);
 
   private:
+    typedef Framebuffer<GDEH0213B73_WIDTH, GDEH0213B73_HEIGHT, 1, FB_MSB_FIRST, 0, GDEH0213B73_VISIBLE_WIDTH> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEH0213B73_BUFFER_SIZE];
@@ -9,6 +9,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include <gdew_colors.h>
@@ -47,6 +48,15 @@ class Gdew0213i5f : public Epd
     // This are already inherited from Epd: write(uint8_t); print(const std::string& text);println(same);
 
   private:
+    typedef Framebuffer<GDEW0213I5F_WIDTH, GDEW0213I5F_HEIGHT, 1, FB_MSB_FIRST, 1> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEW0213I5F_BUFFER_SIZE];
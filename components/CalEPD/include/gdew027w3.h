@@ -9,6 +9,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include <gdew_colors.h>
@@ -40,6 +41,15 @@ class Gdew027w3 : public Epd
     void updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool using_rotation = true);
 
   private:
+    typedef Framebuffer<GDEW027W3_WIDTH, GDEW027W3_HEIGHT, 1, FB_MSB_FIRST, 0> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
     uint8_t _buffer[GDEW027W3_BUFFER_SIZE];
     bool color = false;
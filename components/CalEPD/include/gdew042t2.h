@@ -10,6 +10,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include <gdew_colors.h>
@@ -44,6 +45,15 @@ class Gdew042t2 : public Epd
     // This are already inherited from Epd: write(uint8_t); print(const std::string& text);println(same);
 
   private:
+    typedef Framebuffer<GDEW042T2_WIDTH, GDEW042T2_HEIGHT, 1, FB_MSB_FIRST, 1> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEW042T2_BUFFER_SIZE];
@@ -69,9 +79,5 @@ class Gdew042t2 : public Epd
     static const epd_init_42 lut_23_wb_partial;
     static const epd_init_42 lut_24_bb_partial;
 
-    static const epd_power_4 epd_wakeup_power;
-    static const epd_init_3 epd_soft_start;
-    static const epd_init_1 epd_panel_setting;
-    static const epd_init_1 epd_pll;
-    static const epd_init_4 epd_resolution;
+    static const uint8_t epd_wakeup_sequence[];
 };
\ No newline at end of file
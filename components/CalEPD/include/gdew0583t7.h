@@ -10,10 +10,12 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include "soc/rtc_wdt.h"
 #include <gdew_colors.h>
+#include <il0371.h>
 
 #define GDEW0583T7_WIDTH 600
 #define GDEW0583T7_HEIGHT 448
@@ -39,6 +41,15 @@ class Gdew0583T7 : public Epd
     // This are already inherited from Epd: write(uint8_t); print(const std::string& text);println(same);
 
   private:
+    typedef Framebuffer<GDEW0583T7_WIDTH, GDEW0583T7_HEIGHT, 1, FB_MSB_FIRST, 0> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEW0583T7_BUFFER_SIZE];
@@ -60,11 +71,6 @@ class Gdew0583T7 : public Epd
     static const epd_init_42 lut_24_LUTKK_partial;
     static const epd_init_42 lut_25_LUTBD_partial;
     
-    static const epd_init_2 epd_wakeup_power;
-    static const epd_init_2 epd_panel_setting;
-    static const epd_init_3 epd_boost;
+    static const uint8_t epd_wakeup_sequence[];
     static const epd_init_1 epd_panel_setting_partial;
-    static const epd_init_1 epd_pll;
-    static const epd_init_1 epd_temperature;
-    static const epd_init_4 epd_resolution;
 };
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include "soc/rtc_wdt.h"
@@ -43,6 +44,15 @@ class Gdew075HD : public Epd
     void update();
 
   private:
+    typedef Framebuffer<GDEW075HD_WIDTH, GDEW075HD_HEIGHT, 1, FB_MSB_FIRST, 1> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEW075HD_BUFFER_SIZE];
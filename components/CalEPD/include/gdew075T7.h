@@ -10,6 +10,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include "soc/rtc_wdt.h"
@@ -21,6 +22,9 @@
 // EPD comment: Pixel number expressed in bytes; this is neither the buffer size nor the size of the buffer in the controller
 // We are not adding page support so here this is our Buffer size
 #define GDEW075T7_BUFFER_SIZE (uint32_t(GDEW075T7_WIDTH) * uint32_t(GDEW075T7_HEIGHT) / 8)
+// Busy timeout in millis when the temperature is unknown. Replaces the additional 2 seconds wait: in low temperatures full update takes longer
+#define GDEW075T7_BUSY_TIMEOUT 8000
+
 // 8 pix of this color in a buffer byte:
 #define GDEW075T7_8PIX_BLACK 0x00
 #define GDEW075T7_8PIX_WHITE 0xFF
@@ -38,6 +42,8 @@ class Gdew075T7 : public Epd
     void init(bool debug = false);
     void initFullUpdate();
     void initPartialUpdate();
+    // Register LUT for setRefreshMode(EPD_REFRESH_FAST)
+    void initFastUpdate();
     // Partial update of rectangle from buffer to screen, does not power off
     void updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool using_rotation);
     void fillScreen(uint16_t color);
@@ -46,6 +52,15 @@ class Gdew075T7 : public Epd
     void update();
 
   private:
+    typedef Framebuffer<GDEW075T7_WIDTH, GDEW075T7_HEIGHT, 1, FB_MSB_FIRST, 1> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEW075T7_BUFFER_SIZE];
@@ -54,12 +69,37 @@ class Gdew075T7 : public Epd
 
     bool _using_partial_mode = false;
     bool _initial = true;
+    bool _old_valid = false;     // DTM1 holds the image on the panel: partial refresh is possible
+    void _initUpdate();
     
     uint16_t _setPartialRamArea(uint16_t x, uint16_t y, uint16_t xe, uint16_t ye);
     void _wakeUp();
     void _sleep();
+    bool _panelPowerOn() override;
+    bool _panelPowerOff() override;
+    int8_t _readTemperature() override;
+    static const epd_temperature_band temperature_bands[];
+    uint32_t _busy_timeout = GDEW075T7_BUSY_TIMEOUT;
     void _waitBusy(const char* message);
     void _rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h);
+    // Direct stream: row format is the same as _buffer, white is 1
+    uint32_t _rawRowBytes() override { return Fb::rowBytes; };
+    void _rawStart() override;
+    void _rawRow(uint16_t y, const uint8_t *row) override;
+    void _rawFinish() override;
+    uint8_t *_raw_buf = nullptr;
+    uint16_t _raw_y = 0;         // RAM row the controller writes next
+    bool _raw_partial = false;
+    bool _raw_flip = false;      // Bottom-up stream: RAM row 0 is the last screen row
+    // Retained image: rows y0..y1 go to a partial window, old image in DTM1 and new in DTM2
+    const uint8_t* _retainBuffer(uint32_t& rowBytes) override {
+      rowBytes = Fb::rowBytes;
+      return _buffer;
+    };
+    void _retainStart(uint16_t y0, uint16_t y1) override;
+    void _retainOldRow(uint16_t y, const uint8_t *row) override;
+    void _retainFinish(uint16_t y0, uint16_t y1) override;
+    uint16_t _retain_y1 = 0;
     
     // Command & data structs
     // LUT tables for this display are filled with zeroes at the end with writeLuts()
@@ -69,10 +109,14 @@ class Gdew075T7 : public Epd
     static const epd_init_42 lut_23_LUTWK_partial;
     static const epd_init_42 lut_24_LUTKK_partial;
     static const epd_init_42 lut_25_LUTBD_partial;
+    static const epd_init_42 lut_20_LUTC_fast;
+    static const epd_init_42 lut_21_LUTWW_fast;
+    static const epd_init_42 lut_22_LUTKW_fast;
+    static const epd_init_42 lut_23_LUTWK_fast;
+    static const epd_init_42 lut_24_LUTKK_fast;
+    static const epd_init_42 lut_25_LUTBD_fast;
     
-    static const epd_power_4 epd_wakeup_power;
+    static const uint8_t epd_wakeup_sequence[];
     static const epd_init_1 epd_panel_setting_full;
     static const epd_init_1 epd_panel_setting_partial;
-    static const epd_init_1 epd_pll;
-    static const epd_init_4 epd_resolution;
 };
\ No newline at end of file
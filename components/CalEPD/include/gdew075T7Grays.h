@@ -13,6 +13,7 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include "soc/rtc_wdt.h"
@@ -48,6 +49,11 @@ class Gdew075T7Grays : public Epd
     void update();
 
   private:
+    typedef Framebuffer<GDEW075T7_WIDTH, GDEW075T7_HEIGHT, 4, FB_LSB_FIRST> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
     EpdSpi& IO;
     uint8_t* _buffer = (uint8_t*)heap_caps_malloc(GDEW075T7_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
 
@@ -10,10 +10,12 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epdspi.h>
 #include "soc/rtc_wdt.h"
 #include <gdew_colors.h>
+#include <il0371.h>
 
 #define GDEW075T8_WIDTH 640
 #define GDEW075T8_HEIGHT 384
@@ -42,6 +44,15 @@ class Gdew075T8 : public Epd
     void update();
 
   private:
+    typedef Framebuffer<GDEW075T8_WIDTH, GDEW075T8_HEIGHT, 1, FB_MSB_FIRST, 0> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      return true;
+    };
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     EpdSpi& IO;
 
     uint8_t _buffer[GDEW075T8_BUFFER_SIZE];
@@ -54,5 +65,4 @@ class Gdew075T8 : public Epd
     void _waitBusy(const char* message);
     void _rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h);
     void _send8pixel(uint8_t data);
-    void _send8pixelPack(uint8_t data);
 };
\ No newline at end of file
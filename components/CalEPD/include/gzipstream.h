@@ -0,0 +1,74 @@
+/**
+ * Streaming HTTP content decoding: gzip or deflate chunks in, plain chunks out to a callback.
+ * Uses the tinfl inflater in the ESP32 ROM, so it costs no flash. The heap it needs
+ * (the 32 KB deflate window and the tinfl state) is only taken between begin() and end()
+ * and only for compressed content. Identity content is passed through untouched.
+ *
+ * Meant to sit between HTTP_EVENT_ON_DATA and a streaming decoder like BmpStreamDecoder.
+ */
+#ifndef gzipstream_h
+#define gzipstream_h
+#include <stdint.h>
+#include <stddef.h>
+
+class GzipStream
+{
+  public:
+    // Returning false stops the stream: write() returns false from then on
+    typedef bool (*Output)(const uint8_t *data, size_t len, void *arg);
+
+    enum Encoding {
+      GZ_IDENTITY,
+      GZ_GZIP,     // RFC 1952
+      GZ_DEFLATE   // RFC 1950 zlib stream, what HTTP calls deflate
+    };
+
+    GzipStream(Output output, void *arg = nullptr) : _output(output), _arg(arg) {};
+    ~GzipStream() { end(); };
+
+    // Content-Encoding header value to Encoding. Unknown values are identity
+    static Encoding encoding(const char *contentEncoding);
+
+    // Ready for a new body. Returns false if the inflater can not be allocated
+    bool begin(Encoding encoding);
+    bool write(const uint8_t *data, size_t len);
+    // Frees the inflater
+    void end();
+    // The whole compressed stream, trailer included, was read
+    bool done() { return _state == GZ_DONE; };
+    bool failed() { return _state == GZ_ERROR; };
+    // Plain bytes sent to the output
+    uint32_t size() { return _size; };
+
+  private:
+    enum {
+      GZ_HEADER,      // 10 fixed bytes
+      GZ_EXTRA_LEN,
+      GZ_EXTRA,
+      GZ_NAME,
+      GZ_COMMENT,
+      GZ_HEADER_CRC,
+      GZ_INFLATE,
+      GZ_TRAILER,     // CRC32 and size
+      GZ_PASS,        // Identity
+      GZ_DONE,
+      GZ_ERROR
+    } _state = GZ_PASS;
+
+    Output _output;
+    void *_arg;
+    Encoding _encoding = GZ_IDENTITY;
+    void *_inflator = nullptr;    // tinfl_decompressor
+    uint8_t *_window = nullptr;   // Output ring, also the deflate dictionary
+    uint32_t _windowPos = 0;
+    uint32_t _size = 0;
+    uint8_t _flags = 0;
+    uint8_t _header[10];
+    uint16_t _pos = 0;
+    uint16_t _skip = 0;
+
+    bool _fail(const char *reason);
+    bool _inflate(const uint8_t *&data, size_t &len);
+    void _nextHeaderField();
+};
+#endif
@@ -0,0 +1,31 @@
+/**
+ * Pixel format of the IL0371 in black & white mode (Gdew0583T7, Gdew075T8): the controller RAM takes
+ * 4 bits per pixel, 0x0 black and 0x3 white, so 8 framebuffer pixels are 4 bytes on the wire.
+ */
+#ifndef il0371_h
+#define il0371_h
+#include <stdint.h>
+
+// Framebuffer bit 1 is black, as the _buffer of these models keeps it
+static inline void il0371Pack8(uint8_t data, uint8_t *out)
+{
+  for (uint8_t j = 0; j < 4; j++)
+  {
+    uint8_t t = data & 0x80 ? 0x00 : 0x03;
+    t <<= 4;
+    data <<= 1;
+    t |= data & 0x80 ? 0x00 : 0x03;
+    data <<= 1;
+    out[j] = t;
+  }
+}
+
+// bytes framebuffer bytes into bytes * 4 controller bytes, one row of a window or of the screen
+static inline void il0371PackRow(const uint8_t *row, uint8_t *out, uint16_t bytes)
+{
+  for (uint16_t x = 0; x < bytes; x++)
+  {
+    il0371Pack8(row[x], &out[x * 4]);
+  }
+}
+#endif
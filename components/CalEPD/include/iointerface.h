@@ -1,6 +1,22 @@
 /* Interface that should be implemented by IO classes */
 #ifndef iointerface_h
 #define iointerface_h
+
+/* Compact command sequences (init tables) for IO classes that implement sequence()
+ * Data bytes are sent one per transaction, as the controllers need it
+ * Every entry starts with an opcode:
+ *   EPD_SEQ_CMD, cmd, n, d0..dn-1   command followed by n data bytes (n can be 0)
+ *   EPD_SEQ_DATA, n, d0..dn-1       additional data run for the last command
+ *   EPD_SEQ_DELAY, ms               wait ms milliseconds (max 255)
+ *   EPD_SEQ_WAIT_BUSY               return to the caller so it can run its _waitBusy()
+ *   EPD_SEQ_END                     end of the sequence
+ */
+#define EPD_SEQ_END       0x00
+#define EPD_SEQ_CMD       0x01
+#define EPD_SEQ_DATA      0x02
+#define EPD_SEQ_DELAY     0x03
+#define EPD_SEQ_WAIT_BUSY 0x04
+
 class IoInterface
 {
   public:
@@ -10,4 +26,4 @@ class IoInterface
     virtual void reset(uint8_t millis);
     virtual void init(uint8_t frequency,bool debug);
 };
-#endif
\ No newline at end of file
+#endif
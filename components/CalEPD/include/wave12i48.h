@@ -10,9 +10,11 @@
 #include "esp_log.h"
 #include <string>
 #include <epd.h>
+#include <framebuffer.h>
 #include <Adafruit_GFX.h>
 #include <epd4spi.h>
 #include "soc/rtc_wdt.h"       // Watchdog control
+#include "esp_heap_caps.h"
 #include <gdew_colors.h>
 
 #define WAVE12I48_WIDTH 1304
@@ -47,9 +49,25 @@ class Wave12I48 : public Epd
     void update();
 
   private:
+    typedef Framebuffer<WAVE12I48_WIDTH, WAVE12I48_HEIGHT, 1, FB_MSB_FIRST, 1> Fb;
+    bool _fillSpan(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+      if (_page_rows) {
+        Fb::fillRectBand(_page_buffer, x, y, w, h, color, getRotation(), _page_y, _page_rows);
+      } else if (_buffer != NULL) {
+        Fb::fillRect(_buffer, x, y, w, h, color, getRotation());
+      }
+      return true;
+    };
+    // Paged bands are drawn pixel by pixel
+    bool _writeRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      if (_page_rows || _buffer == NULL) return false;
+      Fb::writeRowBits(_buffer, y, bits, w, getRotation());
+      return true;
+    };
     Epd4Spi& IO;
 
-    uint8_t _buffer[WAVE12I48_BUFFER_SIZE];
+    // Full buffer lives in PSRAM. Without it only drawPaged() can be used
+    uint8_t* _buffer = (uint8_t*)heap_caps_malloc(WAVE12I48_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
 
     bool _initial = true;
     
@@ -57,11 +75,13 @@ class Wave12I48 : public Epd
     void _powerOn();
     void _sleep();
     void _waitBusy(const char* message);
-    void _waitBusyM1(const char* message);
-    void _waitBusyM2(const char* message);
-    void _waitBusyS1(const char* message);
-    void _waitBusyS2(const char* message);
+    void _waitBusy(const char* message, uint8_t controllers);
     void _rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h);
+    void _sendRow(uint16_t y, const uint8_t *row);
+    uint32_t _pageRowBytes() override { return Fb::rowBytes; };
+    void _pageStart() override;
+    void _pageSend() override;
+    void _pageFinish() override;
     
     // Command & data structs
     static const epd_init_1 epd_panel_setting_full;
@@ -63,10 +63,7 @@ class Wave12I48RB : public Epd
     void _sleep();
     void _setLut();
     void _waitBusy(const char* message);
-    void _waitBusyM1(const char* message);
-    void _waitBusyM2(const char* message);
-    void _waitBusyS1(const char* message);
-    void _waitBusyS2(const char* message);
+    void _waitBusy(const char* message, uint8_t controllers);
     void _rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h);
     
     // Command & data structs
@@ -196,23 +196,9 @@ void Gdeh0154z90::_waitBusy(const char *message)
     {
         ESP_LOGI(TAG, "_waitBusy for %s", message);
     }
-    int64_t time_since_boot = esp_timer_get_time();
 
-    while (1)
-    {
-        // On low is not busy anymore
-        if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0)
-            break;
-        vTaskDelay(1);
-        if (esp_timer_get_time() - time_since_boot > 7000000)
-        {
-            if (debug_enabled)
-            {
-                ESP_LOGI(TAG, "Busy Timeout");
-            }
-            break;
-        }
-    }
+    // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+    if (!IO.waitBusy(0, 7000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdeh0154z90::_rotate(int16_t &x, int16_t &y, int16_t &w, int16_t &h)
@@ -59,17 +59,9 @@ void Gdeh042Z21::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdeh042Z21::_sleep(){
@@ -105,26 +97,28 @@ void Gdeh042Z21::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 
 void Gdeh042Z21::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
 
 
   // BLACK: Write RAM for black(0)/white (1)
-  // v2 SPI optimizing. Check: https://github.com/martinberlin/cale-idf/wiki/About-SPI-optimization
+  // v3 SPI optimizing: x1buf is a DMA buffer, next line is packed while the previous is queued
   uint16_t i = 0;
   uint8_t xLineBytes = GDEH042Z21_WIDTH/8;
-  uint8_t x1buf[xLineBytes];
+  uint8_t *x1buf;
 
 // Note that in IC specs is 0x10 BLACK and 0x13 RED
 // BLACK: Write RAM
   IO.cmd(0x10);
+  x1buf = IO.streamBegin(xLineBytes);
   for(uint16_t y =  1; y <= GDEH042Z21_HEIGHT; y++) {
         for(uint16_t x = 1; x <= xLineBytes; x++) {
           uint8_t data = i < sizeof(_black_buffer) ? _black_buffer[i] : GDEH042Z21_8PIX_WHITE;
           x1buf[x-1] = data;
-          if (x==xLineBytes) { // Flush the X line buffer to SPI
-            IO.data(x1buf,sizeof(x1buf));
+          if (x==xLineBytes) { // Queue the X line buffer to SPI
+            x1buf = IO.streamPush(xLineBytes);
           }
           ++i;
         }
@@ -134,21 +128,23 @@ void Gdeh042Z21::update()
 
   // RED: Write RAM
   IO.cmd(0x13);
+  x1buf = IO.streamBegin(xLineBytes);
     for(uint16_t y =  1; y <= GDEH042Z21_HEIGHT; y++) {
         for(uint16_t x = 1; x <= xLineBytes; x++) {
           uint8_t data = i < sizeof(_red_buffer) ? _red_buffer[i] : GDEH042Z21_8PIX_RED_WHITE;
           //printf("%x ",data);
           x1buf[x-1] = data;
           if (x==xLineBytes) {
-            IO.data(x1buf,sizeof(x1buf));
+            x1buf = IO.streamPush(xLineBytes);
           }
           ++i;
         }
     }
-  
+  IO.streamEnd();
 
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x12);     //DISPLAY REFRESH 
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
 
   _waitBusy("epaper refresh");
   uint64_t powerOnTime = esp_timer_get_time();
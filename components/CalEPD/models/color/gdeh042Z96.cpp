@@ -111,23 +111,25 @@ void Gdeh042Z96::_wakeUp(){
 
 void Gdeh042Z96::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   _wakeUp();
   
   // BLACK: Write RAM for black(0)/white (1)
   IO.cmd(0x24);
-  // v2 SPI optimizing. Check: https://github.com/martinberlin/cale-idf/wiki/About-SPI-optimization
+  // v3 SPI optimizing: x1buf is a DMA buffer, next line is packed while the previous is queued
   uint16_t i = 0;
   uint8_t xLineBytes = GDEH042Z96_WIDTH/8;
-  uint8_t x1buf[xLineBytes];
+  uint8_t *x1buf;
   // Curiosity doing it x++ is mirrored
+  x1buf = IO.streamBegin(xLineBytes);
 
     for(uint16_t y =  1; y <= GDEH042Z96_HEIGHT; y++) {
         for(uint16_t x = 1; x <= xLineBytes; x++) {
           uint8_t data = i < sizeof(_black_buffer) ? _black_buffer[i] : GDEH042Z96_8PIX_WHITE;
           x1buf[x-1] = data;
-          if (x==xLineBytes) { // Flush the X line buffer to SPI
-            IO.data(x1buf,sizeof(x1buf));
+          if (x==xLineBytes) { // Queue the X line buffer to SPI
+            x1buf = IO.streamPush(xLineBytes);
           }
           ++i;
         }
@@ -136,21 +138,24 @@ void Gdeh042Z96::update()
   // RED: Write RAM for red(1)/white (0)
   i = 0;
   IO.cmd(0x26);
+  x1buf = IO.streamBegin(xLineBytes);
     for(uint16_t y =  1; y <= GDEH042Z96_HEIGHT; y++) {
         for(uint16_t x = 1; x <= xLineBytes; x++) {
           uint8_t data = i < sizeof(_red_buffer) ? _red_buffer[i] : GDEH042Z96_8PIX_RED_WHITE;
           x1buf[x-1] = data;
           if (x==xLineBytes) {
-            IO.data(x1buf,sizeof(x1buf));
+            x1buf = IO.streamPush(xLineBytes);
           }
           ++i;
         }
     }
+  IO.streamEnd();
 
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x22);  //Display Update Control
   IO.data(0xC7);   
   IO.cmd(0x20);  //Activate Display Update Sequence
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   uint64_t powerOnTime = esp_timer_get_time();
 
@@ -167,17 +172,9 @@ void Gdeh042Z96::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdeh042Z96::_sleep(){
@@ -117,6 +117,7 @@ void Gdew075C64::_wakeUp()
 
 void Gdew075C64::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
@@ -160,6 +161,7 @@ void Gdew075C64::update()
 
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
 
   _waitBusy("update");
   uint64_t updateTime = esp_timer_get_time();
@@ -182,20 +184,9 @@ void Gdew075C64::_waitBusy(const char *message)
   {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1)
-  {
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1)
-      break;
-    vTaskDelay(1);
-    if (esp_timer_get_time() - time_since_boot > 2000000)
-    {
-      if (debug_enabled)
-        ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew075C64::_sleep()
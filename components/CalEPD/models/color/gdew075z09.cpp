@@ -117,6 +117,7 @@ void Gdew075z09::_wakeUp(){
 
 void Gdew075z09::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
@@ -136,6 +137,7 @@ void Gdew075z09::update()
   
   }
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   
   uint64_t endTime = esp_timer_get_time();
   _waitBusy("update");
@@ -156,17 +158,9 @@ void Gdew075z09::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
   // In this controller BUSY == 0 
-  while (true){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew075z09::_sleep(){
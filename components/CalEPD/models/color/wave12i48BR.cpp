@@ -134,8 +134,7 @@ void Wave12I48RB::_powerOn(){
   IO.cmdM2(0x04);
   vTaskDelay(pdMS_TO_TICKS(300));
   IO.cmdM1S1M2S2(0x12);
-  _waitBusyM1("display refresh");
-  _waitBusyM2("display refresh");
+  _waitBusy("display refresh", EPD4SPI_ALL);
 }
 
 void Wave12I48RB::_setLut(){
@@ -284,6 +283,7 @@ void Wave12I48RB::update()
 
   IO.cmdM1S1M2S2(0x10); // Black buffer
   // Optimized to send in 81/82 byte chuncks (v2 after our conversation with Samuel)
+  // Rows are queued so the next one is prepared while the previous is sent by DMA
   for(uint16_t y =  1; y <= WAVE12I48_HEIGHT; y++) {
         for(uint16_t x = 1; x <= WAVE12I48_WIDTH/8; x++) {
           // bitwise invert: ~ data
@@ -301,8 +301,8 @@ void Wave12I48RB::update()
           }
 
           if (x==WAVE12I48_WIDTH/8) {  // Send the complete X line for S2 & M2
-                IO.dataS2(x1buf,sizeof(x1buf));
-                IO.dataM2(x2buf,sizeof(x2buf));
+                IO.queueData(EPD4SPI_S2, x1buf, sizeof(x1buf));
+                IO.queueData(EPD4SPI_M2, x2buf, sizeof(x2buf));
           }
 
         } else {         // M1 & S1
@@ -313,8 +313,8 @@ void Wave12I48RB::update()
           }
 
           if (x==WAVE12I48_WIDTH/8) { // Send the complete X line for M1 & S1
-              IO.dataM1(x1buf,sizeof(x1buf));
-              IO.dataS1(x2buf,sizeof(x2buf));
+              IO.queueData(EPD4SPI_M1, x1buf, sizeof(x1buf));
+              IO.queueData(EPD4SPI_S1, x2buf, sizeof(x2buf));
           }
         }
           ++i;
@@ -341,8 +341,8 @@ void Wave12I48RB::update()
           }
 
           if (x==WAVE12I48_WIDTH/8) {  // Send the complete X line for S2 & M2
-                IO.dataS2(x1buf,sizeof(x1buf));
-                IO.dataM2(x2buf,sizeof(x2buf));
+                IO.queueData(EPD4SPI_S2, x1buf, sizeof(x1buf));
+                IO.queueData(EPD4SPI_M2, x2buf, sizeof(x2buf));
           }
 
         } else {         // M1 & S1
@@ -353,13 +353,14 @@ void Wave12I48RB::update()
           }
 
           if (x==WAVE12I48_WIDTH/8) { // Send the complete X line for M1 & S1
-              IO.dataM1(x1buf,sizeof(x1buf));
-              IO.dataS1(x2buf,sizeof(x2buf));
+              IO.queueData(EPD4SPI_M1, x1buf, sizeof(x1buf));
+              IO.queueData(EPD4SPI_S1, x2buf, sizeof(x2buf));
           }
         }
           ++i;
         }
   }
+  IO.queueEnd();
   uint64_t endTime = esp_timer_get_time();
   
   _powerOn();
@@ -374,81 +375,19 @@ uint16_t Wave12I48RB::_setPartialRamArea(uint16_t, uint16_t, uint16_t, uint16_t)
 }
 
 void Wave12I48RB::_waitBusy(const char* message){
-  _waitBusyM1(message);
+  _waitBusy(message, EPD4SPI_M1);
 }
 
-void Wave12I48RB::_waitBusyM1(const char* message){
+/**
+ * Waits for all the controllers in the mask at once: the 4 BUSY lines are read
+ * in a single register access so the quadrants are not waited one after another
+ */
+void Wave12I48RB::_waitBusy(const char* message, uint8_t controllers){
   if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyM1 for %s", message);
+    ESP_LOGI(TAG, "_waitBusy for %s controllers:%x", message, controllers);
   }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_M1_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
-  vTaskDelay(pdMS_TO_TICKS(200));
-}
-
-void Wave12I48RB::_waitBusyM2(const char* message){
-  if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyM2 for %s", message);
-  }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_M2_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
-  vTaskDelay(pdMS_TO_TICKS(200));
-}
-
-void Wave12I48RB::_waitBusyS1(const char* message){
-  if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyS1 for %s", message);
-  }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_S1_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
-  vTaskDelay(pdMS_TO_TICKS(200));
-}
-
-void Wave12I48RB::_waitBusyS2(const char* message){
-  if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyS2 for %s", message);
-  }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_S2_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
+  if (!IO.waitBusy(controllers, WAVE_BUSY_TIMEOUT/1000) && debug_enabled) {
+    ESP_LOGI(TAG, "Busy Timeout");
   }
   vTaskDelay(pdMS_TO_TICKS(200));
 }
@@ -519,51 +458,11 @@ void Wave12I48RB::drawPixel(int16_t x, int16_t y, uint16_t color) {
 
 void Wave12I48RB::clear(){
   printf("EPD_12in48_Clear start ...\n");
-    //M1 part 648*492
-    IO.cmdM1(0x10);
-    for(uint16_t y =  492; y < 984; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataM1(0xff);
-        }
-    IO.cmdM1(0x13);
-    for(uint16_t y = 492; y < 984; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataM1(0x00);
-        }
-
-    //S1 part 656*492
-    IO.cmdS1(0x10);
-    for(uint16_t y = 492; y < 984; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataS1(0xff);
-        }
-    IO.cmdS1(0x13);
-    for(uint16_t y = 492; y < 984; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataS1(0x00);
-        }
-
-    //M2 part 656*492
-    IO.cmdM2(0x10);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataM2(0xff);
-        }
-    IO.cmdM2(0x13);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataM2(0x00);
-        }
-
-    //S2 part 648*492
-    IO.cmdS2(0x10);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataS2(0xff);
-        }
-    IO.cmdS2(0x13);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataS2(0x00);
-        }
+  // M1 & S2 are 648*492 (81 bytes per row), S1 & M2 are 656*492 (82 bytes per row)
+  IO.cmdM1S1M2S2(0x10);
+  IO.dataFill(EPD4SPI_M1|EPD4SPI_S2, 0xff, 81*492);
+  IO.dataFill(EPD4SPI_S1|EPD4SPI_M2, 0xff, 82*492);
+  IO.cmdM1S1M2S2(0x13);
+  IO.dataFill(EPD4SPI_M1|EPD4SPI_S2, 0x00, 81*492);
+  IO.dataFill(EPD4SPI_S1|EPD4SPI_M2, 0x00, 82*492);
 }
@@ -150,17 +150,9 @@ void Wave4i7Color::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Wave4i7Color::_sleep() {
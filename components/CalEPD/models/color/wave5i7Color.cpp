@@ -109,7 +109,7 @@ void Wave5i7Color::update()
   if (spi_optimized) {
     uint32_t i = 0;
     uint16_t xLineBytes = WAVE5I7COLOR_WIDTH/2;
-    uint8_t x1buf[xLineBytes];
+    uint8_t *x1buf = IO.streamBegin(xLineBytes);
     for (uint16_t y = 1; y <= WAVE5I7COLOR_HEIGHT; y++)
     {
       for (uint16_t x = 1; x <= xLineBytes; x++)
@@ -117,12 +117,13 @@ void Wave5i7Color::update()
         uint8_t data = i < sizeof(_buffer) ? _buffer[i] : 0x33;
         x1buf[x - 1] = data;
         if (x == xLineBytes)
-        { // Flush the X line buffer to SPI
-          IO.data(x1buf, sizeof(x1buf));
+        { // Queue the X line buffer to SPI
+          x1buf = IO.streamPush(xLineBytes);
         }
         ++i;
       }
     }
+    IO.streamEnd();
     if (debug_enabled) {
       printf("\nSPI optimization is on. Sending full xLineBytes: %d per SPI (4 bits per pixel)\n\nBuffer size: %d  expected size: %d\n", 
      xLineBytes, i, WAVE5I7COLOR_BUFFER_SIZE);
@@ -155,17 +156,9 @@ void Wave5i7Color::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Wave5i7Color::_sleep() {
@@ -46,10 +46,7 @@ void Gdeh0154d67::fillScreen(uint16_t color)
 {
   // 0xFF = 8 pixels black, 0x00 = 8 pix. white
   uint8_t data = (color == EPD_BLACK) ? GDEH0154D67_8PIX_BLACK : GDEH0154D67_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 
   if (debug_enabled) printf("fillScreen(%d) _buffer len:%d\n",data,sizeof(_buffer));
 }
@@ -76,24 +73,27 @@ void Gdeh0154d67::_setPartialRamArea(uint16_t x, uint16_t y, uint16_t w, uint16_
   IO.data(y / 256);
 }
 
+// Wake up sequence. Check EPD_SEQ_* opcodes in iointerface.h
+DRAM_ATTR const uint8_t Gdeh0154d67::epd_wakeup_sequence[] = {
+    EPD_SEQ_CMD, 0x12, 0, // SW reset
+    EPD_SEQ_WAIT_BUSY,
+    EPD_SEQ_CMD, 0x01, 3, 0xC7, 0x00, 0x00, // Driver output control
+    EPD_SEQ_CMD, 0x3C, 1, 0x05, // BorderWavefrom
+    EPD_SEQ_CMD, 0x18, 1, 0x80, // Read built-in temperature sensor
+    EPD_SEQ_END};
+
 void Gdeh0154d67::_wakeUp(){
-  IO.cmd(0x12);
-  _waitBusy("epd_wakeup_power:ON", power_on_time);
-  IO.cmd(0x01); // Driver output control
-  IO.data(0xC7);
-  IO.data(0x00);
-  IO.data(0x00);
-
-  IO.cmd(0x3C); // BorderWavefrom
-  IO.data(0x05);
-  IO.cmd(0x18); // Read built-in temperature sensor
-  IO.data(0x80);
-  
+  const uint8_t *seq = epd_wakeup_sequence;
+  while ((seq = IO.sequence(seq)) != NULL)
+  {
+    _waitBusy("epd_wakeup_power:ON", power_on_time);
+  }
   _setRamDataEntryMode(0x03);
 }
 
 void Gdeh0154d67::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   initFullUpdate();
   _using_partial_mode = false;
@@ -115,6 +115,7 @@ void Gdeh0154d67::update()
   IO.cmd(0x22);
   IO.data(0xf7);
   IO.cmd(0x20);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("_Update_Full", full_refresh_time);
 
   uint64_t updateTime = esp_timer_get_time();
@@ -184,6 +185,82 @@ void Gdeh0154d67::_PowerOn(void)
   _waitBusy("_PowerOn", power_on_time);
 }
 
+/**
+ * Direct stream. When a row does not follow the previous one the RAM pointer is moved.
+ * Rows going up (bottom-up bitmaps) switch to the y decrement entry mode so they are
+ * sequential again and only the first ones need a pointer
+ */
+void Gdeh0154d67::_rawStart()
+{
+  initFullUpdate();
+  _using_partial_mode = false;
+  _initial_refresh = true;
+  IO.cmd(0x24);
+  _raw_y = 0;
+  _raw_step = 1;
+}
+
+void Gdeh0154d67::_rawRow(uint16_t y, const uint8_t *row)
+{
+  if (y != _raw_y) {
+    _raw_step = (y + 1 == _raw_y - _raw_step) ? -1 : 1;
+    _setRamDataEntryMode(_raw_step < 0 ? 0x01 : 0x03);
+    _SetRamPointer(0x00, y % 256, y / 256);
+    IO.cmd(0x24);
+  }
+  IO.data(row, Fb::rowBytes);
+  _raw_y = y + _raw_step;
+}
+
+void Gdeh0154d67::_rawFinish()
+{
+  // Leave the normal entry mode for update()
+  if (_raw_step < 0) _setRamDataEntryMode(0x03);
+  IO.cmd(0x22);
+  IO.data(0xf7);
+  IO.cmd(0x20);
+  if (_deferRefresh()) return;
+  _waitBusy("rawWrite", full_refresh_time);
+  _sleep();
+}
+
+/**
+ * Retained image. After a deep sleep the RAM is empty: the previous image goes to the old RAM
+ * and the partial waveform only moves the pixels that differ. _buffer has white as 0, RAM as 1
+ */
+void Gdeh0154d67::_retainStart(uint16_t y0, uint16_t y1)
+{
+  initPartialUpdate();
+  _setRamDataEntryMode(0x03);
+  IO.cmd(0x26);
+}
+
+void Gdeh0154d67::_retainOldRow(uint16_t y, const uint8_t *row)
+{
+  uint8_t ram[Fb::rowBytes];
+  for (uint16_t x = 0; x < Fb::rowBytes; x++) ram[x] = ~row[x];
+  IO.data(ram, Fb::rowBytes);
+}
+
+void Gdeh0154d67::_retainFinish(uint16_t y0, uint16_t y1)
+{
+  _SetRamPointer(0x00, 0x00, 0x00);
+  IO.cmd(0x24);
+  uint8_t ram[Fb::rowBytes];
+  for (uint16_t y = 0; y < GDEH0154D67_HEIGHT; y++) {
+    const uint8_t *row = &_buffer[y * Fb::rowBytes];
+    for (uint16_t x = 0; x < Fb::rowBytes; x++) ram[x] = ~row[x];
+    IO.data(ram, Fb::rowBytes);
+  }
+  // The controller refreshes the whole area but only rows y0..y1 change
+  IO.cmd(0x22);
+  IO.data(0xff);
+  IO.cmd(0x20);
+  _waitBusy("retained_partial_update", partial_refresh_time);
+  _initial_refresh = true;
+  _sleep();
+}
+
 void Gdeh0154d67::updateWindow(int16_t x, int16_t y, int16_t w, int16_t h, bool using_rotation)
 {
   if (using_rotation) _rotate(x, y, w, h);
@@ -259,18 +336,10 @@ void Gdeh0154d67::_waitBusy(const char* message, uint16_t busy_time){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
   // On high is busy
   if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) {
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>7000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, 7000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
   } else {
     vTaskDelay(busy_time/portTICK_RATE_MS); 
   }
@@ -280,18 +349,9 @@ void Gdeh0154d67::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    // On low is not busy anymore
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>7000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, 7000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdeh0154d67::_sleep(){
@@ -325,29 +385,5 @@ void Gdeh0154d67::_rotate(int16_t& x, int16_t& y, int16_t& w, int16_t& h)
 
 void Gdeh0154d67::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEH0154D67_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEH0154D67_WIDTH - x - 1;
-      y = GDEH0154D67_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEH0154D67_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEH0154D67_WIDTH / 8;
-
-  // This is the trick to draw colors right. Genious Jean-Marc
-  if (color) {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    } else {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    }
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
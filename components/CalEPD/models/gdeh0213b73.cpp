@@ -55,6 +55,7 @@ Gdeh0213b73::Gdeh0213b73(EpdSpi& dio):
   Adafruit_GFX(GDEH0213B73_WIDTH, GDEH0213B73_HEIGHT),
   Epd(GDEH0213B73_WIDTH, GDEH0213B73_HEIGHT), IO(dio)
 {
+  _dirty_tracking = true;
   printf("Gdeh0213b73() constructor injects IO and extends Adafruit_GFX(%d,%d)\n",
   GDEH0213B73_WIDTH, GDEH0213B73_HEIGHT);  
 }
@@ -102,11 +103,9 @@ void Gdeh0213b73::init(bool debug)
 
 void Gdeh0213b73::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   uint8_t data = (color == EPD_WHITE) ? 0x00 : 0xFF;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 
   if (debug_enabled) printf("fillScreen(%d) _buffer len:%d\n",data,sizeof(_buffer));
 }
@@ -114,6 +113,7 @@ void Gdeh0213b73::fillScreen(uint16_t color)
 
 void Gdeh0213b73::update()
 {
+  _updateStart();
   _using_partial_mode = false;
   initFullUpdate();
   cmd(0x24); 
@@ -209,17 +209,9 @@ void Gdeh0213b73::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>1000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, 1000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdeh0213b73::cmd(uint8_t command){
@@ -240,51 +232,14 @@ void Gdeh0213b73::_sleep(){
 
 void Gdeh0213b73::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-   switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = GDEH0213B73_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = GDEH0213B73_WIDTH - x - w - 1;
-      y = GDEH0213B73_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = GDEH0213B73_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 
 void Gdeh0213b73::drawPixel(int16_t x, int16_t y, uint16_t color) {
-    if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEH0213B73_VISIBLE_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEH0213B73_VISIBLE_WIDTH - x - 1;
-      y = GDEH0213B73_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEH0213B73_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEH0213B73_WIDTH / 8;
-  if (!color) {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    } else {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    }
+  if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
+  _dirtyPixel(x, y);
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
 
 // _InitDisplay generalizing names here
@@ -48,6 +48,7 @@ Gdep015OC1::Gdep015OC1(EpdSpi& dio):
   Adafruit_GFX(GDEP015OC1_WIDTH, GDEP015OC1_HEIGHT),
   Epd(GDEP015OC1_WIDTH, GDEP015OC1_HEIGHT), IO(dio)
 {
+  _dirty_tracking = true;
   printf("Gdep015OC1() %d*%d\n",
   GDEP015OC1_WIDTH, GDEP015OC1_HEIGHT);  
 }
@@ -88,12 +89,10 @@ void Gdep015OC1::init(bool debug)
 
 void Gdep015OC1::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   // 0xFF = 8 pixels black, 0x00 = 8 pix. white
   uint8_t data = (color == EPD_BLACK) ? GDEP015OC1_8PIX_BLACK : GDEP015OC1_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 
   if (debug_enabled) printf("fillScreen(%d) _buffer len:%d\n",data,sizeof(_buffer));
 }
@@ -148,6 +147,8 @@ void Gdep015OC1::_wakeUp(uint8_t em){
 
 void Gdep015OC1::update()
 {
+  waitForRefresh();
+  _updateStart();
   initFullUpdate();
   printf("BUFF Size:%d\n",sizeof(_buffer));
 
@@ -164,6 +165,7 @@ void Gdep015OC1::update()
   IO.cmd(0x22);
   IO.data(0xc4);
   IO.cmd(0x20);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("_Update_Full", 1200);
   IO.cmd(0xff);
 
@@ -287,18 +289,10 @@ void Gdep015OC1::_waitBusy(const char* message, uint16_t busy_time){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
   // On high is busy
   if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) {
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>7000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, 7000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
   } else {
     vTaskDelay(busy_time/portTICK_RATE_MS); 
   }
@@ -308,18 +302,9 @@ void Gdep015OC1::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    // On low is not busy anymore
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>7000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, 7000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdep015OC1::_sleep(){
@@ -331,51 +316,12 @@ void Gdep015OC1::_sleep(){
 
 void Gdep015OC1::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = GDEP015OC1_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = GDEP015OC1_WIDTH - x - w - 1;
-      y = GDEP015OC1_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = GDEP015OC1_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 
 void Gdep015OC1::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEP015OC1_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEP015OC1_WIDTH - x - 1;
-      y = GDEP015OC1_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEP015OC1_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEP015OC1_WIDTH / 8;
-
-  // This is the trick to draw colors right. Genious Jean-Marc
-  if (color) {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    } else {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    }
+  _dirtyPixel(x, y);
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
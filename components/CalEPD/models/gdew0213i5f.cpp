@@ -227,10 +227,7 @@ void Gdew0213i5f::init(bool debug)
 void Gdew0213i5f::fillScreen(uint16_t color)
 {
   uint8_t data = (color == EPD_WHITE) ? 0xFF : 0x00;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 
   if (debug_enabled) printf("fillScreen(%d) _buffer len:%d\n",data,sizeof(_buffer));
 }
@@ -264,6 +261,7 @@ void Gdew0213i5f::_wakeUp(){
 
 void Gdew0213i5f::update()
 {
+  waitForRefresh();
   _using_partial_mode = false;
   _wakeUp();
 
@@ -281,6 +279,7 @@ void Gdew0213i5f::update()
   IO.data(_buffer,sizeof(_buffer));
 
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   _sleep();
 }
@@ -415,17 +414,9 @@ void Gdew0213i5f::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>1800000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 1800) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew0213i5f::_sleep(){
@@ -437,49 +428,11 @@ void Gdew0213i5f::_sleep(){
 
 void Gdew0213i5f::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = GDEW0213I5F_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = GDEW0213I5F_WIDTH - x - w - 1;
-      y = GDEW0213I5F_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = GDEW0213I5F_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 
 void Gdew0213i5f::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEW0213I5F_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEW0213I5F_WIDTH - x - 1;
-      y = GDEW0213I5F_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEW0213I5F_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEW0213I5F_WIDTH / 8;
-
-  if (color)
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-  else
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
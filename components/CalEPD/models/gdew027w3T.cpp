@@ -83,6 +83,7 @@ Gdew027w3T::Gdew027w3T(EpdSpi& dio, FT6X36& ts):
   Adafruit_GFX(GDEW027W3_WIDTH, GDEW027W3_HEIGHT),
   Epd(GDEW027W3_WIDTH, GDEW027W3_HEIGHT), IO(dio), Touch(ts)
 {
+  _dirty_tracking = true;
   printf("Gdew027w3T() %d*%d\n",
   GDEW027W3_WIDTH, GDEW027W3_HEIGHT);  
   // For the record, begining of the fight: https://twitter.com/martinfasani/status/1265762052880175107
@@ -143,12 +144,10 @@ void Gdew027w3T::initPartialUpdate(){
 
 void Gdew027w3T::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   // 0xFF = 8 pixels black, 0x00 = 8 pix. white
   uint8_t data = (color == EPD_BLACK) ? GDEW027W3_8PIX_BLACK : GDEW027W3_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 
   if (debug_enabled) printf("fillScreen(%d) _buffer len:%d\n",data,sizeof(_buffer));
 }
@@ -212,6 +211,7 @@ void Gdew027w3T::_wakeUp(){
 
 void Gdew027w3T::update()
 {
+  _updateStart();
   _wakeUp();
   _using_partial_mode = false;
 
@@ -323,17 +323,9 @@ void Gdew027w3T::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>7000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 7000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew027w3T::_sleep(){
@@ -346,53 +338,14 @@ void Gdew027w3T::_sleep(){
 
 void Gdew027w3T::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = GDEW027W3_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = GDEW027W3_WIDTH - x - w - 1;
-      y = GDEW027W3_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = GDEW027W3_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 
 void Gdew027w3T::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEW027W3_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEW027W3_WIDTH - x - 1;
-      y = GDEW027W3_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEW027W3_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEW027W3_WIDTH / 8;
-
-  // This is the trick to draw colors right. Genious Jean-Marc
-  if (color) {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    } else {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    }
+  _dirtyPixel(x, y);
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
 
 /**
@@ -117,34 +117,29 @@ DRAM_ATTR const epd_init_42 Gdew042t2::lut_24_bb_partial={
   0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
 },42};
 
-DRAM_ATTR const epd_power_4 Gdew042t2::epd_wakeup_power={
-0x01,{0x03,0x00,0x2b,0x2b},4
+// Wake up sequence. Check EPD_SEQ_* opcodes in iointerface.h
+DRAM_ATTR const uint8_t Gdew042t2::epd_wakeup_sequence[]={
+EPD_SEQ_CMD, 0x01, 4, 0x03,0x00,0x2b,0x2b, // Power setting
+EPD_SEQ_CMD, 0x06, 3, 0x17,0x17,0x17,      // Booster soft start
+EPD_SEQ_CMD, 0x00, 1, 0x3f,                // Panel setting
+EPD_SEQ_CMD, 0x30, 1, 0x3a,                // PLL
+EPD_SEQ_CMD, 0x61, 4, GDEW042T2_WIDTH/256, // Resolution setting
+                      GDEW042T2_WIDTH%256,
+                      GDEW042T2_HEIGHT/256,
+                      GDEW042T2_HEIGHT%256,
+EPD_SEQ_CMD, 0x82, 1, 0x12, // vcom_DC setting: -0.1 + 18 * -0.05 = -1.0V from OTP, slightly better
+EPD_SEQ_CMD, 0x50, 1, 0xd7, // VCOM AND DATA INTERVAL SETTING: border floating to avoid flashing
+EPD_SEQ_CMD, 0x04, 0,       // Power on
+EPD_SEQ_WAIT_BUSY,
+EPD_SEQ_END
 };
 
-DRAM_ATTR const epd_init_3 Gdew042t2::epd_soft_start={
-0x06,{0x17,0x17,0x17},3
-};
-
-DRAM_ATTR const epd_init_1 Gdew042t2::epd_panel_setting={
-0x00,{0x3f},1
-};
-
-DRAM_ATTR const epd_init_1 Gdew042t2::epd_pll={
-0x30,{0x3a},1
-};
-
-DRAM_ATTR const epd_init_4 Gdew042t2::epd_resolution={
-0x61,{GDEW042T2_WIDTH/256,
-GDEW042T2_WIDTH%256,
-GDEW042T2_HEIGHT/256,
-GDEW042T2_HEIGHT%256
-},4};
-
 // Constructor
 Gdew042t2::Gdew042t2(EpdSpi& dio): 
   Adafruit_GFX(GDEW042T2_WIDTH, GDEW042T2_HEIGHT),
   Epd(GDEW042T2_WIDTH, GDEW042T2_HEIGHT), IO(dio)
 {
+  _dirty_tracking = true;
   printf("Gdew042t2() constructor injects IO and extends Adafruit_GFX(%d,%d)\n",
   GDEW042T2_WIDTH, GDEW042T2_HEIGHT);  
 }
@@ -208,84 +203,54 @@ void Gdew042t2::init(bool debug)
 
 void Gdew042t2::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   uint8_t data = (color == EPD_BLACK) ? GDEW042T2_8PIX_BLACK : GDEW042T2_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 
   if (debug_enabled) printf("fillScreen(%d) _buffer len:%d\n",data,sizeof(_buffer));
 }
 
 void Gdew042t2::_wakeUp(){
   IO.reset(10);
-//IMPORTANT: Some EPD controllers like to receive data byte per byte
-//So this won't work:
-//IO.data(epd_wakeup_power.data,epd_wakeup_power.databytes);
-  
-
-  IO.cmd(epd_wakeup_power.cmd);
-  for (int i=0;i<epd_wakeup_power.databytes;++i) {
-    IO.data(epd_wakeup_power.data[i]);
-  }
- 
-  IO.cmd(epd_soft_start.cmd);
-  for (int i=0;i<epd_soft_start.databytes;++i) {
-    IO.data(epd_soft_start.data[i]);
+  // Queued SPI transactions, data byte by byte since this controller does not take them in one
+  const uint8_t *seq = epd_wakeup_sequence;
+  while ((seq = IO.sequence(seq)) != NULL) {
+    _waitBusy("epd_wakeup_power");
   }
-  
-  IO.cmd(epd_panel_setting.cmd);
-  for (int i=0;i<epd_panel_setting.databytes;++i) {
-    IO.data(epd_panel_setting.data[i]);
-  }
-  
-  IO.cmd(epd_pll.cmd);
-  for (int i=0;i<epd_pll.databytes;++i) {
-    IO.data(epd_pll.data[i]);
-  }
-  //resolution setting
-  IO.cmd(epd_resolution.cmd);
-  for (int i=0;i<epd_resolution.databytes;++i) {
-    IO.data(epd_resolution.data[i]);
-  }
-
-  IO.cmd(0x82); // vcom_DC setting
-  IO.data(0x12);   // -0.1 + 18 * -0.05 = -1.0V from OTP, slightly better
-  IO.cmd(0x50); // VCOM AND DATA INTERVAL SETTING
-  IO.data(0xd7);    // border floating to avoid flashing
-  IO.cmd(0x04);
-
-  _waitBusy("epd_wakeup_power");
   initFullUpdate();
 }
 
 void Gdew042t2::update()
 {
+  waitForRefresh();
+  _updateStart();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
 
   IO.cmd(0x13);
-  // v2 SPI optimizing. Check: https://github.com/martinberlin/cale-idf/wiki/About-SPI-optimization
+  // v3 SPI optimizing: x1buf is a DMA buffer, next line is packed while the previous is queued
   uint16_t i = 0;
   uint8_t xLineBytes = GDEW042T2_WIDTH/8;
-  uint8_t x1buf[xLineBytes];
+  uint8_t *x1buf = IO.streamBegin(xLineBytes);
     for(uint16_t y =  1; y <= GDEW042T2_HEIGHT; y++) {
         for(uint16_t x = 1; x <= xLineBytes; x++) {
           uint8_t data = i < sizeof(_buffer) ? _buffer[i] : 0x00;
           x1buf[x-1] = data;
-          if (x==xLineBytes) { // Flush the X line buffer to SPI
-            IO.data(x1buf,sizeof(x1buf));
+          if (x==xLineBytes) { // Queue the X line buffer to SPI
+            x1buf = IO.streamPush(xLineBytes);
           }
           ++i;
         }
     }
+  IO.streamEnd();
 
   // v1 way to do it (Byte per byte toogling CS pin low->high)
   // Check 0.9.2 version: https://github.com/martinberlin/CalEPD/blob/0.9.2/models/gdew042t2.cpp#L278
   
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   uint64_t powerOnTime = esp_timer_get_time();
 
@@ -369,17 +334,9 @@ void Gdew042t2::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew042t2::_sleep(){
@@ -393,50 +350,12 @@ void Gdew042t2::_sleep(){
 
 void Gdew042t2::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = GDEW042T2_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = GDEW042T2_WIDTH - x - w - 1;
-      y = GDEW042T2_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = GDEW042T2_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 
 void Gdew042t2::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEW042T2_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEW042T2_WIDTH - x - 1;
-      y = GDEW042T2_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEW042T2_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEW042T2_WIDTH / 8;
-
-  if (color) {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    } else {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    }
+  _dirtyPixel(x, y);
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
@@ -4,41 +4,31 @@
 #include "esp_log.h"
 #include "freertos/task.h"
 
-// CMD, DATA, Databytes * Optional we are going to use sizeof(data)
-DRAM_ATTR const epd_init_2 Gdew0583T7::epd_wakeup_power={
-0x01,{0x37,0x00},2
-};
-
-DRAM_ATTR const epd_init_2 Gdew0583T7::epd_panel_setting={
-0x00,{0xCF,0x08},2
-};
-
-DRAM_ATTR const epd_init_3 Gdew0583T7::epd_boost={
-0x06,{0xC7,0xCC,0x28},3
-};
-
+// Wake up sequence. Check EPD_SEQ_* opcodes in iointerface.h
+DRAM_ATTR const uint8_t Gdew0583T7::epd_wakeup_sequence[]={
+EPD_SEQ_CMD, 0x01, 2, 0x37,0x00,      // Power setting
+EPD_SEQ_CMD, 0x00, 2, 0xCF,0x08,      // Panel setting
+EPD_SEQ_CMD, 0x06, 3, 0xC7,0xCC,0x28, // Boost
 // 0x3a -> 15s refresh  |  0x3c -> 30s refresh
-DRAM_ATTR const epd_init_1 Gdew0583T7::epd_pll={
-0x30,{0x3a},1
-};
-
-DRAM_ATTR const epd_init_1 Gdew0583T7::epd_temperature={
-0x41,{0x00},1
+EPD_SEQ_CMD, 0x30, 1, 0x3a,           // PLL
+EPD_SEQ_CMD, 0x41, 1, 0x00,           // Temperature
+EPD_SEQ_CMD, 0x50, 1, 0x77,           // Vcom and data interval settings
+EPD_SEQ_CMD, 0x60, 1, 0x22,           // TCON (???)
+EPD_SEQ_CMD, 0x61, 4, 0x02, 0x58,     // Resolution: source 600
+                      0x01, 0xc0,     // gate 448
+EPD_SEQ_CMD, 0x82, 1, 0x28,           // VCOM Voltage: All temperature range
+EPD_SEQ_CMD, 0xe5, 1, 0x03,           // Flash mode
+EPD_SEQ_CMD, 0x04, 0,                 // Power it on
+EPD_SEQ_WAIT_BUSY,
+EPD_SEQ_END
 };
 
-DRAM_ATTR const epd_init_4 Gdew0583T7::epd_resolution={
-0x61,{
-  0x02, //source 600
-  0x58,
-  0x01, //gate 448
-  0xc0
-},4};
-
 // Constructor
 Gdew0583T7::Gdew0583T7(EpdSpi& dio): 
   Adafruit_GFX(GDEW0583T7_WIDTH, GDEW0583T7_HEIGHT),
   Epd(GDEW0583T7_WIDTH, GDEW0583T7_HEIGHT), IO(dio)
 {
+  // No dirty tracking: the first updateWindow() erases the whole panel, updateDirty() runs update()
   printf("Gdew0583T7() constructor injects IO and extends Adafruit_GFX(%d,%d)\n",
   GDEW0583T7_WIDTH, GDEW0583T7_HEIGHT);  
 }
@@ -55,63 +45,19 @@ void Gdew0583T7::init(bool debug)
 
 void Gdew0583T7::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   uint8_t data = (color == EPD_BLACK) ? 0xFF : 0x00;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 }
 
 void Gdew0583T7::_wakeUp(){
   IO.reset(10);
-//IMPORTANT: Some EPD controllers like to receive data byte per byte
-//So this won't work, still needs to be tried out for this epaper:
-//IO.data(epd_wakeup_power.data,epd_wakeup_power.databytes);
   printf("_wakeUp Power on\n");
-  IO.cmd(epd_wakeup_power.cmd);
-  for (int i=0;i<sizeof(epd_wakeup_power.data);++i) {
-    //printf(">%d\n",i);
-    IO.data(epd_wakeup_power.data[i]);
-  }
- 
-  printf("Panel setting\n");
-  IO.cmd(epd_panel_setting.cmd);
-  for (int i=0;i<sizeof(epd_panel_setting.data);++i) {
-    IO.data(epd_panel_setting.data[i]);
-  }
-
-  IO.cmd(epd_boost.cmd);
-  for (int i=0;i<sizeof(epd_boost.data);++i) {
-    IO.data(epd_boost.data[i]);
-  }
-
-  IO.cmd(epd_pll.cmd);
-  IO.data(epd_pll.data[0]);
-
-  IO.cmd(epd_temperature.cmd);
-  IO.data(epd_temperature.data[0]);
-  // Vcom and data interval settings
-  IO.cmd(0x50);
-  IO.data(0x77);
-  IO.cmd(0x60); // TCON (???)
-  IO.data(0x22);
-
-  // Resolution setting
-  IO.cmd(epd_resolution.cmd);
-  for (int i=0;i<sizeof(epd_resolution.data);++i) {
-    IO.data(epd_resolution.data[i]);
+  // Queued SPI transactions, data byte by byte since this controller does not take them in one
+  const uint8_t *seq = epd_wakeup_sequence;
+  while ((seq = IO.sequence(seq)) != NULL) {
+    _waitBusy("Power on");
   }
-
-  // Vcom voltage setting
-  IO.cmd(0x82);  // VCOM Voltage
-  IO.data(0x28); // All temperature range
-  
-  IO.cmd(0xe5);  // Flash mode
-  IO.data(0x03);
-
-  // Power it on
-  IO.cmd(0x04);
-  _waitBusy("Power on");
 }
 
 void Gdew0583T7::_send8pixel(uint8_t data)
@@ -130,6 +76,8 @@ void Gdew0583T7::_send8pixel(uint8_t data)
 
 void Gdew0583T7::update()
 {
+  waitForRefresh();
+  _updateStart();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
@@ -137,20 +85,18 @@ void Gdew0583T7::update()
   IO.cmd(0x10);
   printf("Sending a %d bytes buffer via SPI\n",sizeof(_buffer));
 
-  for (uint32_t i = 0; i < sizeof(_buffer); i++)
+  // Same as updateWindow(): each row is packed (4 bytes per buffer byte) while the previous one is queued
+  uint16_t rowBytes = GDEW0583T7_WIDTH / 8 * 4;
+  uint8_t *x1buf = IO.streamBegin(rowBytes);
+  for (uint16_t y = 0; y < GDEW0583T7_HEIGHT; y++)
   {
-    // If this does not work please comment this:
-    _send8pixel(i < sizeof(_buffer) ? _buffer[i] : 0x00);
-
-    if (i%2000==0) {
-       rtc_wdt_feed();
-       vTaskDelay(pdMS_TO_TICKS(10));
-       if (debug_enabled) printf("%d ",i);
-    }
-  
+    il0371PackRow(&_buffer[y * (GDEW0583T7_WIDTH / 8)], x1buf, GDEW0583T7_WIDTH / 8);
+    x1buf = IO.streamPush(rowBytes);
   }
+  IO.streamEnd();
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   uint64_t updateTime = esp_timer_get_time();
   
@@ -217,28 +163,37 @@ void Gdew0583T7::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bo
   if (y >= GDEW0583T7_HEIGHT) return;
   uint16_t xe = gx_uint16_min(GDEW0583T7_WIDTH, x + w) - 1;
   uint16_t ye = gx_uint16_min(GDEW0583T7_HEIGHT, y + h) - 1;
-  // x &= 0xFFF8; // byte boundary, not needed here
+  uint64_t startTime = esp_timer_get_time();
+  // Byte aligned window: xe_bx is exclusive so the last partial byte is included
   uint16_t xs_bx = x / 8;
-  uint16_t xe_bx = (xe + 7) / 8;
+  uint16_t xe_bx = xe / 8 + 1;
+  uint16_t xBytes = xe_bx - xs_bx;
   if (!_using_partial_mode) eraseDisplay(true); // clean surrounding
   _using_partial_mode = true;
-   
   IO.cmd(0x91); // partial in
-  _setPartialRamArea(x, y, xe, ye);
+  _setPartialRamArea(xs_bx * 8, y, xe_bx * 8, ye);
   IO.cmd(0x10);
 
-  for (int16_t y1 = y; y1 <= ye; y1++)
+  // Each window row is converted (4 bytes per buffer byte) and sent as one DMA transaction
+  uint16_t rowBytes = xBytes * 4;
+  uint8_t *x1buf = IO.streamBegin(rowBytes);
+  for (uint16_t y1 = y; y1 <= ye; y1++)
   {
-    for (int16_t x1 = xs_bx; x1 < xe_bx; x1++)
-    {
-      uint16_t idx = y1 * (GDEW0583T7_WIDTH / 8) + x1;
-      _send8pixel((idx < sizeof(_buffer)) ? _buffer[idx] : 0x00);
-    }
+    const uint8_t *row = &_buffer[y1 * (GDEW0583T7_WIDTH / 8) + xs_bx];
+    il0371PackRow(row, x1buf, xBytes);
+    x1buf = IO.streamPush(rowBytes);
   }
-  IO.cmd(0x12);     // display refresh
-  _waitBusy("updateWindow partial refresh");
-  IO.cmd(0x92);     // partial out
-  
+  IO.streamEnd();
+  uint64_t sendTime = esp_timer_get_time();
+
+  IO.cmd(0x12); // display refresh
+  _waitBusy("updateWindow");
+  IO.cmd(0x92); // partial out
+
+  uint64_t refreshTime = esp_timer_get_time();
+  printf("updateWindow STATS (ms) %dx%d bytes: %llu send window %llu refresh %llu total\n",
+         xBytes, ye - y + 1, (sendTime - startTime) / 1000, (refreshTime - sendTime) / 1000, (refreshTime - startTime) / 1000);
+
   vTaskDelay(GDEW0583T7_PU_DELAY / portTICK_PERIOD_MS);
 }
 
@@ -246,17 +201,9 @@ void Gdew0583T7::_waitBusy(const char* message){
   if (debug_enabled) {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
   // In this controller BUSY == 0 
-  while (true){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1) break;
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>2000000)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew0583T7::_sleep(){
@@ -275,47 +222,10 @@ void Gdew0583T7::_sleep(){
 
 void Gdew0583T7::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = GDEW0583T7_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = GDEW0583T7_WIDTH - x - w - 1;
-      y = GDEW0583T7_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = GDEW0583T7_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 void Gdew0583T7::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = GDEW0583T7_WIDTH - x - 1;
-      break;
-    case 2:
-      x = GDEW0583T7_WIDTH - x - 1;
-      y = GDEW0583T7_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = GDEW0583T7_HEIGHT - y - 1;
-      break;
-  }
-  uint16_t i = x / 8 + y * GDEW0583T7_WIDTH / 8;
-
-  if (!color) {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    } else {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    }
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
@@ -4,6 +4,9 @@
 #include "esp_log.h"
 #include "freertos/task.h"
 
+// Busy timeout in millis. Replaces the additional 2 seconds wait: in low temperatures full update takes longer
+#define GDEW075HD_BUSY_TIMEOUT 8000
+
 // Constructor
 Gdew075HD::Gdew075HD(EpdSpi &dio) : Adafruit_GFX(GDEW075HD_WIDTH, GDEW075HD_HEIGHT),
                                     Epd(GDEW075HD_WIDTH, GDEW075HD_HEIGHT), IO(dio)
@@ -27,10 +30,7 @@ void Gdew075HD::init(bool debug)
 void Gdew075HD::fillScreen(uint16_t color)
 {
   uint8_t data = (color == EPD_BLACK) ? GDEW075HD_8PIX_BLACK : GDEW075HD_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 }
 
 void Gdew075HD::_wakeUp()
@@ -105,6 +105,7 @@ void Gdew075HD::_wakeUp()
 
 void Gdew075HD::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
@@ -112,10 +113,10 @@ void Gdew075HD::update()
   IO.cmd(0x24); //Black RAM
   printf("Sending a %d bytes buffer via SPI\n", sizeof(_buffer));
 
-  // v2 SPI optimizing. Check: https://github.com/martinberlin/cale-idf/wiki/About-SPI-optimization
-  uint16_t i = 0;
+  // v3 SPI optimizing: x1buf is a DMA buffer, next line is packed while the previous is queued
+  uint32_t i = 0;
   uint8_t xLineBytes = GDEW075HD_WIDTH / 8;
-  uint8_t x1buf[xLineBytes];
+  uint8_t *x1buf = IO.streamBegin(xLineBytes);
   for (uint16_t y = 1; y <= GDEW075HD_HEIGHT; y++)
   {
     for (uint16_t x = 1; x <= xLineBytes; x++)
@@ -123,12 +124,13 @@ void Gdew075HD::update()
       uint8_t data = i < sizeof(_buffer) ? _buffer[i] : 0x00;
       x1buf[x - 1] = data;
       if (x == xLineBytes)
-      { // Flush the X line buffer to SPI
-        IO.data(x1buf, sizeof(x1buf));
+      { // Queue the X line buffer to SPI
+        x1buf = IO.streamPush(xLineBytes);
       }
       ++i;
     }
-  } 
+  }
+  IO.streamEnd();
 
   /* 
   for (uint16_t i = 1; i <= GDEW075HD_BUFFER_SIZE; i++)
@@ -143,6 +145,7 @@ void Gdew075HD::update()
   IO.cmd(0x22);  // Show
   IO.data(0xF7); // 0xF7
   IO.cmd(0x20);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
 
   vTaskDelay(200 / portTICK_PERIOD_MS);
   _waitBusy("Update");
@@ -150,9 +153,6 @@ void Gdew075HD::update()
   uint64_t updateTime = esp_timer_get_time();
   printf("\n\nSTATS (ms)\n%llu _wakeUp settings+send Buffer\n%llu update \n%llu total time in millis\n",
          (endTime - startTime) / 1000, (updateTime - endTime) / 1000, (updateTime - startTime) / 1000);
-  
-  // Additional 2 seconds wait before sleeping since in low temperatures full update takes longer
-  vTaskDelay(2000 / portTICK_PERIOD_MS);
 
   _sleep();
 }
@@ -168,21 +168,9 @@ void Gdew075HD::_waitBusy(const char *message)
   {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1)
-  {
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 0) {
-      break;
-      }
-      vTaskDelay(1);
-    if (esp_timer_get_time() - time_since_boot > 2000000)
-    {
-      if (debug_enabled)
-        ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 0 (not busy)
+  if (!IO.waitBusy(0, GDEW075HD_BUSY_TIMEOUT) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew075HD::_sleep()
@@ -193,52 +181,12 @@ void Gdew075HD::_sleep()
 
 void Gdew075HD::_rotate(uint16_t &x, uint16_t &y, uint16_t &w, uint16_t &h)
 {
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    swap(w, h);
-    x = GDEW075HD_WIDTH - x - w - 1;
-    break;
-  case 2:
-    x = GDEW075HD_WIDTH - x - w - 1;
-    y = GDEW075HD_HEIGHT - y - h - 1;
-    break;
-  case 3:
-    swap(x, y);
-    swap(w, h);
-    y = GDEW075HD_HEIGHT - y - h - 1;
-    break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 void Gdew075HD::drawPixel(int16_t x, int16_t y, uint16_t color)
 {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
     return;
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    x = GDEW075HD_WIDTH - x - 1;
-    break;
-  case 2:
-    x = GDEW075HD_WIDTH - x - 1;
-    y = GDEW075HD_HEIGHT - y - 1;
-    break;
-  case 3:
-    swap(x, y);
-    y = GDEW075HD_HEIGHT - y - 1;
-    break;
-  }
-  uint16_t i = x / 8 + y * GDEW075HD_WIDTH / 8;
-
-  if (color)
-  {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-  }
-  else
-  {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-  }
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
@@ -13,8 +13,20 @@
 #define T3 0x00 // color change phase (b/w)
 #define T4 0x00  // optional extension for one color
 
+// Fast full waveform: every pixel is flashed to the opposite color and driven to its own.
+// About 1.2 s instead of the 3-4 s of the OTP one
+#define TF1 0x0A // flash to the opposite color
+#define TF2 0x0A // back
+#define TF3 0x14 // drive to the new color
+
 // Partial Update Delay, may have an influence on degradation
 #define GDEW075T7_PU_DELAY 100
+// Fastest refresh and busy timeout per temperature. In the cold the OTP waveform is longer
+// and the register LUTs, tuned at room temperature, do not drive the pixels to the end
+DRAM_ATTR const epd_temperature_band Gdew075T7::temperature_bands[] = {
+    {5, EPD_REFRESH_FULL, 12000},
+    {15, EPD_REFRESH_FAST, GDEW075T7_BUSY_TIMEOUT},
+    {127, EPD_REFRESH_PARTIAL, 5000}};
 
 // Partial display Waveform
 DRAM_ATTR const epd_init_42 Gdew075T7::lut_20_LUTC_partial = {
@@ -47,11 +59,24 @@ DRAM_ATTR const epd_init_42 Gdew075T7::lut_25_LUTBD_partial = {
            0x00, T1, T2, T3, T4, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
     42};
 
-// 0x07 (2nd) VGH=20V,VGL=-20V
-// 0x3f (1st) VDH= 15V
-// 0x3f (2nd) VDH=-15V
-DRAM_ATTR const epd_power_4 Gdew075T7::epd_wakeup_power = {
-    0x01, {0x07, 0x07, 0x3f, 0x3f}, 4};
+// Fast full display Waveform. In this panel VDH (01) drives to black and VDL (10) to white
+DRAM_ATTR const epd_init_42 Gdew075T7::lut_20_LUTC_fast = {
+    0x20, {0x00, TF1, TF2, 0x00, 0x00, 1, 0x00, TF3, 0x00, 0x00, 0x00, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 42};
+
+DRAM_ATTR const epd_init_42 Gdew075T7::lut_21_LUTWW_fast = {
+    0x21, {0x60, TF1, TF2, 0x00, 0x00, 1, 0x80, TF3, 0x00, 0x00, 0x00, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 42};
+
+DRAM_ATTR const epd_init_42 Gdew075T7::lut_22_LUTKW_fast = {
+    0x22, {0x60, TF1, TF2, 0x00, 0x00, 1, 0x80, TF3, 0x00, 0x00, 0x00, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 42};
+
+DRAM_ATTR const epd_init_42 Gdew075T7::lut_23_LUTWK_fast = {
+    0x23, {0x90, TF1, TF2, 0x00, 0x00, 1, 0x40, TF3, 0x00, 0x00, 0x00, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 42};
+
+DRAM_ATTR const epd_init_42 Gdew075T7::lut_24_LUTKK_fast = {
+    0x24, {0x90, TF1, TF2, 0x00, 0x00, 1, 0x40, TF3, 0x00, 0x00, 0x00, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 42};
+
+DRAM_ATTR const epd_init_42 Gdew075T7::lut_25_LUTBD_fast = {
+    0x25, {0x60, TF1, TF2, 0x00, 0x00, 1, 0x80, TF3, 0x00, 0x00, 0x00, 1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 42};
 
 DRAM_ATTR const epd_init_1 Gdew075T7::epd_panel_setting_full = {
     0x00, {0x1f}, 1};
@@ -59,17 +84,28 @@ DRAM_ATTR const epd_init_1 Gdew075T7::epd_panel_setting_full = {
 DRAM_ATTR const epd_init_1 Gdew075T7::epd_panel_setting_partial = {
     0x00, {0x3f}, 1};
 
-DRAM_ATTR const epd_init_4 Gdew075T7::epd_resolution = {
-    0x61, {GDEW075T7_WIDTH / 256, //source 800
-           GDEW075T7_WIDTH % 256,
-           GDEW075T7_HEIGHT / 256, //gate 480
-           GDEW075T7_HEIGHT % 256},
-    4};
+// Wake up sequence. Check EPD_SEQ_* opcodes in iointerface.h
+DRAM_ATTR const uint8_t Gdew075T7::epd_wakeup_sequence[] = {
+    // Power setting 0x07 (2nd) VGH=20V,VGL=-20V 0x3f (1st) VDH= 15V 0x3f (2nd) VDH=-15V
+    EPD_SEQ_CMD, 0x01, 4, 0x07, 0x07, 0x3f, 0x3f,
+    EPD_SEQ_CMD, 0x04, 0, // Power on
+    EPD_SEQ_WAIT_BUSY,
+    EPD_SEQ_CMD, 0x00, 1, 0x1f, // Panel setting: full update LUT from OTP
+    EPD_SEQ_CMD, 0x61, 4, GDEW075T7_WIDTH / 256, //source 800
+                          GDEW075T7_WIDTH % 256,
+                          GDEW075T7_HEIGHT / 256, //gate 480
+                          GDEW075T7_HEIGHT % 256,
+    // Not sure if 0x15 is really needed, seems to work the same without it too
+    EPD_SEQ_CMD, 0x15, 1, 0x00, // Dual SPI: MM_EN, DUSPI_EN
+    EPD_SEQ_CMD, 0x50, 2, 0x29, 0x07, // VCOM AND DATA INTERVAL SETTING: LUTKW, N2OCP: copy new to old
+    EPD_SEQ_CMD, 0x60, 1, 0x22, // TCON SETTING
+    EPD_SEQ_END};
 
 // Constructor
 Gdew075T7::Gdew075T7(EpdSpi &dio) : Adafruit_GFX(GDEW075T7_WIDTH, GDEW075T7_HEIGHT),
                                     Epd(GDEW075T7_WIDTH, GDEW075T7_HEIGHT), IO(dio)
 {
+  _dirty_tracking = true;
   printf("Gdew075T7() constructor injects IO and extends Adafruit_GFX(%d,%d) Pix Buffer[%d]\n",
          GDEW075T7_WIDTH, GDEW075T7_HEIGHT, GDEW075T7_BUFFER_SIZE);
   printf("\nAvailable heap after Epd bootstrap:%d\n", xPortGetFreeHeapSize());
@@ -114,6 +150,65 @@ void Gdew075T7::initPartialUpdate()
   IO.data(lut_25_LUTBD_partial.data, lut_25_LUTBD_partial.databytes);
 }
 
+void Gdew075T7::initFastUpdate()
+{
+  IO.cmd(epd_panel_setting_partial.cmd);      // panel setting
+  IO.data(epd_panel_setting_partial.data[0]); // LUT from registers
+  IO.cmd(0x82);  // vcom_DC setting, same as partial
+  IO.data(0x26);
+  IO.cmd(0x50);  // VCOM AND DATA INTERVAL SETTING: LUTKW, N2OCP: copy new to old
+  IO.data(0x29);
+  IO.data(0x07);
+
+  IO.cmd(lut_20_LUTC_fast.cmd);
+  IO.data(lut_20_LUTC_fast.data, lut_20_LUTC_fast.databytes);
+
+  IO.cmd(lut_21_LUTWW_fast.cmd);
+  IO.data(lut_21_LUTWW_fast.data, lut_21_LUTWW_fast.databytes);
+
+  IO.cmd(lut_22_LUTKW_fast.cmd);
+  IO.data(lut_22_LUTKW_fast.data, lut_22_LUTKW_fast.databytes);
+
+  IO.cmd(lut_23_LUTWK_fast.cmd);
+  IO.data(lut_23_LUTWK_fast.data, lut_23_LUTWK_fast.databytes);
+
+  IO.cmd(lut_24_LUTKK_fast.cmd);
+  IO.data(lut_24_LUTKK_fast.data, lut_24_LUTKK_fast.databytes);
+
+  IO.cmd(lut_25_LUTBD_fast.cmd);
+  IO.data(lut_25_LUTBD_fast.data, lut_25_LUTBD_fast.databytes);
+}
+
+/**
+ * Wakes up and loads the waveform of setRefreshMode(). Full uses the OTP LUT: after register LUTs
+ * it runs the init table again. Partial needs the previous image in DTM1, lost after a reset
+ */
+void Gdew075T7::_initUpdate()
+{
+  // Powered first: the idle timeout may have sent it to deep sleep, then _wakeUp() clears _old_valid.
+  // The sensor measures at power on, so this update already uses its temperature
+  _powerUp();
+  const epd_temperature_band *band = _temperatureBand(temperature_bands, temperature());
+  // Unknown temperature: full refresh, the OTP waveform compensates it by itself
+  uint8_t mode = _nextRefreshMode(_old_valid, band ? band->refreshMode : EPD_REFRESH_FULL);
+  // Leaving partial mode needs the reset and init table again
+  if (mode == EPD_REFRESH_FULL && _using_partial_mode) _wakeUp();
+  _updateStart(mode);
+  _busy_timeout = band ? band->busyTimeout : GDEW075T7_BUSY_TIMEOUT;
+  if (debug_enabled) printf("Gdew075T7 %d °C refresh mode %d\n", _temperature, mode);
+  switch (mode) {
+    case EPD_REFRESH_FAST:
+      initFastUpdate();
+      break;
+    case EPD_REFRESH_PARTIAL:
+      initPartialUpdate();
+      break;
+    default:
+      initFullUpdate();
+  }
+  _using_partial_mode = (mode != EPD_REFRESH_FULL);
+}
+
 //Initialize the display
 void Gdew075T7::init(bool debug)
 {
@@ -123,72 +218,44 @@ void Gdew075T7::init(bool debug)
   //Initialize SPI at 4MHz frequency. true for debug
   IO.init(4, false);
   fillScreen(EPD_WHITE);
-  _wakeUp();
+  _powerUp(true);
+  _powerIdle();
 }
 
 void Gdew075T7::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   uint8_t data = (color == EPD_BLACK) ? GDEW075T7_8PIX_BLACK : GDEW075T7_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 }
 
 void Gdew075T7::_wakeUp()
 {
   IO.reset(10);
-  //IMPORTANT: Some EPD controllers like to receive data byte per byte
-  //So this won't work:
-  //IO.data(epd_wakeup_power.data,epd_wakeup_power.databytes);
-
-  IO.cmd(epd_wakeup_power.cmd);
-  for (int i = 0; i < epd_wakeup_power.databytes; ++i)
+  // Queued SPI transactions, data byte by byte since this controller does not take them in one
+  const uint8_t *seq = epd_wakeup_sequence;
+  while ((seq = IO.sequence(seq)) != NULL)
   {
-    IO.data(epd_wakeup_power.data[i]);
+    _waitBusy("_wakeUp power on");
   }
 
-  IO.cmd(0x04);
-  _waitBusy("_wakeUp power on");
-
-  IO.cmd(epd_panel_setting_full.cmd);
-  for (int i = 0; i < epd_panel_setting_full.databytes; ++i)
-  {
-    IO.data(epd_panel_setting_full.data[i]);
-  }
-
-  // Resolution setting
-  IO.cmd(epd_resolution.cmd);
-  for (int i = 0; i < epd_resolution.databytes; ++i)
-  {
-    IO.data(epd_resolution.data[i]);
-  }
-  // Not sure if 0x15 is really needed, seems to work the same without it too
-  IO.cmd(0x15);  // Dual SPI
-  IO.data(0x00); // MM_EN, DUSPI_EN
-
-  IO.cmd(0x50);  // VCOM AND DATA INTERVAL SETTING
-  IO.data(0x29); // LUTKW, N2OCP: copy new to old
-  IO.data(0x07);
-  IO.cmd(0x60);  // TCON SETTING
-  IO.data(0x22);
-
   initFullUpdate();
+  _old_valid = false;
 }
 
 void Gdew075T7::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
-  _using_partial_mode = false;
-  _wakeUp();
+  _initUpdate();
 
   IO.cmd(0x13);
   printf("Sending a %d bytes buffer via SPI\n", sizeof(_buffer));
 
-  // v2 SPI optimizing. Check: https://github.com/martinberlin/cale-idf/wiki/About-SPI-optimization
-  uint16_t i = 0;
+  // v3 SPI optimizing: x1buf is a DMA buffer, next line is packed while the previous is queued
+  uint32_t i = 0;
   uint8_t xLineBytes = GDEW075T7_WIDTH / 8;
-  uint8_t x1buf[xLineBytes];
+  uint8_t *x1buf = IO.streamBegin(xLineBytes);
   for (uint16_t y = 1; y <= GDEW075T7_HEIGHT; y++)
   {
     for (uint16_t x = 1; x <= xLineBytes; x++)
@@ -196,24 +263,24 @@ void Gdew075T7::update()
       uint8_t data = i < sizeof(_buffer) ? _buffer[i] : 0x00;
       x1buf[x - 1] = data;
       if (x == xLineBytes)
-      { // Flush the X line buffer to SPI
-        IO.data(x1buf, sizeof(x1buf));
+      { // Queue the X line buffer to SPI
+        x1buf = IO.streamPush(xLineBytes);
       }
       ++i;
     }
   }
+  IO.streamEnd();
 
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x12);
+  _old_valid = true;
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   uint64_t updateTime = esp_timer_get_time();
   printf("\n\nSTATS (ms)\n%llu _wakeUp settings+send Buffer\n%llu update \n%llu total time in millis\n",
          (endTime - startTime) / 1000, (updateTime - endTime) / 1000, (updateTime - startTime) / 1000);
-  
-  // Additional 2 seconds wait before sleeping since in low temperatures full update takes longer
-  vTaskDelay(2000 / portTICK_PERIOD_MS);
 
-  _sleep();
+  _powerDown();
 }
 
 uint16_t Gdew075T7::_setPartialRamArea(uint16_t x, uint16_t y, uint16_t xe, uint16_t ye)
@@ -233,6 +300,102 @@ uint16_t Gdew075T7::_setPartialRamArea(uint16_t x, uint16_t y, uint16_t xe, uint
   return (7 + xe - x) / 8; // number of bytes to transfer per line
 }
 
+/**
+ * Direct stream. Rows that follow the previous one go to the queued DMA stream.
+ * A full refresh that starts with any row but 0 (A bottom-up bitmap) flips the gate scan (UD bit of the
+ * panel setting) so its rows also follow in RAM. Any other row first sets a partial window from that
+ * row to the bottom since the UC8179 has no RAM pointer command: cmd(0x90), 9 data bytes and cmd(0x13)
+ * drain the stream each time. Partial and fast refresh compare with DTM1 in normal order: no flip
+ */
+void Gdew075T7::_rawStart()
+{
+  _initUpdate();
+  IO.cmd(0x13);
+  _raw_y = 0;
+  _raw_partial = false;
+  _raw_flip = false;
+  _raw_buf = IO.streamBegin(Fb::rowBytes);
+}
+
+void Gdew075T7::_rawRow(uint16_t y, const uint8_t *row)
+{
+  if (_raw_y == 0 && !_raw_partial && y != 0 && !_using_partial_mode) {
+    _raw_flip = true;
+    // RAM rows before a shorter bitmap are the bottom of the screen: white
+    for (uint16_t r = 0; r < GDEW075T7_HEIGHT - 1 - y; r++) {
+      memset(_raw_buf, GDEW075T7_8PIX_WHITE, Fb::rowBytes);
+      _raw_buf = IO.streamPush(Fb::rowBytes);
+    }
+    _raw_y = GDEW075T7_HEIGHT - 1 - y;
+  }
+  if (_raw_flip) y = GDEW075T7_HEIGHT - 1 - y;
+  if (y != _raw_y) {
+    if (!_raw_partial) IO.cmd(0x91); // partial in
+    _raw_partial = true;
+    _setPartialRamArea(0, y, GDEW075T7_WIDTH, GDEW075T7_HEIGHT - 1);
+    IO.cmd(0x13);
+  }
+  memcpy(_raw_buf, row, Fb::rowBytes);
+  _raw_buf = IO.streamPush(Fb::rowBytes);
+  _raw_y = y + 1;
+}
+
+void Gdew075T7::_rawFinish()
+{
+  if (_raw_partial) IO.cmd(0x92); // partial out: refresh the whole screen
+  if (_raw_flip) {
+    IO.cmd(epd_panel_setting_full.cmd); // gate scan down, till the next update sets it again
+    IO.data(epd_panel_setting_full.data[0] & ~0x08);
+  }
+  IO.cmd(0x12);
+  // N2OCP copies the flipped rows to DTM1: the next refresh can not be partial
+  _old_valid = !_raw_flip;
+  if (_deferRefresh()) return;
+  _waitBusy("rawWrite");
+  _powerDown();
+}
+
+/**
+ * Retained image. Deep sleep loses both RAM: the previous image goes to DTM1 (old) and the
+ * framebuffer to DTM2 (new) only in the window of the changed rows, refreshed with the partial LUT
+ */
+void Gdew075T7::_retainStart(uint16_t y0, uint16_t y1)
+{
+  _powerUp();
+  _using_partial_mode = true;
+  initPartialUpdate();
+  IO.cmd(0x91); // partial in
+  _setPartialRamArea(0, y0, GDEW075T7_WIDTH, y1);
+  IO.cmd(0x10);
+  _raw_y = y0;
+  _retain_y1 = y1;
+  _raw_buf = IO.streamBegin(Fb::rowBytes);
+}
+
+void Gdew075T7::_retainOldRow(uint16_t y, const uint8_t *row)
+{
+  if (y < _raw_y || y > _retain_y1) return;
+  memcpy(_raw_buf, row, Fb::rowBytes);
+  _raw_buf = IO.streamPush(Fb::rowBytes);
+}
+
+void Gdew075T7::_retainFinish(uint16_t y0, uint16_t y1)
+{
+  IO.streamEnd();
+  IO.cmd(0x13);
+  uint8_t *x1buf = IO.streamBegin(Fb::rowBytes);
+  for (uint16_t y = y0; y <= y1; y++) {
+    memcpy(x1buf, &_buffer[y * Fb::rowBytes], Fb::rowBytes);
+    x1buf = IO.streamPush(Fb::rowBytes);
+  }
+  IO.streamEnd();
+  IO.cmd(0x12); // display refresh
+  _old_valid = true;
+  _waitBusy("retained partial refresh");
+  IO.cmd(0x92); // partial out
+  _powerDown();
+}
+
 void Gdew075T7::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool using_rotation)
 {
   printf("updateWindow: Still in test mode\n");
@@ -244,45 +407,44 @@ void Gdew075T7::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, boo
     return;
   uint16_t xe = gx_uint16_min(GDEW075T7_WIDTH, x + w) - 1;
   uint16_t ye = gx_uint16_min(GDEW075T7_HEIGHT, y + h) - 1;
+  uint64_t startTime = esp_timer_get_time();
 
-  // x &= 0xFFF8; // byte boundary, need to test this
+  // Byte aligned window: xe_bx is exclusive so the last partial byte is included
   uint16_t xs_bx = x / 8;
-  uint16_t xe_bx = (xe + 7) / 8;
-  if (!_using_partial_mode) {
-    _wakeUp();
-    }
+  uint16_t xe_bx = xe / 8 + 1;
+  uint16_t xBytes = xe_bx - xs_bx;
+  _powerUp();
 
   _using_partial_mode = true;
   initPartialUpdate();
 
   {               // leave both controller buffers equal
     IO.cmd(0x91); // partial in
-    _setPartialRamArea(x, y, xe, ye);
+    _setPartialRamArea(xs_bx * 8, y, xe_bx * 8, ye);
     IO.cmd(0x13);
 
-    for (int16_t y1 = y; y1 <= ye; y1++)
+    // Each window row is gathered from _buffer and sent as one DMA transaction
+    // white is 0xFF in buffer and on device
+    uint8_t *x1buf = IO.streamBegin(xBytes);
+    for (uint16_t y1 = y; y1 <= ye; y1++)
     {
-      for (int16_t x1 = xs_bx; x1 < xe_bx; x1++)
-      {
-        uint16_t idx = y1 * (GDEW075T7_WIDTH / 8) + x1;
-        // white is 0x00 in buffer
-        uint8_t data = (idx < sizeof(_buffer)) ? _buffer[idx] : 0x00;
-        // white is 0xFF on device
-        IO.data(data);
-
-        if (idx % 8 == 0)
-        {
-          rtc_wdt_feed();
-          vTaskDelay(pdMS_TO_TICKS(1));
-        }
-      }
+      memcpy(x1buf, &_buffer[y1 * (GDEW075T7_WIDTH / 8) + xs_bx], xBytes);
+      x1buf = IO.streamPush(xBytes);
     }
+    IO.streamEnd();
+    uint64_t sendTime = esp_timer_get_time();
+
     IO.cmd(0x12); // display refresh
     _waitBusy("updateWindow");
     IO.cmd(0x92); // partial out
+
+    uint64_t refreshTime = esp_timer_get_time();
+    printf("updateWindow STATS (ms) %dx%d bytes: %llu send window %llu refresh %llu total\n",
+           xBytes, ye - y + 1, (sendTime - startTime) / 1000, (refreshTime - sendTime) / 1000, (refreshTime - startTime) / 1000);
   }
 
   vTaskDelay(GDEW075T7_PU_DELAY / portTICK_PERIOD_MS);
+  _powerIdle();
 }
 
 void Gdew075T7::_waitBusy(const char *message)
@@ -291,24 +453,41 @@ void Gdew075T7::_waitBusy(const char *message)
   {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1)
-  {
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1)
-      break;
-    vTaskDelay(1);
-    if (esp_timer_get_time() - time_since_boot > 2000000)
-    {
-      if (debug_enabled)
-        ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, _busy_timeout) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
+}
+
+// UC8179 measures at power on. TSC answers the integer °C in the first byte
+int8_t Gdew075T7::_readTemperature()
+{
+  if (powerState() != EPD_POWER_ON) return EPD_TEMPERATURE_UNKNOWN;
+  uint8_t data[2];
+  IO.cmd(0x40);
+  _waitBusy("temperature");
+  IO.readData(data, 2);
+  return (int8_t)data[0];
+}
+
+bool Gdew075T7::_panelPowerOn()
+{
+  IO.cmd(0x04);
+  _waitBusy("power_on");
+  return true;
+}
+
+// Power off keeps the registers and both RAM, only the deep sleep loses them
+bool Gdew075T7::_panelPowerOff()
+{
+  IO.cmd(0x02);
+  _waitBusy("power_off");
+  return true;
 }
 
 void Gdew075T7::_sleep()
 {
+  _using_partial_mode = false;
+  _old_valid = false;
   IO.cmd(0x02);
   _waitBusy("power_off");
   IO.cmd(0x07); // Deep sleep
@@ -317,52 +496,13 @@ void Gdew075T7::_sleep()
 
 void Gdew075T7::_rotate(uint16_t &x, uint16_t &y, uint16_t &w, uint16_t &h)
 {
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    swap(w, h);
-    x = GDEW075T7_WIDTH - x - w - 1;
-    break;
-  case 2:
-    x = GDEW075T7_WIDTH - x - w - 1;
-    y = GDEW075T7_HEIGHT - y - h - 1;
-    break;
-  case 3:
-    swap(x, y);
-    swap(w, h);
-    y = GDEW075T7_HEIGHT - y - h - 1;
-    break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 void Gdew075T7::drawPixel(int16_t x, int16_t y, uint16_t color)
 {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
     return;
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    x = GDEW075T7_WIDTH - x - 1;
-    break;
-  case 2:
-    x = GDEW075T7_WIDTH - x - 1;
-    y = GDEW075T7_HEIGHT - y - 1;
-    break;
-  case 3:
-    swap(x, y);
-    y = GDEW075T7_HEIGHT - y - 1;
-    break;
-  }
-  uint16_t i = x / 8 + y * GDEW075T7_WIDTH / 8;
-
-  if (color)
-  {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-  }
-  else
-  {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-  }
+  _dirtyPixel(x, y);
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
@@ -109,16 +109,7 @@ void Gdew075T7Grays::init(bool debug)
 ****************/
 void Gdew075T7Grays::fillScreen(uint16_t color)
 {
- 
-  for (uint32_t x = 0; x < GDEW075T7_BUFFER_SIZE; x++)
-  {
-    _buffer[x] = color;
-    if (x % 8 == 0)
-        {
-          rtc_wdt_feed();
-          vTaskDelay(pdMS_TO_TICKS(2));
-        }
-  }
+  memset(_buffer, (uint8_t)color, GDEW075T7_BUFFER_SIZE);
 }
 
 void Gdew075T7Grays::_wakeUp()
@@ -165,6 +156,7 @@ void Gdew075T7Grays::_wakeUp()
 
 void Gdew075T7Grays::update()
 {
+  waitForRefresh();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
 
@@ -254,6 +246,7 @@ void Gdew075T7Grays::update()
   sendLuts();
 
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   uint64_t updateTime = esp_timer_get_time();
   printf("\n\nSTATS (ms)\n%llu _wakeUp settings+send Buffer\n%llu update \n%llu total time in millis\n",
@@ -275,20 +268,9 @@ void Gdew075T7Grays::_waitBusy(const char *message)
   {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1)
-  {
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1)
-      break;
-    vTaskDelay(1);
-    if (esp_timer_get_time() - time_since_boot > 2000000)
-    {
-      if (debug_enabled)
-        ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew075T7Grays::_sleep()
@@ -301,51 +283,14 @@ void Gdew075T7Grays::_sleep()
 
 void Gdew075T7Grays::_rotate(uint16_t &x, uint16_t &y, uint16_t &w, uint16_t &h)
 {
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    swap(w, h);
-    x = GDEW075T7_WIDTH - x - w - 1;
-    break;
-  case 2:
-    x = GDEW075T7_WIDTH - x - w - 1;
-    y = GDEW075T7_HEIGHT - y - h - 1;
-    break;
-  case 3:
-    swap(x, y);
-    swap(w, h);
-    y = GDEW075T7_HEIGHT - y - h - 1;
-    break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 void Gdew075T7Grays::drawPixel(int16_t x, int16_t y, uint16_t color)
 {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
     return;
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    x = GDEW075T7_WIDTH - x - 1;
-    break;
-  case 2:
-    x = GDEW075T7_WIDTH - x - 1;
-    y = GDEW075T7_HEIGHT - y - 1;
-    break;
-  case 3:
-    swap(x, y);
-    y = GDEW075T7_HEIGHT - y - 1;
-    break;
-  }
-
-  uint8_t *buf_ptr = &_buffer[y * GDEW075T7_WIDTH / 2 + x / 2];
-  if (x % 2) {
-    *buf_ptr = (*buf_ptr & 0x0F) | (color & 0xF0);
-  } else {
-    *buf_ptr = (*buf_ptr & 0xF0) | (color >> 4);
-  }
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
 
 void Gdew075T7Grays::fillRawBufferPos(uint32_t index, uint8_t value) {
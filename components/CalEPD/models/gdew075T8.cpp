@@ -12,6 +12,7 @@
 Gdew075T8::Gdew075T8(EpdSpi &dio) : Adafruit_GFX(GDEW075T8_WIDTH, GDEW075T8_HEIGHT),
                                     Epd(GDEW075T8_WIDTH, GDEW075T8_HEIGHT), IO(dio)
 {
+  // No dirty tracking: the first updateWindow() erases the whole panel, updateDirty() runs update()
   printf("Gdew075T8() constructor injects IO and extends Adafruit_GFX(%d,%d) Pix Buffer[%d]\n",
          GDEW075T8_WIDTH, GDEW075T8_HEIGHT, GDEW075T8_BUFFER_SIZE);
   printf("\nAvailable heap after Epd bootstrap:%d\n", xPortGetFreeHeapSize());
@@ -32,11 +33,9 @@ void Gdew075T8::init(bool debug)
 
 void Gdew075T8::fillScreen(uint16_t color)
 {
+  _dirtySpan(0, 0, width(), height());
   uint8_t data = (color == EPD_BLACK) ? GDEW075T8_8PIX_BLACK : GDEW075T8_8PIX_WHITE;
-  for (uint16_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
-  }
+  memset(_buffer, data, sizeof(_buffer));
 }
 
 void Gdew075T8::_wakeUp()
@@ -79,6 +78,8 @@ void Gdew075T8::_wakeUp()
 
 void Gdew075T8::update()
 {
+  waitForRefresh();
+  _updateStart();
   uint64_t startTime = esp_timer_get_time();
   _using_partial_mode = false;
   _wakeUp();
@@ -86,39 +87,19 @@ void Gdew075T8::update()
   IO.cmd(0x10);
   printf("Sending a %d bytes buffer via SPI\n", sizeof(_buffer));
 
-  uint8_t updateMethod = 1;
-
-  switch (updateMethod)
+  // Same as updateWindow(): each row is packed (4 bytes per buffer byte) while the previous one is queued
+  uint16_t rowBytes = GDEW075T8_WIDTH / 8 * 4;
+  uint8_t *x1buf = IO.streamBegin(rowBytes);
+  for (uint16_t y = 0; y < GDEW075T8_HEIGHT; y++)
   {
-  case 1:
-   // Proved to work
-    for (uint16_t c = 0; c < GDEW075T8_BUFFER_SIZE; c++)
-    {
-      _send8pixel(_buffer[c]);
-
-      if (c%500==0) {
-        printf("%d ",c);
-      }
-    }
-    break;
-
-  case 2:
-   // Does not work like expected. Does the IL0371 expect to receive just 1 pixel per SPI transaction?
-    for (uint16_t c = 0; c < GDEW075T8_BUFFER_SIZE; c++)
-    {
-      _send8pixelPack(_buffer[c]);
-
-      if (c%500==0) {
-        printf("%d ",c);
-      }
-    }
-    break;
-  break;
-  } 
+    il0371PackRow(&_buffer[y * (GDEW075T8_WIDTH / 8)], x1buf, GDEW075T8_WIDTH / 8);
+    x1buf = IO.streamPush(rowBytes);
+  }
+  IO.streamEnd();
 
- 
   uint64_t endTime = esp_timer_get_time();
   IO.cmd(0x12);
+  if (_deferRefresh()) return; // updateAsync(): waitForRefresh() does the rest
   _waitBusy("update");
   uint64_t updateTime = esp_timer_get_time();
 
@@ -159,25 +140,6 @@ void Gdew075T8::_send8pixel(uint8_t data)
   }
 }
 
-void Gdew075T8::_send8pixelPack(uint8_t data)
-{
-  uint8_t bits[8];
-
-  for (uint8_t j = 0; j < 8; j++)
-  {
-    uint8_t t = data & 0x80 ? 0x00 : 0x03;
-    t <<= 4;
-    data <<= 1;
-    j++;
-    t |= data & 0x80 ? 0x00 : 0x03;
-    data <<= 1;
-    bits[j] = data;
-  }
-  
-  IO.data(bits, sizeof(bits));
-}
-
-
 void Gdew075T8::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool using_rotation)
 {
   printf("updateWindow: Still in test mode\n");
@@ -207,27 +169,37 @@ void Gdew075T8::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, boo
   // x &= 0xFFF8; // byte boundary, not here, use encompassing rectangle
   uint16_t xe = gx_uint16_min(GDEW075T8_WIDTH, x + w) - 1;
   uint16_t ye = gx_uint16_min(GDEW075T8_HEIGHT, y + h) - 1;
-  // x &= 0xFFF8; // byte boundary, not needed here
+  uint64_t startTime = esp_timer_get_time();
+  // Byte aligned window: xe_bx is exclusive so the last partial byte is included
   uint16_t xs_bx = x / 8;
-  uint16_t xe_bx = (xe + 7) / 8;
-  //if (!_using_partial_mode) _wakeUp();
+  uint16_t xe_bx = xe / 8 + 1;
+  uint16_t xBytes = xe_bx - xs_bx;
   if (!_using_partial_mode) eraseDisplay(true); // clean surrounding
   _using_partial_mode = true;
   IO.cmd(0x91); // partial in
-  _setPartialRamArea(x, y, xe, ye);
+  _setPartialRamArea(xs_bx * 8, y, xe_bx * 8, ye);
   IO.cmd(0x10);
-  for (int16_t y1 = y; y1 <= ye; y1++)
+
+  // Each window row is converted (4 bytes per buffer byte) and sent as one DMA transaction
+  uint16_t rowBytes = xBytes * 4;
+  uint8_t *x1buf = IO.streamBegin(rowBytes);
+  for (uint16_t y1 = y; y1 <= ye; y1++)
   {
-    for (int16_t x1 = xs_bx; x1 < xe_bx; x1++)
-    {
-      uint16_t idx = y1 * (GDEW075T8_WIDTH / 8) + x1;
-      _send8pixel((idx < sizeof(_buffer)) ? _buffer[idx] : 0x00);
-    }
+    const uint8_t *row = &_buffer[y1 * (GDEW075T8_WIDTH / 8) + xs_bx];
+    il0371PackRow(row, x1buf, xBytes);
+    x1buf = IO.streamPush(rowBytes);
   }
-  IO.cmd(0x12);      //display refresh
+  IO.streamEnd();
+  uint64_t sendTime = esp_timer_get_time();
+
+  IO.cmd(0x12); // display refresh
   _waitBusy("updateWindow");
   IO.cmd(0x92); // partial out
 
+  uint64_t refreshTime = esp_timer_get_time();
+  printf("updateWindow STATS (ms) %dx%d bytes: %llu send window %llu refresh %llu total\n",
+         xBytes, ye - y + 1, (sendTime - startTime) / 1000, (refreshTime - sendTime) / 1000, (refreshTime - startTime) / 1000);
+
   vTaskDelay(GDEW075T8_PU_DELAY / portTICK_PERIOD_MS);
 }
 
@@ -269,20 +241,9 @@ void Gdew075T8::_waitBusy(const char *message)
   {
     ESP_LOGI(TAG, "_waitBusy for %s", message);
   }
-  int64_t time_since_boot = esp_timer_get_time();
 
-  while (1)
-  {
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_BUSY) == 1)
-      break;
-    vTaskDelay(1);
-    if (esp_timer_get_time() - time_since_boot > 2000000)
-    {
-      if (debug_enabled)
-        ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
+  // Sleeps on the BUSY edge interrupt until it reads 1 (not busy)
+  if (!IO.waitBusy(1, 2000) && debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
 }
 
 void Gdew075T8::_sleep()
@@ -301,53 +262,12 @@ void Gdew075T8::_sleep()
 
 void Gdew075T8::_rotate(uint16_t &x, uint16_t &y, uint16_t &w, uint16_t &h)
 {
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    swap(w, h);
-    x = GDEW075T8_WIDTH - x - w - 1;
-    break;
-  case 2:
-    x = GDEW075T8_WIDTH - x - w - 1;
-    y = GDEW075T8_HEIGHT - y - h - 1;
-    break;
-  case 3:
-    swap(x, y);
-    swap(w, h);
-    y = GDEW075T8_HEIGHT - y - h - 1;
-    break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 void Gdew075T8::drawPixel(int16_t x, int16_t y, uint16_t color)
 {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
     return;
-  switch (getRotation())
-  {
-  case 1:
-    swap(x, y);
-    x = GDEW075T8_WIDTH - x - 1;
-    break;
-  case 2:
-    x = GDEW075T8_WIDTH - x - 1;
-    y = GDEW075T8_HEIGHT - y - 1;
-    break;
-  case 3:
-    swap(x, y);
-    y = GDEW075T8_HEIGHT - y - 1;
-    break;
-  }
-  uint16_t i = x / 8 + y * GDEW075T8_WIDTH / 8;
-
-  // 8 pix Black is 0xFF
-  if (!color)
-  {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-  }
-  else
-  {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-  }
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
 }
@@ -46,6 +46,7 @@ void Ed047TC1::clearArea(EpdRect area) {
 void Ed047TC1::update(enum EpdDrawMode mode)
 {
   epd_hl_update_screen(&hl, mode, 25);
+  if (mode == MODE_GC16) _ghost.cleanAll();
 }
 
 void Ed047TC1::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, enum EpdDrawMode mode)
@@ -68,6 +69,38 @@ void Ed047TC1::updateWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, enum
   };
   
   epd_hl_update_area(&hl, mode, 25, area);
+
+  if (!_ghost.budget) return;
+  if (mode == MODE_GC16) {
+    _ghost.clean(x, y, w, h);
+    return;
+  }
+  if (_ghost.width() == 0) _ghost.begin(ED047TC1_WIDTH, ED047TC1_HEIGHT);
+  if (_ghost.partial(x, y, w, h)) _cleanGhosting();
+}
+
+/**
+ * Clean refresh of the tiles over the ghosting budget: the area is flashed white and drawn again
+ * with GC16. epdiy only drives the pixels that differ from the front buffer, so it is set to white first
+ */
+void Ed047TC1::_cleanGhosting()
+{
+  uint16_t x, y, w, h;
+  if (!_ghost.overBudget(x, y, w, h)) return;
+  if (debug_enabled) printf("Ghosting budget spent, clean x:%d y:%d w:%d h:%d\n", x, y, w, h);
+  EpdRect area = {
+    .x = x,
+    .y = y,
+    .width = w,
+    .height = h,
+  };
+  epd_clear_area(area);
+  // 4 bpp, tiles start at even x
+  for (uint16_t row = y; row < y + h; ++row) {
+    memset(&hl.front_fb[row * ED047TC1_WIDTH / 2 + x / 2], 0xFF, (w + 1) / 2);
+  }
+  epd_hl_update_area(&hl, MODE_GC16, 25, area);
+  _ghost.clean(x, y, w, h);
 }
 
 void Ed047TC1::powerOn(void)
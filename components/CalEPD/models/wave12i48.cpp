@@ -23,6 +23,7 @@ Wave12I48::Wave12I48(Epd4Spi& dio):
   vTaskDelay(pdMS_TO_TICKS(1));
   printf("Wave12I48() constructor injects IO and extends Adafruit_GFX(%d,%d) Pix Buffer[%d]\n",
   WAVE12I48_WIDTH, WAVE12I48_HEIGHT, WAVE12I48_BUFFER_SIZE);
+  if (_buffer == NULL) printf("Wave12I48: No PSRAM for the full buffer. Use drawPaged()\n");
   printf("\nAvailable heap after Epd bootstrap:%d\n",xPortGetFreeHeapSize());
 }
 
@@ -49,12 +50,13 @@ void Wave12I48::init(bool debug)
 
 void Wave12I48::fillScreen(uint16_t color)
 {
-  if (debug_enabled) printf("fillScreen(%x) Buffer size:%d\n",color,sizeof(_buffer));
   uint8_t data = (color == EPD_BLACK) ? WAVE12I48_8PIX_BLACK : WAVE12I48_8PIX_WHITE;
-  for (uint32_t x = 0; x < sizeof(_buffer); x++)
-  {
-    _buffer[x] = data;
+  if (_page_rows) {
+    memset(_page_buffer, data, Fb::rowBytes * _page_rows);
+    return;
   }
+  if (debug_enabled) printf("fillScreen(%x) Buffer size:%d\n",color,WAVE12I48_BUFFER_SIZE);
+  if (_buffer != NULL) memset(_buffer, data, WAVE12I48_BUFFER_SIZE);
 }
 
 void Wave12I48::_powerOn(){
@@ -63,8 +65,7 @@ void Wave12I48::_powerOn(){
   IO.cmdM2(0x04);
   vTaskDelay(pdMS_TO_TICKS(300));
   IO.cmdM1S1M2S2(0x12);
-  _waitBusyM1("display refresh");
-  _waitBusyM2("display refresh");
+  _waitBusy("display refresh", EPD4SPI_ALL);
 }
 
 void Wave12I48::_wakeUp(){
@@ -125,18 +126,23 @@ void Wave12I48::_wakeUp(){
   IO.cmdM1S1M2S2(0xe0);  //Cascade setting
   IO.dataM1S1M2S2(0x03);
     
-  IO.cmdM1S1M2S2(0xe5);//Force temperature
-  IO.dataM1S1M2S2(0x00);
+  // Force temperature: the one of setTemperatureCallback() or 0 °C, the slowest waveform
+  int8_t temperature = this->temperature();
+  IO.cmdM1S1M2S2(0xe5);
+  IO.dataM1S1M2S2(temperature == EPD_TEMPERATURE_UNKNOWN ? 0x00 : (uint8_t)temperature);
 
 }
 
 void Wave12I48::update()
 {
+  if (_buffer == NULL) {
+    printf("update() needs the full buffer in PSRAM. Use drawPaged()\n");
+    return;
+  }
   uint64_t startTime = esp_timer_get_time();
   _wakeUp();
   
-  printf("Sending a buffer[%d] via SPI\n",sizeof(_buffer));
-  uint32_t i = 0;
+  printf("Sending a buffer[%d] via SPI\n",WAVE12I48_BUFFER_SIZE);
   IO.cmdM1S1M2S2(0x13);
 
   /*
@@ -147,41 +153,11 @@ void Wave12I48::update()
   | M1 | S1 |
   -----------
   */
-  uint8_t x1buf[81];
-  uint8_t x2buf[82];
-
-  // Optimized to send in 81/82 byte chuncks (v2 after our conversation with Samuel)
-  for(uint16_t y =  1; y <= WAVE12I48_HEIGHT; y++) {
-        for(uint16_t x = 1; x <= WAVE12I48_WIDTH/8; x++) {
-          uint8_t data = i < sizeof(_buffer) ? _buffer[i] : 0x00;
-
-        if (y <= 492) {  // S2 & M2 area
-          if (x <= 81) { // 648/8 -> S2
-            x1buf[x-1] = data;
-          } else {       // M2
-            x2buf[x-82] = data;
-          }
-
-          if (x==WAVE12I48_WIDTH/8) {  // Send the complete X line for S2 & M2
-                IO.dataS2(x1buf,sizeof(x1buf));
-                IO.dataM2(x2buf,sizeof(x2buf));
-          }
-
-        } else {         // M1 & S1
-          if (x <= 81) { // 648/8 -> M1
-            x1buf[x-1] = data;
-          } else {       // S1
-            x2buf[x-82] = data;
-          }
-
-          if (x==WAVE12I48_WIDTH/8) { // Send the complete X line for M1 & S1
-              IO.dataM1(x1buf,sizeof(x1buf));
-              IO.dataS1(x2buf,sizeof(x2buf));
-          }
-        }
-          ++i;
-        }
+  // Each 163 byte row is queued as 81/82 byte chuncks, one per controller
+  for (uint16_t y = 0; y < WAVE12I48_HEIGHT; y++) {
+    _sendRow(y, &_buffer[y * Fb::rowBytes]);
   }
+  IO.queueEnd();
   uint64_t endTime = esp_timer_get_time();
   _powerOn();
   uint64_t powerOnTime = esp_timer_get_time();
@@ -195,81 +171,19 @@ uint16_t Wave12I48::_setPartialRamArea(uint16_t, uint16_t, uint16_t, uint16_t){
 }
 
 void Wave12I48::_waitBusy(const char* message){
-  _waitBusyM1(message);
-}
-
-void Wave12I48::_waitBusyM1(const char* message){
-  if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyM1 for %s", message);
-  }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_M1_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
-  vTaskDelay(pdMS_TO_TICKS(200));
-}
-
-void Wave12I48::_waitBusyM2(const char* message){
-  if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyM2 for %s", message);
-  }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_M2_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
-  vTaskDelay(pdMS_TO_TICKS(200));
-}
-
-void Wave12I48::_waitBusyS1(const char* message){
-  if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyS1 for %s", message);
-  }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_S1_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
-  }
-  vTaskDelay(pdMS_TO_TICKS(200));
+  _waitBusy(message, EPD4SPI_M1);
 }
 
-void Wave12I48::_waitBusyS2(const char* message){
+/**
+ * Waits for all the controllers in the mask at once: the 4 BUSY lines are read
+ * in a single register access so the quadrants are not waited one after another
+ */
+void Wave12I48::_waitBusy(const char* message, uint8_t controllers){
   if (debug_enabled) {
-    ESP_LOGI(TAG, "_waitBusyS2 for %s", message);
+    ESP_LOGI(TAG, "_waitBusy for %s controllers:%x", message, controllers);
   }
-  int64_t time_since_boot = esp_timer_get_time();
-
-  while (1){
-    if (gpio_get_level((gpio_num_t)CONFIG_EINK_SPI_S2_BUSY) == 1) break;
-    IO.cmdM1(0x71);
-    vTaskDelay(1);
-    if (esp_timer_get_time()-time_since_boot>WAVE_BUSY_TIMEOUT)
-    {
-      if (debug_enabled) ESP_LOGI(TAG, "Busy Timeout");
-      break;
-    }
+  if (!IO.waitBusy(controllers, WAVE_BUSY_TIMEOUT/1000) && debug_enabled) {
+    ESP_LOGI(TAG, "Busy Timeout");
   }
   vTaskDelay(pdMS_TO_TICKS(200));
 }
@@ -284,98 +198,57 @@ void Wave12I48::_sleep(){
 
 void Wave12I48::_rotate(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h)
 {
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      swap(w, h);
-      x = WAVE12I48_WIDTH - x - w - 1;
-      break;
-    case 2:
-      x = WAVE12I48_WIDTH - x - w - 1;
-      y = WAVE12I48_HEIGHT - y - h - 1;
-      break;
-    case 3:
-      swap(x, y);
-      swap(w, h);
-      y = WAVE12I48_HEIGHT - y - h - 1;
-      break;
-  }
+  Fb::rotateWindow(x, y, w, h, getRotation());
 }
 
 void Wave12I48::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if ((x < 0) || (x >= width()) || (y < 0) || (y >= height())) return;
-  switch (getRotation())
-  {
-    case 1:
-      swap(x, y);
-      x = WAVE12I48_WIDTH - x - 1;
-      break;
-    case 2:
-      x = WAVE12I48_WIDTH - x - 1;
-      y = WAVE12I48_HEIGHT - y - 1;
-      break;
-    case 3:
-      swap(x, y);
-      y = WAVE12I48_HEIGHT - y - 1;
-      break;
+  if (_page_rows) {
+    Fb::drawPixelBand(_page_buffer, x, y, color, getRotation(), _page_y, _page_rows);
+    return;
   }
-  uint32_t i = x / 8 + y * WAVE12I48_WIDTH / 8;
+  if (_buffer == NULL) return;
+  Fb::drawPixel(_buffer, x, y, color, getRotation());
+}
 
-  if (color) {
-    _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
-    } else {
-    _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
-    }
+// Native row y: 0-491 go to S2 (81 bytes) & M2 (82 bytes), 492-983 to M1 & S1
+void Wave12I48::_sendRow(uint16_t y, const uint8_t *row)
+{
+  if (y < 492) {
+    IO.queueData(EPD4SPI_S2, row, 81);
+    IO.queueData(EPD4SPI_M2, row + 81, 82);
+  } else {
+    IO.queueData(EPD4SPI_M1, row, 81);
+    IO.queueData(EPD4SPI_S1, row + 81, 82);
+  }
 }
 
-void Wave12I48::clear(){
-  printf("EPD_12in48_Clear start ...\n");
-    //M1 part 648*492
-    IO.cmdM1(0x10);
-    for(uint16_t y =  492; y < 984; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataM1(0xff);
-        }
-    IO.cmdM1(0x13);
-    for(uint16_t y = 492; y < 984; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataM1(0xff);
-        }
+void Wave12I48::_pageStart()
+{
+  _wakeUp();
+  IO.cmdM1S1M2S2(0x13);
+}
 
-    //S1 part 656*492
-    IO.cmdS1(0x10);
-    for(uint16_t y = 492; y < 984; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataS1(0xff);
-        }
-    IO.cmdS1(0x13);
-    for(uint16_t y = 492; y < 984; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataS1(0xff);
-        }
+void Wave12I48::_pageSend()
+{
+  for (uint16_t r = 0; r < _page_rows; ++r) {
+    _sendRow(_page_y + r, &_page_buffer[r * Fb::rowBytes]);
+  }
+}
 
-    //M2 part 656*492
-    IO.cmdM2(0x10);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataM2(0xff);
-        }
-    IO.cmdM2(0x13);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 81; x < 163; x++) {
-            IO.dataM2(0xff);
-        }
+void Wave12I48::_pageFinish()
+{
+  IO.queueEnd();
+  _powerOn();
+}
 
-    //S2 part 648*492
-    IO.cmdS2(0x10);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataS2(0xff);
-        }
-    IO.cmdS2(0x13);
-    for(uint16_t y = 0; y < 492; y++)
-        for(uint16_t x = 0; x < 81; x++) {
-            IO.dataS2(0xff);
-        }
+void Wave12I48::clear(){
+  printf("EPD_12in48_Clear start ...\n");
+  // M1 & S2 are 648*492 (81 bytes per row), S1 & M2 are 656*492 (82 bytes per row)
+  IO.cmdM1S1M2S2(0x10);
+  IO.dataFill(EPD4SPI_M1|EPD4SPI_S2, 0xff, 81*492);
+  IO.dataFill(EPD4SPI_S1|EPD4SPI_M2, 0xff, 82*492);
+  IO.cmdM1S1M2S2(0x13);
+  IO.dataFill(EPD4SPI_M1|EPD4SPI_S2, 0xff, 81*492);
+  IO.dataFill(EPD4SPI_S1|EPD4SPI_M2, 0xff, 82*492);
 }
\ No newline at end of file
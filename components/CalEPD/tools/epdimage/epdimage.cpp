@@ -0,0 +1,301 @@
+/*
+PNG / JPEG to EPDI converter. See include/epdimagedecoder.h for the format.
+
+NOT AN ESP-IDF COMPONENT. Command-line tool for servers that render images for CalEPD
+displays, so the device downloads the native pixels instead of a BMP or a JPEG to decode.
+
+For UNIX-like systems. Requires libpng and libjpeg:
+  make
+  ./epdimage -f 4 screen.png screen.epdi
+
+The image is dithered row by row with the firmware Dither (include/dither.h), so it looks the
+same as an image dithered in the device, then every row is PackBits compressed.
+The output is decoded again with EpdImageDecoder as a check.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <png.h>
+#include <jpeglib.h>
+#include "epdimagedecoder.h"
+#include "dither.h"
+
+struct Image {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t *rgb = nullptr;  // width * height * 3
+};
+
+// EPDI_3COLOR: black, white, red. EPDI_7COLOR uses Dither::palette7Color
+static const uint8_t palette3[9] = {
+  0, 0, 0,  255, 255, 255,  255, 0, 0
+};
+
+static bool readPng(FILE *f, Image &img)
+{
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png_create_info_struct(png);
+  if (!png || !info || setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, &info, NULL);
+    return false;
+  }
+  png_init_io(png, f);
+  png_read_info(png, info);
+  // Everything to 8 bit RGB, alpha blended over white
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+  png_color_16 white = {0, 255, 255, 255, 255};
+  png_set_background(png, &white, PNG_BACKGROUND_GAMMA_SCREEN, 0, 1.0);
+  png_read_update_info(png, info);
+
+  img.width = png_get_image_width(png, info);
+  img.height = png_get_image_height(png, info);
+  img.rgb = (uint8_t*)malloc(img.width * img.height * 3);
+  png_bytep *rows = (png_bytep*)malloc(img.height * sizeof(png_bytep));
+  for (uint32_t y = 0; y < img.height; y++) rows[y] = &img.rgb[y * img.width * 3];
+  png_read_image(png, rows);
+  free(rows);
+  png_destroy_read_struct(&png, &info, NULL);
+  return true;
+}
+
+static bool readJpeg(FILE *f, Image &img)
+{
+  struct jpeg_decompress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, f);
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+
+  img.width = cinfo.output_width;
+  img.height = cinfo.output_height;
+  img.rgb = (uint8_t*)malloc(img.width * img.height * 3);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = &img.rgb[cinfo.output_scanline * img.width * 3];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+static bool readImage(const char *path, Image &img)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  uint8_t magic[8] = {0};
+  size_t n = fread(magic, 1, sizeof(magic), f);
+  rewind(f);
+  bool ok = false;
+  if (n == 8 && !png_sig_cmp(magic, 0, 8)) {
+    ok = readPng(f, img);
+  } else if (n >= 2 && magic[0] == 0xFF && magic[1] == 0xD8) {
+    ok = readJpeg(f, img);
+  } else {
+    fprintf(stderr, "%s: only PNG and JPEG are supported\n", path);
+  }
+  fclose(f);
+  return ok;
+}
+
+static void putBits(uint8_t *row, uint32_t x, uint8_t bpp, uint8_t value, bool lsbFirst)
+{
+  uint32_t bit = x * bpp;
+  uint8_t shift = lsbFirst ? bit % 8 : 8 - bpp - bit % 8;
+  row[bit / 8] |= value << shift;
+}
+
+// Appends row PackBits encoded to out. Returns the bytes written
+static uint32_t packBits(const uint8_t *row, uint32_t len, uint8_t *out)
+{
+  uint32_t o = 0;
+  uint32_t i = 0;
+  while (i < len) {
+    uint32_t run = 1;
+    while (i + run < len && run < 128 && row[i + run] == row[i]) run++;
+    if (run >= 3) {
+      out[o++] = (uint8_t)(257 - run);
+      out[o++] = row[i];
+      i += run;
+      continue;
+    }
+    // Literal until the next run of 3 or more, shorter runs cost the same inside it
+    uint32_t start = i;
+    while (i < len && i - start < 128 && !(i + 2 < len && row[i] == row[i + 1] && row[i] == row[i + 2])) i++;
+    out[o++] = (uint8_t)(i - start - 1);
+    memcpy(&out[o], &row[start], i - start);
+    o += i - start;
+  }
+  return o;
+}
+
+// Counts what the decoder draws to check the output
+class CheckSink : public EpdImageDecoder::Sink
+{
+  public:
+    uint32_t pixels = 0;
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override { pixels++; }
+    bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      pixels += w;
+      return true;
+    }
+};
+
+static void usage()
+{
+  fprintf(stderr,
+    "Usage: epdimage [-f 1|2|4|3c|7c] [-d fs|atkinson|bayer|bluenoise|none] [-l] [-u] [-v] input.png|jpg output.epdi\n"
+    "  -f  format: 1 bpp (default), 2 or 4 bpp gray, 3 colors (black, white, red) or 7 colors\n"
+    "  -d  dithering: Floyd-Steinberg (default), Atkinson, 8x8 Bayer, blue noise or none\n"
+    "  -l  LSB first: first pixel in the low bits of the byte\n"
+    "  -u  uncompressed rows\n"
+    "  -v  verbose\n");
+}
+
+int main(int argc, char *argv[])
+{
+  uint8_t format = EPDI_1BPP;
+  uint8_t flags = EPDI_PACKBITS;
+  uint8_t mode = DITHER_FLOYD_STEINBERG;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:d:luv")) != -1) {
+    switch (opt) {
+      case 'f':
+        if (!strcmp(optarg, "1")) format = EPDI_1BPP;
+        else if (!strcmp(optarg, "2")) format = EPDI_2BPP_GRAY;
+        else if (!strcmp(optarg, "4")) format = EPDI_4BPP_GRAY;
+        else if (!strcmp(optarg, "3c")) format = EPDI_3COLOR;
+        else if (!strcmp(optarg, "7c")) format = EPDI_7COLOR;
+        else {
+          usage();
+          return 1;
+        }
+        break;
+      case 'd':
+        if (!strcmp(optarg, "fs")) mode = DITHER_FLOYD_STEINBERG;
+        else if (!strcmp(optarg, "atkinson")) mode = DITHER_ATKINSON;
+        else if (!strcmp(optarg, "bayer")) mode = DITHER_BAYER;
+        else if (!strcmp(optarg, "bluenoise")) mode = DITHER_BLUE_NOISE;
+        else if (!strcmp(optarg, "none")) mode = DITHER_NONE;
+        else {
+          usage();
+          return 1;
+        }
+        break;
+      case 'l':
+        flags |= EPDI_LSB_FIRST;
+        break;
+      case 'u':
+        flags &= ~EPDI_PACKBITS;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if (argc - optind != 2) {
+    usage();
+    return 1;
+  }
+
+  Image img;
+  if (!readImage(argv[optind], img)) return 1;
+  if (img.width > 0xFFFF || img.height > 0xFFFF) {
+    fprintf(stderr, "Image too big: %dx%d\n", img.width, img.height);
+    return 1;
+  }
+
+  const bool lsbFirst = flags & EPDI_LSB_FIRST;
+  const bool color = (format == EPDI_3COLOR || format == EPDI_7COLOR);
+  const uint8_t bpp = (format == EPDI_2BPP_GRAY) ? 2 : (format == EPDI_4BPP_GRAY || format == EPDI_7COLOR) ? 4 : 1;
+  const uint32_t planeSize = (img.width * bpp + 7) / 8;
+  const uint32_t rowSize = (format == EPDI_3COLOR) ? planeSize * 2 : planeSize;
+
+  // Worst case PackBits adds a count byte every 128
+  uint8_t *out = (uint8_t*)malloc(EPDI_HEADER_SIZE + (rowSize + rowSize / 128 + 2) * img.height);
+  uint8_t *row = (uint8_t*)malloc(rowSize);
+  uint8_t *levels = (uint8_t*)malloc(img.width);
+  Dither dither(mode, color ? DITHER_7COLOR : (bpp == 1) ? DITHER_BW : (bpp == 2) ? DITHER_4GRAY : DITHER_16GRAY);
+  if (format == EPDI_3COLOR) {
+    dither.palette = palette3;
+    dither.paletteSize = 3;
+  }
+  dither.begin(img.width);
+
+  uint32_t o = EPDI_HEADER_SIZE;
+  for (uint32_t y = 0; y < img.height; y++) {
+    const uint8_t *rgb = &img.rgb[y * img.width * 3];
+    memset(row, 0, rowSize);
+    switch (format) {
+      case EPDI_3COLOR:
+        dither.rgbRow(rgb, levels);
+        for (uint32_t x = 0; x < img.width; x++) {
+          // Black & white plane is white under the red pixels
+          putBits(row, x, 1, levels[x] != 0, lsbFirst);
+          putBits(&row[planeSize], x, 1, levels[x] == 2, lsbFirst);
+        }
+        break;
+      case EPDI_7COLOR:
+        dither.rgbRow(rgb, levels);
+        for (uint32_t x = 0; x < img.width; x++) putBits(row, x, 4, levels[x], lsbFirst);
+        break;
+      default:
+        dither.rgbRow(rgb, levels);
+        for (uint32_t x = 0; x < img.width; x++) putBits(row, x, bpp, levels[x], lsbFirst);
+    }
+    if (flags & EPDI_PACKBITS) {
+      o += packBits(row, rowSize, &out[o]);
+    } else {
+      memcpy(&out[o], row, rowSize);
+      o += rowSize;
+    }
+  }
+
+  uint32_t payload = o - EPDI_HEADER_SIZE;
+  uint8_t header[EPDI_HEADER_SIZE] = {'E', 'P', 'D', 'I', EPDI_VERSION, format, flags, 0,
+    (uint8_t)img.width, (uint8_t)(img.width >> 8), (uint8_t)img.height, (uint8_t)(img.height >> 8),
+    (uint8_t)payload, (uint8_t)(payload >> 8), (uint8_t)(payload >> 16), (uint8_t)(payload >> 24)};
+  memcpy(out, header, EPDI_HEADER_SIZE);
+
+  // Decode it in small chunks like the HTTP client does
+  CheckSink sink;
+  EpdImageDecoder decoder(sink, img.width, img.height);
+  bool ok = true;
+  for (uint32_t i = 0; i < o && ok; i += 512) {
+    ok = decoder.write(&out[i], (o - i < 512) ? o - i : 512);
+  }
+  if (!ok || !decoder.done() || sink.pixels != img.width * img.height) {
+    fprintf(stderr, "Check failed: decoded %d of %d pixels\n", sink.pixels, img.width * img.height);
+    return 1;
+  }
+
+  FILE *f = fopen(argv[optind + 1], "wb");
+  if (!f || fwrite(out, 1, o, f) != o) {
+    perror(argv[optind + 1]);
+    return 1;
+  }
+  fclose(f);
+  if (verbose) {
+    printf("%dx%d format:%x flags:%x %d bytes (%d uncompressed)\n",
+           img.width, img.height, format, flags, o, EPDI_HEADER_SIZE + rowSize * img.height);
+  }
+  free(out);
+  free(row);
+  free(levels);
+  free(img.rgb);
+  return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * BmpStreamDecoder on the host: 1, 4 and 8 bit bitmaps, bottom-up and top-down, with widths that are
+ * not a multiple of 8 and bigger than the display, fed in random chunks down to one byte.
+ * Every pixel the Sink gets is compared with the palette color of the generated index.
+ */
+#include <bmpstreamdecoder.h>
+#include "hosttest.h"
+
+#define MAX_W 40
+#define MAX_H 24
+// Marks pixels the decoder did not draw
+#define UNSET 0x1234
+
+class MemorySink : public BmpStreamDecoder::Sink
+{
+  public:
+    uint16_t pixels[MAX_H][MAX_W];
+    bool acceptRowBits = true;
+    int rowBitsCalls = 0;
+    int outside = 0;
+
+    void clear() {
+      for (int y = 0; y < MAX_H; ++y) for (int x = 0; x < MAX_W; ++x) pixels[y][x] = UNSET;
+      rowBitsCalls = 0;
+      outside = 0;
+    }
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+      if (x < 0 || x >= MAX_W || y < 0 || y >= MAX_H) { outside++; return; }
+      pixels[y][x] = color;
+    }
+    bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      if (!acceptRowBits) return false;
+      rowBitsCalls++;
+      if (w > MAX_W) { outside++; w = MAX_W; }
+      for (uint16_t x = 0; x < w; ++x) drawPixel(x, y, (bits[x / 8] & (0x80 >> x % 8)) ? EPD_WHITE : EPD_BLACK);
+      return true;
+    }
+};
+
+static void put16(std::vector<uint8_t>& f, uint16_t v) { f.push_back(v); f.push_back(v >> 8); }
+static void put32(std::vector<uint8_t>& f, uint32_t v) { put16(f, v); put16(f, v >> 16); }
+
+// Palette of the test bitmaps, written as BGRA
+struct Rgb { uint8_t r, g, b; };
+static const Rgb palette[] = {
+  {0, 0, 0}, {255, 255, 255}, {255, 0, 0}, {40, 40, 40}, {200, 210, 220}, {250, 250, 20}, {90, 30, 10}, {130, 140, 150}
+};
+
+static uint8_t pixelIndex(int depth, int x, int y, int colors)
+{
+  return (x * 7 + y * 3 + (x ^ y)) % (depth == 1 ? 2 : colors);
+}
+
+// BITMAPINFOHEADER, palette and the padded rows in file order
+static std::vector<uint8_t> makeBmp(int depth, int width, int height, bool topDown, const Rgb *pal, int colors, uint32_t gap = 0)
+{
+  const uint32_t rowSize = ((width * depth + 31) / 32) * 4;
+  const uint32_t offset = 14 + 40 + 4 * colors + gap;
+  std::vector<uint8_t> f;
+  put16(f, 0x4D42);
+  put32(f, offset + rowSize * height);
+  put32(f, 0);
+  put32(f, offset);
+  put32(f, 40);
+  put32(f, width);
+  put32(f, topDown ? -height : height);
+  put16(f, 1);
+  put16(f, depth);
+  put32(f, 0);
+  put32(f, rowSize * height);
+  put32(f, 2835);
+  put32(f, 2835);
+  put32(f, colors);
+  put32(f, 0);
+  for (int i = 0; i < colors; ++i) {
+    f.push_back(pal[i].b);
+    f.push_back(pal[i].g);
+    f.push_back(pal[i].r);
+    f.push_back(0);
+  }
+  f.resize(offset, 0);
+  for (int row = 0; row < height; ++row) {
+    const int y = topDown ? row : height - 1 - row;
+    std::vector<uint8_t> r(rowSize, 0);
+    for (int x = 0; x < width; ++x) {
+      uint32_t bit = x * depth;
+      r[bit / 8] |= pixelIndex(depth, x, y, colors) << (8 - depth - bit % 8);
+    }
+    f.insert(f.end(), r.begin(), r.end());
+  }
+  return f;
+}
+
+// Same rules as BmpStreamDecoder::_parsePalette() with withColor set
+static uint16_t expectedColor(const Rgb& c, int depth)
+{
+  if (depth == 1) return (c.r + c.g + c.b) > 3 * 0x80 ? EPD_WHITE : EPD_BLACK;
+  if (c.r > 0x80 && c.g > 0x80 && c.b > 0x80) return EPD_WHITE;
+  if (c.r > 0xF0 || (c.g > 0xF0 && c.b > 0xF0)) return EPD_RED;
+  return EPD_BLACK;
+}
+
+static void testBitmap(BmpStreamDecoder& bmp, MemorySink& sink, int depth, int width, int height, bool topDown,
+                       const Rgb *pal, int colors, size_t maxChunk)
+{
+  std::vector<uint8_t> f = makeBmp(depth, width, height, topDown, pal, colors, maxChunk % 3 ? 0 : 6);
+  sink.clear();
+  bmp.reset();
+  CHECK(feed(bmp, f, maxChunk), "%d bpp %dx%d write failed", depth, width, height);
+  CHECK(bmp.done(), "%d bpp %dx%d %s not done", depth, width, height, topDown ? "top-down" : "bottom-up");
+  CHECK(sink.outside == 0, "%d bpp %dx%d drew %d pixels outside", depth, width, height, sink.outside);
+
+  int wrong = 0;
+  for (int y = 0; y < MAX_H; ++y) {
+    for (int x = 0; x < MAX_W; ++x) {
+      uint16_t want = (x < width && y < height) ? expectedColor(pal[pixelIndex(depth, x, y, colors)], depth) : UNSET;
+      if (sink.pixels[y][x] != want && wrong++ < 3) {
+        printf("  %d bpp %dx%d %s chunk %d: (%d,%d) is %04x, expected %04x\n", depth, width, height,
+               topDown ? "top-down" : "bottom-up", (int)maxChunk, x, y, sink.pixels[y][x], want);
+      }
+    }
+  }
+  CHECK(wrong == 0, "%d bpp %dx%d: %d wrong pixels", depth, width, height, wrong);
+}
+
+int main()
+{
+  MemorySink sink;
+  BmpStreamDecoder bmp(sink, MAX_W, MAX_H);
+  srand(1);
+
+  static const int depths[] = {1, 4, 8};
+  static const int sizes[][2] = {{13, 7}, {32, 24}, {57, 30}, {40, 1}};
+  static const size_t chunks[] = {1, 3, 17, 100, 4096};
+  const Rgb inverted[] = {{255, 255, 255}, {0, 0, 0}};
+
+  for (int depth : depths) {
+    for (auto& size : sizes) {
+      for (int topDown = 0; topDown < 2; ++topDown) {
+        for (size_t chunk : chunks) {
+          testBitmap(bmp, sink, depth, size[0], size[1], topDown, palette, depth == 1 ? 2 : 8, chunk);
+          if (depth == 1) {
+            // White 0, black 1: rows are inverted before drawRowBits()
+            testBitmap(bmp, sink, depth, size[0], size[1], topDown, inverted, 2, chunk);
+            CHECK(sink.rowBitsCalls > 0, "inverted 1 bpp rows did not use drawRowBits()");
+            // A Sink without drawRowBits() gets the same pixels
+            sink.acceptRowBits = false;
+            testBitmap(bmp, sink, depth, size[0], size[1], topDown, palette, 2, chunk);
+            sink.acceptRowBits = true;
+          }
+        }
+      }
+    }
+  }
+
+  // Dithered 4 and 8 bit grays: rows of bits clipped to the display, then no dither again
+  const Rgb grays[] = {{0, 0, 0}, {60, 60, 60}, {120, 120, 120}, {180, 180, 180}, {255, 255, 255}};
+  Dither dither(DITHER_FLOYD_STEINBERG, DITHER_BW);
+  for (int depth = 4; depth <= 8; depth += 4) {
+    std::vector<uint8_t> f = makeBmp(depth, 57, 30, depth == 8, grays, 5);
+    sink.clear();
+    bmp.dither = &dither;
+    bmp.reset();
+    CHECK(feed(bmp, f, 13) && bmp.done(), "%d bpp dithered not done", depth);
+    CHECK(bmp.rowBits() && sink.rowBitsCalls == MAX_H, "%d bpp dithered rows did not use drawRowBits()", depth);
+    CHECK(sink.outside == 0, "%d bpp dithered drew %d pixels outside", depth, sink.outside);
+    int unset = 0;
+    for (int y = 0; y < MAX_H; ++y) for (int x = 0; x < MAX_W; ++x) unset += sink.pixels[y][x] == UNSET;
+    CHECK(unset == 0, "%d bpp dithered left %d pixels", depth, unset);
+    bmp.dither = nullptr;
+  }
+  testBitmap(bmp, sink, 8, 57, 30, false, palette, 8, 17);
+
+  // Data after the last row is ignored until reset()
+  std::vector<uint8_t> f = makeBmp(8, 20, 10, false, palette, 8);
+  bmp.reset();
+  feed(bmp, f, 50);
+  CHECK(bmp.done(), "8 bpp not done");
+  CHECK(bmp.write(f.data(), f.size()), "write after done failed");
+
+  // Unsupported files fail and stay failed
+  f = makeBmp(8, 20, 10, false, palette, 8);
+  f[28] = 24;
+  bmp.reset();
+  CHECK(!bmp.write(f.data(), f.size()) && bmp.failed(), "24 bpp accepted");
+  CHECK(!bmp.write(f.data(), 10), "write after failure accepted");
+  f = makeBmp(8, 20, 10, false, palette, 8);
+  f[0] = 'X';
+  bmp.reset();
+  CHECK(!bmp.write(f.data(), f.size()), "file without BM signature accepted");
+
+  // Truncated file is not done
+  f = makeBmp(4, 20, 10, true, palette, 8);
+  bmp.reset();
+  CHECK(bmp.write(f.data(), f.size() - 5), "truncated write failed");
+  CHECK(!bmp.done(), "truncated file done");
+
+  return finish("bmp_test");
+}
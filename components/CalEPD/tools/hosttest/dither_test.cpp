@@ -0,0 +1,176 @@
+/**
+ * Dither on the host: every mode and target. Level grays and palette colors must come out exact,
+ * flat grays must keep their mean, grayRowBits() must match grayRow() and all the output stays in range.
+ * Rows are exactly the image width on the heap, from 1 pixel up, so ASan catches any write outside.
+ */
+#include <dither.h>
+#include "hosttest.h"
+
+static const uint8_t modes[] = {DITHER_NONE, DITHER_FLOYD_STEINBERG, DITHER_ATKINSON, DITHER_BAYER, DITHER_BLUE_NOISE};
+static const uint8_t grayTargets[] = {DITHER_BW, DITHER_4GRAY, DITHER_16GRAY};
+static const uint16_t flatWidths[] = {1, 5, 64};
+static const uint16_t rowWidths[] = {1, 2, 3, 7, 8, 9, 33, 250};
+static const uint16_t paletteWidths[] = {1, 7, 50};
+
+// Mean gray of a flat w x h image after dithering
+static double flatMean(Dither& d, uint8_t gray, uint16_t w, uint16_t h)
+{
+  uint8_t *in = (uint8_t*)malloc(w);
+  uint8_t *out = (uint8_t*)malloc(w);
+  memset(in, gray, w);
+  d.begin(w);
+  uint32_t sum = 0;
+  for (uint16_t y = 0; y < h; ++y) {
+    d.grayRow(in, out);
+    for (uint16_t x = 0; x < w; ++x) sum += d.gray(out[x]);
+  }
+  free(in);
+  free(out);
+  return (double)sum / (w * h);
+}
+
+static void testGray(uint8_t mode, uint8_t target)
+{
+  Dither d(mode, target);
+  const uint8_t levels = d.levels();
+  CHECK(levels == (target == DITHER_BW ? 2 : (target == DITHER_4GRAY ? 4 : 16)), "levels %d", levels);
+
+  // Grays of the levels themselves are not dithered
+  for (uint8_t l = 0; l < levels; ++l) {
+    d.begin(1);
+    const uint8_t gray = l * 255 / (levels - 1);
+    CHECK(d.gray(l) == gray, "mode %d target %d level %d is gray %d", mode, target, l, d.gray(l));
+    for (uint16_t w : flatWidths) {
+      uint8_t *in = (uint8_t*)malloc(w);
+      uint8_t *out = (uint8_t*)malloc(w);
+      memset(in, gray, w);
+      d.begin(w);
+      int wrong = 0;
+      for (uint16_t y = 0; y < 40; ++y) {
+        d.grayRow(in, out);
+        for (uint16_t x = 0; x < w; ++x) wrong += out[x] != l;
+      }
+      CHECK(wrong == 0, "mode %d target %d width %d: level gray %d dithered in %d pixels", mode, target, w, gray, wrong);
+      for (uint16_t x = 0; x < 64; ++x) wrong += d.pixel(gray, x, x * 3) != l;
+      CHECK(wrong == 0, "mode %d target %d: pixel() dithers level gray %d", mode, target, gray);
+      free(in);
+      free(out);
+    }
+  }
+
+  // Flat grays keep their mean. DITHER_NONE rounds to the nearest level and DITHER_ATKINSON drops
+  // 1/4 of the error on purpose, for contrast
+  if (mode != DITHER_NONE && mode != DITHER_ATKINSON) {
+    for (uint16_t gray = 8; gray < 256; gray += 31) {
+      double mean = flatMean(d, gray, 64, 64);
+      CHECK(mean > gray - 6 && mean < gray + 6, "mode %d target %d: gray %d has mean %.1f", mode, target, gray, mean);
+    }
+  }
+
+  // Random rows: output in range, and the bits of grayRowBits() are the white half of the levels
+  for (uint16_t w : rowWidths) {
+    uint8_t *in = (uint8_t*)malloc(w);
+    uint8_t *out = (uint8_t*)malloc(w);
+    uint8_t *bits = (uint8_t*)malloc((w + 7) / 8);
+    Dither levelsDither(mode, target);
+    levelsDither.begin(w);
+    d.begin(w);
+    int wrong = 0;
+    for (uint16_t y = 0; y < 20; ++y) {
+      for (uint16_t x = 0; x < w; ++x) in[x] = rand();
+      levelsDither.grayRow(in, out);
+      d.grayRowBits(in, bits);
+      for (uint16_t x = 0; x < w; ++x) {
+        if (out[x] >= levels) wrong++;
+        bool white = bits[x / 8] & (0x80 >> x % 8);
+        if (white != ((levelsDither.gray(out[x]) & 0x80) != 0)) wrong++;
+      }
+    }
+    CHECK(wrong == 0, "mode %d target %d width %d: %d pixels differ between grayRow() and grayRowBits()", mode, target, w, wrong);
+    free(in);
+    free(out);
+    free(bits);
+  }
+
+  // RGB rows use the luminance: equal channels are the same gray
+  uint8_t rgb[3 * 16], gray[16], outRgb[16], outGray[16];
+  for (uint8_t x = 0; x < 16; ++x) {
+    gray[x] = x * 17;
+    rgb[x * 3] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = gray[x];
+  }
+  Dither a(mode, target), b(mode, target);
+  a.begin(16);
+  b.begin(16);
+  a.rgbRow(rgb, outRgb);
+  b.grayRow(gray, outGray);
+  int wrong = 0;
+  for (uint8_t x = 0; x < 16; ++x) wrong += abs(outRgb[x] - outGray[x]) > 1;
+  CHECK(wrong == 0, "mode %d target %d: rgbRow() of grays differs from grayRow()", mode, target);
+}
+
+static void test7Color(uint8_t mode)
+{
+  Dither d(mode, DITHER_7COLOR);
+  CHECK(d.levels() == 7, "7 color levels %d", d.levels());
+
+  // A row of every palette color, repeated: stays exact in all modes
+  for (uint16_t w : paletteWidths) {
+    uint8_t *rgb = (uint8_t*)malloc(w * 3);
+    uint8_t *out = (uint8_t*)malloc(w);
+    d.begin(w);
+    int wrong = 0;
+    for (uint16_t y = 0; y < 30; ++y) {
+      for (uint16_t x = 0; x < w; ++x) memcpy(&rgb[x * 3], &Dither::palette7Color[((x + y) % 7) * 3], 3);
+      d.rgbRow(rgb, out);
+      for (uint16_t x = 0; x < w; ++x) wrong += out[x] != (x + y) % 7;
+    }
+    CHECK(wrong == 0, "mode %d width %d: %d palette pixels changed", mode, w, wrong);
+    free(rgb);
+    free(out);
+  }
+
+  // Random RGB and gray rows give palette indexes
+  const uint16_t w = 77;
+  uint8_t *rgb = (uint8_t*)malloc(w * 3);
+  uint8_t *out = (uint8_t*)malloc(w);
+  d.begin(w);
+  int wrong = 0;
+  for (uint16_t y = 0; y < 20; ++y) {
+    for (uint16_t x = 0; x < w * 3; ++x) rgb[x] = rand();
+    if (y & 1) {
+      d.grayRow(rgb, out);
+    } else {
+      d.rgbRow(rgb, out);
+    }
+    for (uint16_t x = 0; x < w; ++x) wrong += out[x] >= 7;
+  }
+  CHECK(wrong == 0, "mode %d: %d indexes out of the palette", mode, wrong);
+  for (uint16_t x = 0; x < 64; ++x) wrong += d.pixel(x * 4, x, x) >= 7;
+  CHECK(wrong == 0, "mode %d: pixel() out of the palette", mode);
+  CHECK(d.pixel(0, 3, 3) == 0 || mode != DITHER_NONE, "black is not black");
+  CHECK(d.pixel(255, 3, 3) == 1 || mode != DITHER_NONE, "white is not white");
+  free(rgb);
+  free(out);
+}
+
+int main()
+{
+  srand(1);
+  for (uint8_t mode : modes) {
+    for (uint8_t target : grayTargets) testGray(mode, target);
+    test7Color(mode);
+  }
+
+  // The threshold moves the DITHER_BW midpoint
+  Dither d(DITHER_NONE, DITHER_BW);
+  d.threshold = 200;
+  CHECK(d.pixel(180, 0, 0) == 0 && d.pixel(220, 0, 0) == 1, "threshold 200 ignored");
+  d.threshold = 100;
+  CHECK(d.pixel(120, 0, 0) == 1 && d.pixel(80, 0, 0) == 0, "threshold 100 ignored");
+
+  // begin() again, for the next image, frees the last error rows
+  Dither fs;
+  for (uint16_t w = 1; w < 100; w += 7) CHECK(fs.begin(w), "begin(%d) failed", w);
+
+  return finish("dither_test");
+}
@@ -0,0 +1,204 @@
+/**
+ * EpdImageDecoder on the host: every format, MSB and LSB first, plain and PackBits, fed in random chunks
+ * down to one byte. PackBits runs cross the row ends and no-op count bytes are mixed in, like any
+ * encoder may write them. Every pixel the Sink gets is compared with the generated value.
+ */
+#include <epdimagedecoder.h>
+#include "hosttest.h"
+
+#define MAX_W 40
+#define MAX_H 24
+// Marks pixels the decoder did not draw
+#define UNSET 0x1234
+
+class MemorySink : public EpdImageDecoder::Sink
+{
+  public:
+    uint16_t pixels[MAX_H][MAX_W];
+    bool acceptRowBits = true;
+    int outside = 0;
+
+    void clear() {
+      for (int y = 0; y < MAX_H; ++y) for (int x = 0; x < MAX_W; ++x) pixels[y][x] = UNSET;
+      outside = 0;
+    }
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+      if (x < 0 || x >= MAX_W || y < 0 || y >= MAX_H) { outside++; return; }
+      pixels[y][x] = color;
+    }
+    bool drawRowBits(int16_t y, const uint8_t *bits, uint16_t w) override {
+      if (!acceptRowBits) return false;
+      if (w > MAX_W) { outside++; w = MAX_W; }
+      for (uint16_t x = 0; x < w; ++x) drawPixel(x, y, (bits[x / 8] & (0x80 >> x % 8)) ? EPD_WHITE : EPD_BLACK);
+      return true;
+    }
+};
+
+static uint8_t formatBpp(uint8_t format)
+{
+  switch (format) {
+    case EPDI_2BPP_GRAY: return 2;
+    case EPDI_4BPP_GRAY:
+    case EPDI_7COLOR: return 4;
+    default: return 1;
+  }
+}
+
+// Long runs of the same value in the first rows, so PackBits has runs that cross the row ends
+static uint8_t pixelValue(uint8_t format, int x, int y)
+{
+  uint8_t v = (y < 3) ? (x / 16) : (x * 5 + y * 3 + x * y);
+  switch (format) {
+    case EPDI_2BPP_GRAY: return v % 4;
+    case EPDI_4BPP_GRAY: return v % 16;
+    case EPDI_7COLOR: return v % 7;
+    default: return v % 2;
+  }
+}
+
+// EPDI_3COLOR: only some rows have color, the others go as black & white bits
+static bool colorValue(int x, int y)
+{
+  return y % 3 == 1 && (x + y) % 5 == 0;
+}
+
+static uint16_t expectedColor(EpdImageDecoder& img, uint8_t format, int x, int y)
+{
+  uint8_t v = pixelValue(format, x, y);
+  switch (format) {
+    case EPDI_2BPP_GRAY: return v * 255 / 3;
+    case EPDI_4BPP_GRAY: return v * 255 / 15;
+    case EPDI_7COLOR: return img.colors7[v];
+    case EPDI_3COLOR: if (colorValue(x, y)) return EPD_RED;
+      // Fall through
+    default: return v ? EPD_WHITE : EPD_BLACK;
+  }
+}
+
+static void putBits(uint8_t *row, uint32_t x, uint8_t bpp, uint8_t value, bool lsbFirst)
+{
+  uint32_t bit = x * bpp;
+  uint8_t shift = lsbFirst ? bit % 8 : 8 - bpp - bit % 8;
+  row[bit / 8] |= value << shift;
+}
+
+// The whole payload in one go, with a -128 no-op now and then
+static std::vector<uint8_t> packBits(const std::vector<uint8_t>& in)
+{
+  std::vector<uint8_t> out;
+  size_t i = 0;
+  while (i < in.size()) {
+    if (rand() % 8 == 0) out.push_back(0x80);
+    size_t run = 1;
+    while (i + run < in.size() && run < 128 && in[i + run] == in[i]) run++;
+    if (run >= 3) {
+      out.push_back(257 - run);
+      out.push_back(in[i]);
+      i += run;
+      continue;
+    }
+    size_t start = i;
+    while (i < in.size() && i - start < 128 && !(i + 2 < in.size() && in[i] == in[i + 1] && in[i] == in[i + 2])) i++;
+    out.push_back(i - start - 1);
+    out.insert(out.end(), in.begin() + start, in.begin() + i);
+  }
+  return out;
+}
+
+static std::vector<uint8_t> makeEpdi(uint8_t format, uint8_t flags, int width, int height)
+{
+  const uint8_t bpp = formatBpp(format);
+  const bool lsbFirst = flags & EPDI_LSB_FIRST;
+  const uint32_t planeSize = (width * bpp + 7) / 8;
+  std::vector<uint8_t> rows;
+  for (int y = 0; y < height; ++y) {
+    std::vector<uint8_t> row(format == EPDI_3COLOR ? 2 * planeSize : planeSize, 0);
+    for (int x = 0; x < width; ++x) {
+      putBits(row.data(), x, bpp, pixelValue(format, x, y), lsbFirst);
+      if (format == EPDI_3COLOR) putBits(row.data() + planeSize, x, 1, colorValue(x, y), lsbFirst);
+    }
+    rows.insert(rows.end(), row.begin(), row.end());
+  }
+  if (flags & EPDI_PACKBITS) rows = packBits(rows);
+
+  std::vector<uint8_t> f = { 'E', 'P', 'D', 'I', EPDI_VERSION, format, flags, 0,
+    (uint8_t)width, (uint8_t)(width >> 8), (uint8_t)height, (uint8_t)(height >> 8),
+    (uint8_t)rows.size(), (uint8_t)(rows.size() >> 8), (uint8_t)(rows.size() >> 16), (uint8_t)(rows.size() >> 24) };
+  f.insert(f.end(), rows.begin(), rows.end());
+  return f;
+}
+
+static void testImage(EpdImageDecoder& img, MemorySink& sink, uint8_t format, uint8_t flags, int width, int height, size_t maxChunk)
+{
+  std::vector<uint8_t> f = makeEpdi(format, flags, width, height);
+  sink.clear();
+  img.reset();
+  CHECK(EpdImageDecoder::isEpdImage(f.data(), f.size()), "signature not detected");
+  CHECK(feed(img, f, maxChunk), "format %x flags %x %dx%d write failed", format, flags, width, height);
+  CHECK(img.done(), "format %x flags %x %dx%d chunk %d not done", format, flags, width, height, (int)maxChunk);
+  CHECK(sink.outside == 0, "format %x flags %x drew %d pixels outside", format, flags, sink.outside);
+
+  int wrong = 0;
+  for (int y = 0; y < MAX_H; ++y) {
+    for (int x = 0; x < MAX_W; ++x) {
+      uint16_t want = (x < width && y < height) ? expectedColor(img, format, x, y) : UNSET;
+      if (sink.pixels[y][x] != want && wrong++ < 3) {
+        printf("  format %x flags %x %dx%d chunk %d: (%d,%d) is %04x, expected %04x\n", format, flags, width, height,
+               (int)maxChunk, x, y, sink.pixels[y][x], want);
+      }
+    }
+  }
+  CHECK(wrong == 0, "format %x flags %x %dx%d: %d wrong pixels", format, flags, width, height, wrong);
+}
+
+int main()
+{
+  MemorySink sink;
+  EpdImageDecoder img(sink, MAX_W, MAX_H);
+  srand(1);
+
+  static const uint8_t formats[] = {EPDI_1BPP, EPDI_2BPP_GRAY, EPDI_4BPP_GRAY, EPDI_3COLOR, EPDI_7COLOR};
+  static const uint8_t flagSets[] = {0, EPDI_LSB_FIRST, EPDI_PACKBITS, EPDI_LSB_FIRST | EPDI_PACKBITS};
+  static const int sizes[][2] = {{13, 7}, {40, 24}, {300, 30}, {8, 1}};
+  static const size_t chunks[] = {1, 2, 17, 100, 4096};
+
+  for (uint8_t format : formats) {
+    for (uint8_t flags : flagSets) {
+      for (auto& size : sizes) {
+        for (size_t chunk : chunks) {
+          testImage(img, sink, format, flags, size[0], size[1], chunk);
+          if (format == EPDI_1BPP || format == EPDI_3COLOR) {
+            // A Sink without drawRowBits() gets the same pixels
+            sink.acceptRowBits = false;
+            testImage(img, sink, format, flags, size[0], size[1], chunk);
+            sink.acceptRowBits = true;
+          }
+        }
+      }
+    }
+  }
+
+  // Only the first 4 bytes tell the format
+  static const uint8_t bm[] = {'B', 'M', 0, 0, 0};
+  CHECK(!EpdImageDecoder::isEpdImage((const uint8_t*)"EPD", 3), "3 bytes detected as EPDI");
+  CHECK(!EpdImageDecoder::isEpdImage(bm, sizeof(bm)), "BMP detected as EPDI");
+
+  // Unknown formats and versions fail and stay failed
+  std::vector<uint8_t> f = makeEpdi(EPDI_1BPP, 0, 16, 4);
+  f[5] = 0x33;
+  img.reset();
+  CHECK(!img.write(f.data(), f.size()) && img.failed(), "unknown format accepted");
+  CHECK(!img.write(f.data(), 4), "write after failure accepted");
+  f = makeEpdi(EPDI_1BPP, 0, 16, 4);
+  f[4] = EPDI_VERSION + 1;
+  img.reset();
+  CHECK(!img.write(f.data(), f.size()), "unknown version accepted");
+
+  // Truncated image is not done
+  f = makeEpdi(EPDI_4BPP_GRAY, EPDI_PACKBITS, 20, 10);
+  img.reset();
+  CHECK(img.write(f.data(), f.size() - 3), "truncated write failed");
+  CHECK(!img.done(), "truncated image done");
+
+  return finish("epdi_test");
+}
@@ -0,0 +1,126 @@
+/**
+ * Framebuffer on the host: every rotation of a RAM wider than the glass (Gdeh0213b73, 128 px RAM and
+ * 122 visible) and of a plain 1 bpp one. Pixels, spans and bands are compared with a signed
+ * reference and the buffers are exactly Fb::size on the heap, so ASan catches any write outside.
+ */
+#include <framebuffer.h>
+#include "hosttest.h"
+
+template <typename Fb, uint16_t VisibleW>
+static void reference(uint8_t *buf, int16_t x, int16_t y, uint16_t color, uint8_t rotation)
+{
+  int32_t rx = x, ry = y;
+  switch (rotation) {
+    case 1: rx = VisibleW - y - 1; ry = x; break;
+    case 2: rx = VisibleW - x - 1; ry = Fb::height - y - 1; break;
+    case 3: rx = y; ry = Fb::height - x - 1; break;
+  }
+  if (rx < 0 || rx >= VisibleW || ry < 0 || ry >= Fb::height) return;
+  Fb::setPixel(buf, rx, ry, color);
+}
+
+template <uint16_t W, uint16_t H, uint16_t VisibleW>
+static void testGeometry(const char *name)
+{
+  typedef Framebuffer<W, H, 1, FB_MSB_FIRST, 0, VisibleW> Fb;
+  uint8_t *buf = (uint8_t*)malloc(Fb::size);
+  uint8_t *ref = (uint8_t*)malloc(Fb::size);
+  srand(1);
+  for (uint8_t rotation = 0; rotation < 4; ++rotation) {
+    // GFX size as Adafruit_GFX reports it: the RAM size, swapped in 1 and 3
+    const int16_t width = (rotation & 1) ? H : W;
+    const int16_t height = (rotation & 1) ? W : H;
+
+    // Every pixel the model bounds check lets through
+    memset(buf, 0xAA, Fb::size);
+    memset(ref, 0xAA, Fb::size);
+    for (int16_t y = 0; y < height; ++y) {
+      for (int16_t x = 0; x < width; ++x) {
+        uint16_t color = ((x ^ y) & 1) ? 0xFFFF : 0;
+        Fb::drawPixel(buf, x, y, color, rotation);
+        reference<Fb, VisibleW>(ref, x, y, color, rotation);
+      }
+    }
+    CHECK(memcmp(buf, ref, Fb::size) == 0, "%s rotation %d drawPixel", name, rotation);
+
+    // fillScreen() through fillRect() and random spans against pixel by pixel
+    for (int i = 0; i < 500; ++i) {
+      int16_t x = 0, y = 0, w = width, h = height;
+      if (i) {
+        x = rand() % width;
+        y = rand() % height;
+        w = 1 + rand() % (width - x);
+        h = 1 + rand() % (height - y);
+      }
+      uint16_t color = (i & 1) ? 0xFFFF : 0;
+      Fb::fillRect(buf, x, y, w, h, color, rotation);
+      for (int16_t yy = y; yy < y + h; ++yy) {
+        for (int16_t xx = x; xx < x + w; ++xx) reference<Fb, VisibleW>(ref, xx, yy, color, rotation);
+      }
+      CHECK(memcmp(buf, ref, Fb::size) == 0, "%s rotation %d fillRect %d,%d %dx%d", name, rotation, x, y, w, h);
+    }
+
+    // Bands rebuild the same buffer
+    const uint16_t rows = 32;
+    uint8_t *band = (uint8_t*)malloc(Fb::rowBytes * rows);
+    for (uint16_t y0 = 0; y0 < H; y0 += rows) {
+      const uint16_t n = (H - y0 < rows) ? H - y0 : rows;
+      memset(band, 0xAA, Fb::rowBytes * rows);
+      Fb::fillRectBand(band, 0, 0, width, height, 0xFFFF, rotation, y0, n);
+      Fb::fillRectBand(band, width / 4, height / 4, width / 2, height / 2, 0, rotation, y0, n);
+      Fb::drawPixelBand(band, width - 1, height - 1, 0, rotation, y0, n);
+      memcpy(&buf[y0 * Fb::rowBytes], band, Fb::rowBytes * n);
+    }
+    free(band);
+    memset(ref, 0xAA, Fb::size);
+    Fb::fillRect(ref, 0, 0, width, height, 0xFFFF, rotation);
+    Fb::fillRect(ref, width / 4, height / 4, width / 2, height / 2, 0, rotation);
+    Fb::drawPixel(ref, width - 1, height - 1, 0, rotation);
+    CHECK(memcmp(buf, ref, Fb::size) == 0, "%s rotation %d bands", name, rotation);
+
+    // updateWindow(): the RAM window is the bounding box of the rotated pixels. The 16 px corners
+    // touch the right and bottom edges, where the old math was one off and wrapped to 65535
+    for (int i = 0; i < 204; ++i) {
+      int16_t x, y, w = 16, h = 16;
+      if (i < 4) {
+        x = (i & 1) ? width - w : 0;
+        y = (i & 2) ? height - h : 0;
+      } else {
+        x = rand() % width;
+        y = rand() % height;
+        w = 1 + rand() % (width - x);
+        h = 1 + rand() % (height - y);
+      }
+      int32_t x0 = W, y0 = H, x1 = -1, y1 = -1;
+      for (int16_t yy = y; yy < y + h; ++yy) {
+        for (int16_t xx = x; xx < x + w; ++xx) {
+          int16_t rx = xx, ry = yy;
+          if (!Fb::rotatePixel(rx, ry, rotation)) continue;
+          if (rx < x0) x0 = rx;
+          if (rx > x1) x1 = rx;
+          if (ry < y0) y0 = ry;
+          if (ry > y1) y1 = ry;
+        }
+      }
+      uint16_t wx = x, wy = y, ww = w, wh = h;
+      Fb::rotateWindow(wx, wy, ww, wh, rotation);
+      if (x1 < 0) {
+        CHECK(wx >= W, "%s rotation %d window %d,%d %dx%d is off the glass but gives x %d", name, rotation, x, y, w, h, wx);
+        continue;
+      }
+      CHECK(wx == x0 && wy == y0 && ww == x1 - x0 + 1 && wh == y1 - y0 + 1,
+            "%s rotation %d window %d,%d %dx%d gives %d,%d %dx%d, expected %d,%d %dx%d", name, rotation, x, y, w, h,
+            wx, wy, ww, wh, (int)x0, (int)y0, (int)(x1 - x0 + 1), (int)(y1 - y0 + 1));
+    }
+  }
+  free(buf);
+  free(ref);
+}
+
+int main()
+{
+  testGeometry<128, 250, 122>("Gdeh0213b73");
+  testGeometry<200, 200, 200>("Gdeh0154d67");
+  testGeometry<800, 480, 800>("Gdew075T7");
+  return finish("framebuffer_test");
+}
@@ -0,0 +1,45 @@
+/**
+ * Shared by the host tests: CHECK() counts the failures that finish() reports and feed() writes a
+ * file to a stream decoder the way a download gives it, in random chunks
+ */
+#ifndef hosttest_h
+#define hosttest_h
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+// Random chunks of 1 to maxChunk bytes to any decoder with write(const uint8_t*, size_t)
+template <typename Decoder>
+static bool feed(Decoder& decoder, const std::vector<uint8_t>& f, size_t maxChunk)
+{
+  size_t pos = 0;
+  while (pos < f.size()) {
+    size_t n = 1 + rand() % maxChunk;
+    if (n > f.size() - pos) n = f.size() - pos;
+    // Copied so ASan sees any read past the chunk
+    uint8_t *chunk = (uint8_t*)malloc(n);
+    memcpy(chunk, &f[pos], n);
+    bool ok = decoder.write(chunk, n);
+    free(chunk);
+    if (!ok) return false;
+    pos += n;
+  }
+  return true;
+}
+
+// Prints the result line, returns the exit code of main()
+static int finish(const char *name)
+{
+  if (failures) {
+    printf("%s: %d FAILED\n", name, failures);
+    return 1;
+  }
+  printf("%s: OK\n", name);
+  return 0;
+}
+#endif
@@ -10,6 +10,7 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "esp_sleep.h"
+#include "esp_attr.h"
 // - - - - HTTP Client includes:
 #include "esp_netif.h"
 #include "esp_err.h"
@@ -39,6 +40,8 @@ Gdew0583z21 display(io);
 /* #include "wave12i48.h" // Only to use with Edp4Spi IO
 Epd4Spi io;
 Wave12I48 display(io); */
+#include <epdbmpsink.h>
+#include <gzipstream.h>
 
 // BMP debug Mode: Turn false for production since it will make things slower and dump Serial debug
 bool bmpDebug = false;
@@ -59,68 +62,73 @@ static const char *TAG = "CALE";
 uint16_t countDataEventCalls = 0;
 uint32_t countDataBytes = 0;
 
-struct BmpHeader
-{
-    uint32_t fileSize;
-    uint32_t imageOffset;
-    uint32_t headerSize;
-    uint32_t width;
-    uint32_t height;
-    uint16_t planes;
-    uint16_t depth;
-    uint32_t format;
-} bmp;
-
-uint16_t read16(uint8_t output_buffer[512], uint8_t startPointer)
+// Decodes the BMP chunks into the display. Black & white bitmaps go straight to the
+// controller RAM in models with direct stream, the rest to the display buffer
+EpdDirectBmpSink bmpSink(display);
+BmpStreamDecoder bmp(bmpSink, display.width(), display.height());
+// 4 and 8 bit bitmaps without red are dithered by their grays instead of cut at a fixed threshold (See dither.h)
+Dither bmpDither(DITHER_FLOYD_STEINBERG, DITHER_BW);
+// EPDI images (See epdimagedecoder.h) are detected by the signature and use the same sink
+EpdImageDecoder epdi(bmpSink, display.width(), display.height());
+bool isEpdi = false;
+uint32_t dataLenTotal = 0;
+uint64_t startTime = 0;
+
+// Conditional download: ETag / Last-Modified of the displayed image and a hash of its bytes survive
+// deep sleep in RTC memory. On 304 Not Modified, or when the same bytes arrive again, there is no refresh.
+// The request is a POST, so a server that follows RFC 7232 answers 412 Precondition Failed instead of 304
+#define HTTP_ETAG_MAX 80
+#define HTTP_DATE_MAX 40
+RTC_DATA_ATTR char lastEtag[HTTP_ETAG_MAX] = "";
+RTC_DATA_ATTR char lastModified[HTTP_DATE_MAX] = "";
+RTC_DATA_ATTR uint32_t lastImageHash = 0;
+char newEtag[HTTP_ETAG_MAX] = "";
+char newModified[HTTP_DATE_MAX] = "";
+// FNV-1a of the image bytes
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+uint32_t imageHash = FNV_OFFSET;
+
+// Plain image bytes, after content decoding
+uint32_t imageBytes = 0;
+// The decoder is chosen by the signature. Inflated output or a small first chunk may split it
+#define IMAGE_MAGIC_SIZE 4
+uint8_t imageMagic[IMAGE_MAGIC_SIZE];
+
+bool imageDecode(const uint8_t *data, size_t len)
 {
-    // BMP data is stored little-endian
-    uint16_t result;
-    ((uint8_t *)&result)[0] = output_buffer[startPointer];     // LSB
-    ((uint8_t *)&result)[1] = output_buffer[startPointer + 1]; // MSB
-    return result;
+    // Chunks are decoded in place, only a row split between two chunks is copied
+    if (isEpdi)
+        return epdi.write(data, len);
+    return bmp.write(data, len);
 }
 
-uint32_t read32(uint8_t output_buffer[512], uint8_t startPointer)
+bool imageWrite(const uint8_t *data, size_t len, void *arg)
 {
-    //Debug - Leave disabled to avoid Serial output
-    //printf("read32: %x %x %x %x\n", output_buffer[startPointer],output_buffer[startPointer+1],output_buffer[startPointer+2],output_buffer[startPointer+3]);
-    uint32_t result;
-    ((uint8_t *)&result)[0] = output_buffer[startPointer]; // LSB
-    ((uint8_t *)&result)[1] = output_buffer[startPointer + 1];
-    ((uint8_t *)&result)[2] = output_buffer[startPointer + 2];
-    ((uint8_t *)&result)[3] = output_buffer[startPointer + 3]; // MSB
-    return result;
+    // Plain bytes: a gzip header may change even if the image did not
+    for (size_t i = 0; i < len; ++i)
+        imageHash = (imageHash ^ data[i]) * FNV_PRIME;
+    if (imageBytes < IMAGE_MAGIC_SIZE)
+    {
+        size_t n = IMAGE_MAGIC_SIZE - imageBytes;
+        if (n > len)
+            n = len;
+        memcpy(&imageMagic[imageBytes], data, n);
+        imageBytes += n;
+        data += n;
+        len -= n;
+        if (imageBytes < IMAGE_MAGIC_SIZE)
+            return true;
+        isEpdi = EpdImageDecoder::isEpdImage(imageMagic, IMAGE_MAGIC_SIZE);
+        if (!imageDecode(imageMagic, IMAGE_MAGIC_SIZE))
+            return false;
+    }
+    imageBytes += len;
+    return len == 0 || imageDecode(data, len);
 }
-
-bool with_color = true; // Candidate for Kconfig
-uint32_t rowSize;
-uint32_t rowByteCounter;
-uint16_t w;
-uint16_t h;
-uint8_t bitmask = 0xFF;
-uint8_t bitshift;
-uint16_t red, green, blue;
-bool whitish, colored;
-uint16_t drawX = 0;
-uint16_t drawY = 0;
-uint16_t bPointer = 34; // Byte pointer - Attention drawPixel has uint16_t
-uint16_t imageBytesRead = 0;
-uint32_t dataLenTotal = 0;
-uint32_t in_bytes = 0;
-uint8_t in_byte = 0; // for depth <= 8
-uint8_t in_bits = 0; // for depth <= 8
-bool isReadingImage = false;
-bool isSupportedBitmap = true;
-bool isPaddingAware = false;
-uint16_t forCount = 0;
-
-static const uint16_t input_buffer_pixels = 640;      // may affect performance
-static const uint16_t max_palette_pixels = 256;       // for depth <= 8
-uint8_t mono_palette_buffer[max_palette_pixels / 8];  // palette buffer for depth <= 8 b/w
-uint8_t color_palette_buffer[max_palette_pixels / 8]; // palette buffer for depth <= 8 c/w
-uint16_t totalDrawPixels = 0;
-int color = EPD_WHITE;
-uint64_t startTime = 0;
+// Mostly white screens compress 10-20x: the server can send gzip or deflate and it is inflated while it arrives
+GzipStream gzip(imageWrite);
+GzipStream::Encoding contentEncoding = GzipStream::GZ_IDENTITY;
 
 void deepsleep(){
     esp_deep_sleep(1000000LL * 60 * CONFIG_DEEPSLEEP_MINUTES_AFTER_RENDER);
@@ -128,8 +136,7 @@ void deepsleep(){
 
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
-    uint8_t output_buffer[HTTP_RECEIVE_BUFFER_SIZE]; // Buffer to store HTTP response
-
+    int status;
     switch (evt->event_id)
     {
     case HTTP_EVENT_ERROR:
@@ -137,228 +144,76 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
         break;
     case HTTP_EVENT_ON_CONNECTED:
         ESP_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
+        contentEncoding = GzipStream::GZ_IDENTITY;
         break;
     case HTTP_EVENT_HEADER_SENT:
         ESP_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
         break;
     case HTTP_EVENT_ON_HEADER:
         ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+        if (strcasecmp(evt->header_key, "ETag") == 0)
+            strlcpy(newEtag, evt->header_value, sizeof(newEtag));
+        if (strcasecmp(evt->header_key, "Last-Modified") == 0)
+            strlcpy(newModified, evt->header_value, sizeof(newModified));
+        if (strcasecmp(evt->header_key, "Content-Encoding") == 0)
+            contentEncoding = GzipStream::encoding(evt->header_value);
         break;
     case HTTP_EVENT_ON_DATA:
+        // Only the body of a 200 answer is an image. Error pages and redirects are not decoded
+        if (esp_http_client_get_status_code(evt->client) != 200)
+            break;
         ++countDataEventCalls;
         if (countDataEventCalls%10==0) {
         ESP_LOGI(TAG, "%d len:%d\n", countDataEventCalls, evt->data_len); }
         dataLenTotal += evt->data_len;
-        // Unless bmp.imageOffset initial skip we start reading stream always on byte pointer 0:
-        bPointer = 0;
-        // Copy the response into the buffer
-        memcpy(output_buffer, evt->data, evt->data_len);
 
         if (countDataEventCalls == 1)
         {
             startTime = esp_timer_get_time();
-            // Read BMP header -In total 34 bytes header
-            bmp.fileSize = read32(output_buffer, 2);
-            bmp.imageOffset = read32(output_buffer, 10);
-            bmp.headerSize = read32(output_buffer, 14);
-            bmp.width = read32(output_buffer, 18);
-            bmp.height = read32(output_buffer, 22);
-            bmp.planes = read16(output_buffer, 26);
-            bmp.depth = read16(output_buffer, 28);
-            bmp.format = read32(output_buffer, 30);
-
-            drawY = bmp.height;
-            ESP_LOGI(TAG, "BMP HEADERS\nfilesize:%d\noffset:%d\nW:%d\nH:%d\nplanes:%d\ndepth:%d\nformat:%d\n",
-                     bmp.fileSize, bmp.imageOffset, bmp.width, bmp.height, bmp.planes, bmp.depth, bmp.format);
-
-            if (bmp.depth == 1)
-            {
-                isPaddingAware = true;
-                ESP_LOGI(TAG, "BMP isPaddingAware:  1 bit depth are 4 bit padded. Wikipedia gave me a lesson.");
-            }
-            if (((bmp.planes == 1) && ((bmp.format == 0) || (bmp.format == 3))) == false)
-            { // uncompressed is handled
-                isSupportedBitmap = false;
-                ESP_LOGE(TAG, "BMP NOT SUPPORTED: Compressed formats not handled.\nBMP NOT SUPPORTED: Only planes==1, format 0 or 3\n");
-            }
-            if (bmp.depth > 8)
-            {
-                isSupportedBitmap = false;
-                ESP_LOGE(TAG, "BMP DEPTH %d: Only 1, 4, and 8 bits depth are supported.\n", bmp.depth);
-            }
-
-            rowSize = ((bmp.width * bmp.depth + 8 - bmp.depth) / 8 + 3) & ~3;
-
-            if (bmpDebug)
-                printf("ROW Size %d\n", rowSize);
-
-            w = bmp.width;
-            h = bmp.height;
-            if ((w - 1) >= display.width())
-                w = display.width();
-            if ((h - 1) >= display.height())
-                h = display.height();
-
-            bitshift = 8 - bmp.depth;
-
-            if (bmp.depth == 1)
-                with_color = false;
-
-            if (bmp.depth <= 8)
-            {
-                if (bmp.depth < 8)
-                    bitmask >>= bmp.depth;
-                // Color-palette location:
-                bPointer = bmp.imageOffset - (4 << bmp.depth);
-                if (bmpDebug)
-                    printf("Palette location: %d\n\n", bPointer);
-
-                for (uint16_t pn = 0; pn < (1 << bmp.depth); pn++)
-                {
-                    blue = output_buffer[bPointer++];
-                    green = output_buffer[bPointer++];
-                    red = output_buffer[bPointer++];
-                    bPointer++;
-
-                    whitish = with_color ? ((red > 0x80) && (green > 0x80) && (blue > 0x80)) : ((red + green + blue) > 3 * 0x80); // whitish
-                    colored = (red > 0xF0) || ((green > 0xF0) && (blue > 0xF0));                                                  // reddish or yellowish?
-                    if (0 == pn % 8) {
-                        mono_palette_buffer[pn / 8] = 0;
-                        color_palette_buffer[pn / 8] = 0;
-                    }
-                        
-                    mono_palette_buffer[pn / 8]  |= whitish << pn % 8;                       
-                    color_palette_buffer[pn / 8] |= colored << pn % 8;
-
-                    // DEBUG Colors - TODO: Double check Palette!!
-                    if (bmpDebug)
-                        printf("0x00%x%x%x : %x, %x\n", red, green, blue, whitish, colored);
-                }
-            }
-            imageBytesRead += evt->data_len;
+            imageHash = FNV_OFFSET;
+            imageBytes = 0;
+            bmp.reset(display.width(), display.height());
+            bmp.debug = bmpDebug;
+            bmp.dither = &bmpDither;
+            epdi.reset(display.width(), display.height());
+            epdi.debug = bmpDebug;
+            if (!gzip.begin(contentEncoding))
+                return ESP_FAIL;
         }
-        if (!isSupportedBitmap)
+        if (!gzip.write((const uint8_t *)evt->data, evt->data_len))
             return ESP_FAIL;
 
         if (bmpDebug)
-        {
-            printf("\n--> bPointer %d\n_inX: %d _inY: %d DATALEN TOTAL:%d bytesRead so far:%d\n",
-                   bPointer, drawX, drawY, dataLenTotal, imageBytesRead);
-            printf("Is reading image: %d\n", isReadingImage);
-        }
+            printf("DATALEN TOTAL:%d image:%d done:%d\n", dataLenTotal, imageBytes, isEpdi ? epdi.done() : bmp.done());
+        break;
 
-        // Didn't arrived to imageOffset YET, it will in next calls of HTTP_EVENT_ON_DATA:
-        if (dataLenTotal < bmp.imageOffset)
-        {
-            imageBytesRead = dataLenTotal;
-            if (bmpDebug)
-                printf("IF read<offset UPDATE bytesRead:%d\n", imageBytesRead);
-            return ESP_OK;
-        }
-        else
+    case HTTP_EVENT_ON_FINISH:
+        countDataEventCalls=0;
+        gzip.end();
+        if (contentEncoding != GzipStream::GZ_IDENTITY)
+            ESP_LOGI(TAG, "%d bytes inflated to %d", dataLenTotal, imageBytes);
+        status = esp_http_client_get_status_code(evt->client);
+        // 412 answers the conditional headers only when they were sent
+        if (status == 304 || (status == 412 && (lastEtag[0] || lastModified[0])) || (status == 200 && lastImageHash != 0 && imageHash == lastImageHash))
         {
-            // Only move pointer once to set right offset
-            if (countDataEventCalls == 1 && bmp.imageOffset < evt->data_len)
-            {
-                bPointer = bmp.imageOffset;
-                isReadingImage = true;
-                printf("Offset comes in first DATA callback. bPointer: %d == bmp.imageOffset\n", bPointer);
-            }
-            if (!isReadingImage)
-            {
-                bPointer = bmp.imageOffset - imageBytesRead;
-                imageBytesRead += bPointer;
-                isReadingImage = true;
-                printf("Start reading image. bPointer: %d\n", bPointer);
-            }
+            ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH\nImage not modified (%d), no refresh. Go to sleep %d minutes\n", status, CONFIG_DEEPSLEEP_MINUTES_AFTER_RENDER);
+            bmpSink.cancel();
+            deepsleep();
+            break;
         }
-        forCount = 0;
-        // LOOP all the received Buffer but start on ImageOffset if first call
-        for (uint32_t byteIndex = bPointer; byteIndex < evt->data_len; ++byteIndex)
+        if (status != 200 || !(isEpdi ? epdi.done() : bmp.done()))
         {
-            in_byte = output_buffer[byteIndex];
-            // Dump only the first calls
-            if (countDataEventCalls < 2 && bmpDebug)
-            {
-                printf("L%d: BrsF:%d %x\n", byteIndex, imageBytesRead, in_byte);
-            }
-            in_bits = 8;
-
-            switch (bmp.depth)
-            {
-            case 1:
-            case 4:
-            case 8:
-            {
-                while (in_bits != 0)
-                {
-
-                    uint16_t pn = (in_byte >> bitshift) & bitmask;
-                    whitish = mono_palette_buffer[pn / 8] & (0x1 << pn % 8);
-                    colored = color_palette_buffer[pn / 8] & (0x1 << pn % 8);
-                    in_byte <<= bmp.depth;
-                    in_bits -= bmp.depth;
-
-                    if (whitish)
-                    {
-                        color = EPD_WHITE;
-                    }
-                    else if (colored && with_color)
-                    {
-                        color = EPD_RED;
-                    }
-                    else
-                    {
-                        color = EPD_BLACK;
-                    }
-
-                    // bmp.width reached? Then go one line up (Is readed from bottom to top)
-                    if (isPaddingAware)
-                    { // 1 bit images are 4-bit padded (Filled usually with 0's)
-                        if (drawX + 1 > rowSize * 8)
-                        {
-                            drawX = 0;
-                            rowByteCounter = 0;
-                            --drawY;
-                        }
-                    }
-                    else
-                    {
-                        // if (drawX + 1 > bmp.width) -> Updated but not tested with 12.48 inch epaper
-                        if (drawX + 1 > rowSize *2)
-                        {
-                            drawX = 0;
-                            rowByteCounter = 0;
-                            --drawY;
-                        }
-                    }
-                    // The ultimate mission: Send the X / Y pixel to the GFX Buffer
-                    display.drawPixel(drawX, drawY, color);
-                    if (drawY == 0) break;
-
-                    totalDrawPixels++;
-                    ++drawX;
-                }
-            }
+            // Error page, or an image that is cut or not supported: the display keeps the last one
+            ESP_LOGE(TAG, "HTTP_EVENT_ON_FINISH\nStatus %d, image not decoded (%d bytes), no refresh. Go to sleep %d minutes\n", status, imageBytes, CONFIG_DEEPSLEEP_MINUTES_AFTER_RENDER);
+            bmpSink.cancel();
+            deepsleep();
             break;
-            }
-
-            rowByteCounter++;
-            imageBytesRead++;
-            forCount++;
         }
-
-        if (bmpDebug)
-            printf("Total drawPixel calls: %d\noutX: %d outY: %d\n", totalDrawPixels, drawX, drawY);
-
-        // Hexa dump:
-        //ESP_LOG_BUFFER_HEX(TAG, output_buffer, evt->data_len);
-        break;
-
-    case HTTP_EVENT_ON_FINISH:
-        countDataEventCalls=0;
+        strlcpy(lastEtag, newEtag, sizeof(lastEtag));
+        strlcpy(lastModified, newModified, sizeof(lastModified));
+        lastImageHash = imageHash;
         ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH\nDownload took: %llu ms\nRefresh and go to sleep %d minutes\n", (esp_timer_get_time()-startTime)/1000, CONFIG_DEEPSLEEP_MINUTES_AFTER_RENDER);
-        display.update();
+        bmpSink.update();
         if (bmpDebug) 
             printf("Free heap after display render: %d\n", xPortGetFreeHeapSize());
         // Go to deepsleep after rendering
@@ -409,6 +264,14 @@ static void http_post(void)
     printf("POST data: %s\n%s\n", post_data, bearerToken);
 
     esp_http_client_set_header(client, "Authorization", bearerToken);
+    // Servers that can render EPDI send it instead of the BMP
+    esp_http_client_set_header(client, "Accept", "image/x-epdi, image/bmp");
+    esp_http_client_set_header(client, "Accept-Encoding", "gzip, deflate");
+    // The server answers 304 (or 412 to a POST) if the image did not change since the one on the display
+    if (lastEtag[0])
+        esp_http_client_set_header(client, "If-None-Match", lastEtag);
+    if (lastModified[0])
+        esp_http_client_set_header(client, "If-Modified-Since", lastModified);
     esp_http_client_set_post_field(client, post_data, strlen(post_data));
     
     esp_err_t err = esp_http_client_perform(client);
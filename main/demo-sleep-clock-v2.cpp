@@ -245,8 +245,10 @@ void updateClock() {
    case 1:
        
        if (supportsPartialUpdate) {
-           printf("HH:MM updateWindow(%d, %d, %d, %d)\n",x,y,w,h);
-        display.updateWindow(x, y, w, h, true);
+        // The last clock survives deep sleep in RTC memory: only the rows that changed are refreshed
+        // (Gdeh0154d67 and Gdew075T7. Other models do a full update)
+        printf("HH:MM updateRetained() inside %d, %d, %d, %d\n",x,y,w,h);
+        display.updateRetained();
        } else {
         display.update(); 
        }
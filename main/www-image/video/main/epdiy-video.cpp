@@ -64,12 +64,6 @@ extern "C"
    void app_main();
 }
 
-EpdRect videoarea = {
-    .x = 0,
-    .y = 0,
-    .width = video_width,
-    .height = video_height
-  };
 
 void app_main(void)
 {
@@ -116,6 +110,10 @@ void app_main(void)
   // Initialize display class
   display.init();         // Add init(true) for debug
   display.clearScreen();
+  // DU leaves ghosting: clean refresh of the video area every 6 frames, 2 partial updates each
+  if (partialMode == MODE_DU) {
+    display.setGhostBudget(12);
+  }
 
   ESP_LOGI(TAG, "Reading video. FRAMESIZE: %d\nFree HEAP %d", FRAME_SIZE, xPortGetFreeHeapSize());
 
@@ -208,10 +206,6 @@ void app_main(void)
     #else
     display.updateWindow(0, 0, video_width, video_height, partialMode);
     vTaskDelay(300 / portTICK_PERIOD_MS);
-    // Again, this could be avoided if using a "clean" update mode like mobile phones have
-    if (frame_nr%6 == 0 && partialMode == MODE_DU) {
-      display.clearArea(videoarea);
-    }
     #endif
 
     
@@ -7,6 +7,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/semphr.h"
 #include "esp_sleep.h"
 // WiFi related
 #include "esp_wifi.h"
@@ -31,6 +33,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h> // round + pow
+#include "jpg-resize.h"
+#include <dither.h>
 
 // - - - - Display configuration - - - - - - - - -
 
@@ -77,7 +81,12 @@ extern "C"
 #define VALIDATE_SSL_CERTIFICATE false
 
 // Jpeg: Adds dithering to image rendering (Makes grayscale smoother on transitions)
-#define JPG_DITHERING true
+// DITHER_FLOYD_STEINBERG (same as true), DITHER_ATKINSON, DITHER_BAYER, DITHER_BLUE_NOISE or DITHER_NONE (false)
+#define JPG_DITHERING DITHER_FLOYD_STEINBERG
+
+// Images bigger than the display are decoded at 1/2, 1/4 or 1/8 and resampled to fit it keeping
+// the aspect ratio. On false they are decoded at full size and clipped
+#define JPG_FIT_TO_DISPLAY true
 
 // Affects the gamma to calculate gray (lower is darker/higher contrast)
 // Nice test values: 0.9 1.2 1.4 higher and is too bright
@@ -98,14 +107,23 @@ JDEC jd;
 JRESULT rc;
 // Buffers
 uint8_t *fb;            // EPD 2bpp buffer
-uint8_t *source_buf;    // JPG download buffer
-uint8_t *decoded_image; // RAW decoded image
 static uint8_t tjpgd_work[4096]; // tjpgd 4Kb buffer
 
+// Download -> decoder pipeline: the HTTP task pushes the chunks into a bounded ring buffer
+// and feed_buffer() blocks on it in the decoder task, so the JPG is decoded while it arrives
+#define JPG_RING_BUFFER_SIZE 16384
+#define JPG_DECODE_TASK_STACK 8192
+StreamBufferHandle_t jpg_ring = NULL;
+SemaphoreHandle_t jpg_decoded = NULL;
+volatile bool download_finished = false;
+volatile bool decode_finished = false;
+
 uint32_t buffer_pos = 0;
 uint32_t time_download = 0;
 uint32_t time_decomp = 0;
 uint32_t time_render = 0;
+uint64_t decode_start = 0;
+uint64_t decode_end = 0;
 static const char * jd_errors[] = {
     "Succeeded",
     "Interrupted by output function",
@@ -175,94 +193,82 @@ uint64_t startTime = 0;
 // Return the minimum of two values a and b
 #define minimum(a,b)     (((a) < (b)) ? (a) : (b))
 
-uint8_t find_closest_palette_color(uint8_t oldpixel)
-{
-  return oldpixel & 0xF0;
-}
+// Single pass render: tjd_output() stores gamma corrected grays of one row of MCUs in stripe.
+// With the last MCU of the row the stripe rows are resized if needed, dithered in raster order
+// (See CalEPD dither.h) and each quantized pixel goes to the display buffer
+#define JPG_MAX_MCU_HEIGHT 16
+uint8_t *stripe = NULL;   // decoded_width * JPG_MAX_MCU_HEIGHT grays
+uint8_t *levels = NULL;   // One dithered row of render_width
+#if JPG_RENDER_16_GRAYS
+  Dither dither(JPG_DITHERING, DITHER_16GRAY);
+#else
+  Dither dither(JPG_DITHERING, DITHER_BW);
+#endif
+uint16_t decoded_width = 0;   // Image size after the decoder scale
+uint16_t decoded_height = 0;
+uint16_t render_width = 0;    // Image size on the display
+uint16_t render_height = 0;
+uint8_t jpg_scale = 0;
+JpgResize resize;
+int padding_x = 0;
+int padding_y = 0;
+uint64_t render_us = 0;
 
 //====================================================================================
-//   Decode and paint onto the Epaper screen
+//   Dither a row of the image and paint it onto the Epaper buffer
 //====================================================================================
-void jpegRender(int xpos, int ypos, int width, int height) {
- #if JPG_DITHERING
- unsigned long pixel=0;
- for (uint16_t by=0; by<ep_height;by++)
-  {
-    for (uint16_t bx=0; bx<ep_width;bx++)
-    {
-        int oldpixel = decoded_image[pixel];
-        int newpixel = find_closest_palette_color(oldpixel);
-        int quant_error = oldpixel - newpixel;
-        decoded_image[pixel]=newpixel;
-        if (bx<(ep_width-1))
-          decoded_image[pixel+1] = minimum(255,decoded_image[pixel+1] + quant_error * 7 / 16);
-
-        if (by<(ep_height-1))
-        {
-          if (bx>0)
-            decoded_image[pixel+ep_width-1] =  minimum(255,decoded_image[pixel+ep_width-1] + quant_error * 3 / 16);
-
-          decoded_image[pixel+ep_width] =  minimum(255,decoded_image[pixel+ep_width] + quant_error * 5 / 16);
-          if (bx<(ep_width-1))
-            decoded_image[pixel+ep_width+1] = minimum(255,decoded_image[pixel+ep_width+1] + quant_error * 1 / 16);
-        }
-        pixel++;
-    }
+void jpegRenderRow(const uint8_t *line, uint16_t y) {
+  dither.grayRow(line, levels);
+  for (uint32_t bx=0; bx<render_width; bx++) {
+    #if JPG_RENDER_16_GRAYS
+      uint8_t color = dither.gray(levels[bx]);
+    #else
+      uint16_t color = levels[bx] ? EPD_WHITE : EPD_BLACK;
+    #endif
+      display.drawPixel(bx + padding_x, y + padding_y, color);
   }
-  #endif
+}
 
-  // Write to display
+// Sends the rows of a complete stripe, through the resampler when the image is scaled to fit
+void jpegRenderStripe(uint32_t top, uint32_t rows) {
   uint64_t drawTime = esp_timer_get_time();
-  uint32_t padding_x = 0;
-  uint32_t padding_y = 0;
-  if (display.getRotation() == 0 || display.getRotation() == 2) {
-    padding_x = (ep_width - width) / 2;
-    padding_y = (ep_height - height) / 2;
-  } else {
-    padding_x = (ep_height - width) / 2;
-    padding_y = (ep_width - height) / 2;
-  }
 
-  for (uint32_t by=0; by<height;by++) {
-    for (uint32_t bx=0; bx<width;bx++) {
-      #if JPG_RENDER_16_GRAYS
-        uint8_t color = decoded_image[by * width + bx];
-      #else 
-        
-        uint8_t color = (decoded_image[by * width + bx]>JPG_WHITE_THRESHOLD) ? EPD_WHITE : EPD_BLACK;
-      #endif
-
-        //printf("x:%d y:%d c:%d ", bx + padding_x, by + padding_y, color);
-        display.drawPixel(bx + padding_x, by + padding_y, color);
+  for (uint32_t by=0; by<rows; by++) {
+    if (render_width != decoded_width || render_height != decoded_height) {
+      resize.pushRow(&stripe[by * decoded_width], top + by, jpegRenderRow);
+    } else {
+      jpegRenderRow(&stripe[by * decoded_width], top + by);
     }
   }
-  // calculate how long it took to draw the image
-  time_render = (esp_timer_get_time() - drawTime)/1000;
-  ESP_LOGI("render", "%d ms - jpeg draw", time_render);
+  render_us += esp_timer_get_time() - drawTime;
 }
 
 void deepsleep(){
     esp_deep_sleep(1000000LL * 60 * CONFIG_DEEPSLEEP_MINUTES_AFTER_RENDER);
 }
 
+// Reads nd bytes from the ring buffer waiting for the download. Returns less only at the end of it
 static uint32_t feed_buffer(JDEC *jd,      
                uint8_t *buff, // Pointer to the read buffer (NULL:skip) 
                uint32_t nd 
 ) {
+    uint8_t skip[64];
     uint32_t count = 0;
 
     while (count < nd) {
-      if (buff != NULL) {
-            *buff++ = source_buf[buffer_pos];
-        }
-        count ++;
-        buffer_pos++;
-    }
+      uint32_t want = nd - count;
+      uint8_t *dst = (buff != NULL) ? buff + count : skip;
+      if (buff == NULL && want > sizeof(skip)) want = sizeof(skip);
 
+      size_t received = xStreamBufferReceive(jpg_ring, dst, want, pdMS_TO_TICKS(50));
+      if (received == 0 && download_finished && xStreamBufferIsEmpty(jpg_ring)) break;
+      count += received;
+    }
+    buffer_pos += count;
   return count;
 }
 
-/* User defined call-back function to output decoded RGB bitmap in decoded_image buffer */
+/* User defined call-back function: converts the MCU to gray in the stripe and renders the stripe when it is complete */
 static uint32_t
 tjd_output(JDEC *jd,     /* Decompressor object of current session */
            void *bitmap, /* Bitmap data to be output */
@@ -272,7 +278,7 @@ tjd_output(JDEC *jd,     /* Decompressor object of current session */
 
   uint32_t w = rect->right - rect->left + 1;
   uint32_t h = rect->bottom - rect->top + 1;
-  uint32_t image_width = jd->width;
+  uint32_t image_width = decoded_width;
   uint8_t *bitmap_ptr = (uint8_t*)bitmap;
   
   for (uint32_t i = 0; i < w * h; i++) {
@@ -289,48 +295,94 @@ tjd_output(JDEC *jd,     /* Decompressor object of current session */
     if (xx < 0 || xx >= image_width) {
       continue;
     }
-    int yy = rect->top + i / w;
-    if (yy < 0 || yy >= jd->height) {
+    int yy = i / w;
+    if (yy >= JPG_MAX_MCU_HEIGHT || rect->top + yy >= decoded_height) {
       continue;
     }
     
-    decoded_image[yy * image_width + xx] = gamme_curve[val];
+    stripe[yy * image_width + xx] = gamme_curve[val];
   }
 
+  // Last MCU of the row: the stripe is complete
+  if (rect->right >= image_width - 1 && rect->top < decoded_height) {
+    jpegRenderStripe(rect->top, minimum(h, decoded_height - rect->top));
+  }
   return 1;
 }
 
 //====================================================================================
-//   This function opens source_buf Jpeg image file and primes the decoder
+//   This function reads the Jpeg image from the ring buffer and primes the decoder
 //====================================================================================
-int drawBufJpeg(uint8_t *source_buf, int xpos, int ypos) {
-  rc = jd_prepare(&jd, feed_buffer, tjpgd_work, sizeof(tjpgd_work), &source_buf);
+int drawBufJpeg(int xpos, int ypos) {
+  decode_start = esp_timer_get_time();
+  rc = jd_prepare(&jd, feed_buffer, tjpgd_work, sizeof(tjpgd_work), NULL);
   if (rc != JDR_OK) {    
     ESP_LOGE(TAG, "JPG jd_prepare error: %s", jd_errors[rc]);
     return ESP_FAIL;
   }
 
-  uint32_t decode_start = esp_timer_get_time();
-
-  // Last parameter scales        v 1 will reduce the image
-  rc = jd_decomp(&jd, tjd_output, 0);
+  #if JPG_FIT_TO_DISPLAY
+    // Biggest IDCT scale that still decodes at or above the fitted size
+    jpg_scale = jpgFit(jd.width, jd.height, display.width(), display.height(), render_width, render_height);
+  #else
+    jpg_scale = 0;
+    render_width = jd.width;
+    render_height = jd.height;
+  #endif
+  decoded_width = jd.width >> jpg_scale;
+  decoded_height = jd.height >> jpg_scale;
+
+  // Only one row of MCUs and the dither error rows are kept
+  stripe = (uint8_t *)heap_caps_malloc(decoded_width * JPG_MAX_MCU_HEIGHT, MALLOC_CAP_8BIT);
+  levels = (uint8_t *)heap_caps_malloc(render_width, MALLOC_CAP_8BIT);
+  dither.threshold = JPG_WHITE_THRESHOLD;
+  bool resized = (render_width != decoded_width || render_height != decoded_height);
+  if (stripe == NULL || levels == NULL || !dither.begin(render_width) ||
+      (resized && !resize.begin(decoded_width, decoded_height, render_width, render_height))) {
+    ESP_LOGE(TAG, "JPG could not allocate the %d px wide stripe", decoded_width);
+    free(stripe);
+    free(levels);
+    dither.end();
+    return ESP_FAIL;
+  }
+  // Center the image
+  padding_x = ((int)display.width() - (int)render_width) / 2;
+  padding_y = ((int)display.height() - (int)render_height) / 2;
+  render_us = 0;
+
+  // Last parameter scales: 1/2^jpg_scale
+  rc = jd_decomp(&jd, tjd_output, jpg_scale);
+  free(stripe);
+  free(levels);
+  dither.end();
+  resize.end();
+  stripe = NULL;
+  levels = NULL;
   if (rc != JDR_OK) {
     ESP_LOGE(TAG, "JPG jd_decomp error: %s", jd_errors[rc]);
     return ESP_FAIL;
   }
 
-  time_decomp = (esp_timer_get_time() - decode_start)/1000;
+  decode_end = esp_timer_get_time();
+  time_render = render_us/1000;
+  time_decomp = (decode_end - decode_start)/1000 - time_render;
 
-  ESP_LOGI("JPG", "width: %d height: %d\n", jd.width, jd.height);
+  ESP_LOGI("JPG", "width: %d height: %d decoded at 1/%d rendered: %dx%d\n", jd.width, jd.height, 1 << jpg_scale, render_width, render_height);
   ESP_LOGI("decode", "%d ms . image decompression", time_decomp);
-
-  // Render the image onto the screen at given coordinates
-  jpegRender(xpos, ypos, jd.width, jd.height);
+  ESP_LOGI("render", "%d ms - jpeg dither and draw", time_render);
 
   return 1;
 }
 
-// Handles Htpp events and is in charge of buffering source_buf (jpg compressed image)
+// Consumer: decodes and renders while the HTTP task is still downloading
+static void jpgDecodeTask(void *arg) {
+  drawBufJpeg(0, 0);
+  decode_finished = true;
+  xSemaphoreGive(jpg_decoded);
+  vTaskDelete(NULL);
+}
+
+// Handles Htpp events and is in charge of pushing the jpg compressed image to the decoder
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
     switch (evt->event_id)
@@ -358,26 +410,47 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
         #endif
         dataLenTotal += evt->data_len;
 
-        if (countDataEventCalls == 1) startTime = esp_timer_get_time();
-        // Append received data into source_buf
-        memcpy(&source_buf[img_buf_pos], evt->data, evt->data_len);
-        img_buf_pos += evt->data_len;
+        // A redirect body is not the image
+        if (esp_http_client_get_status_code(evt->client) != 200) break;
 
-        // Optional hexa dump
-        //ESP_LOG_BUFFER_HEX(TAG, source_buf, 100);
+        if (jpg_ring == NULL) {
+          startTime = esp_timer_get_time();
+          jpg_ring = xStreamBufferCreate(JPG_RING_BUFFER_SIZE, 1);
+          jpg_decoded = xSemaphoreCreateBinary();
+          if (jpg_ring == NULL || jpg_decoded == NULL) {
+            ESP_LOGE(TAG, "Could not allocate the %d bytes ring buffer", JPG_RING_BUFFER_SIZE);
+            return ESP_FAIL;
+          }
+          xTaskCreate(jpgDecodeTask, "jpgDecode", JPG_DECODE_TASK_STACK, NULL, 5, NULL);
+        }
+        // Blocks while the ring is full. Once the decoder stopped the rest is dropped
+        {
+          size_t sent = 0;
+          while (sent < evt->data_len && !decode_finished) {
+            sent += xStreamBufferSend(jpg_ring, (uint8_t*)evt->data + sent, evt->data_len - sent, pdMS_TO_TICKS(50));
+          }
+        }
+        img_buf_pos += evt->data_len;
         break;
 
     case HTTP_EVENT_ON_FINISH:
         // Do not draw if it's a redirect (302)
-        if (esp_http_client_get_status_code(evt->client) == 200) {
-          printf("%d bytes read from %s\nIMG_BUF size: %d\n", img_buf_pos, IMG_URL, img_buf_pos);
-          drawBufJpeg(source_buf, 0, 0);
-          time_download = (esp_timer_get_time()-startTime)/1000;
+        if (esp_http_client_get_status_code(evt->client) == 200 && jpg_ring != NULL) {
+          uint64_t download_end = esp_timer_get_time();
+          download_finished = true;
+          printf("%d bytes read from %s\n", img_buf_pos, IMG_URL);
+          time_download = (download_end-startTime)/1000;
           ESP_LOGI("www-dw", "%d ms - download", time_download);
+          // Decoder task ends decoding the last bytes and renders
+          xSemaphoreTake(jpg_decoded, portMAX_DELAY);
+          if (decode_end > decode_start) {
+            uint64_t overlap_end = (download_end < decode_end) ? download_end : decode_end;
+            ESP_LOGI("overlap", "%d ms - decoding while downloading", (uint32_t)((overlap_end - decode_start)/1000));
+          }
           // Refresh display
           display.update();
 
-          ESP_LOGI("total", "%d ms - total time spent\n", time_download+time_decomp+time_render);
+          ESP_LOGI("total", "%d ms - total time spent\n", (uint32_t)((esp_timer_get_time()-startTime)/1000));
         } else {
           printf("HTTP on finish got status code: %d\n", esp_http_client_get_status_code(evt->client));
         }
@@ -545,21 +618,6 @@ void app_main() {
   ep_width = display.width();
   ep_height = display.height();
 
-  //printf("Free heap before buffers allocation: %d\n", xPortGetFreeHeapSize());
-  // MALLOC_CAP_SPIRAM as last param if you have external RAM.
-  // Using external RAM for big buffers is a must or it will stop here:
-  decoded_image = (uint8_t *)heap_caps_malloc(ep_width * ep_height, MALLOC_CAP_SPIRAM);
-  if (decoded_image == NULL) {
-      ESP_LOGE("main", "Initial alloc back_buf failed. Allocating %d * %d", ep_width, ep_height);
-  }
-  memset(decoded_image, 255, ep_width * ep_height);
-
-  // Should be big enough to allocate the JPEG file size, width * height should suffice
-  source_buf = (uint8_t *)heap_caps_malloc(ep_width * ep_height, MALLOC_CAP_SPIRAM);
-  if (source_buf == NULL) {
-      ESP_LOGE("main", "Initial alloc source_buf failed!");
-  }
-  printf("Free heap after buffers allocation: %d\n", xPortGetFreeHeapSize());
 
   display.init();
   display.setRotation(CONFIG_DISPLAY_ROTATION);
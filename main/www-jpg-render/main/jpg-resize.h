@@ -0,0 +1,119 @@
+// Fit-to-display downscaling shared by the JPEG render examples
+//
+// jpgFit() returns the size that fits the image in the display keeping the aspect ratio
+// and the biggest decoder scale 1/2^n whose output is still at or above that size,
+// so the IDCT does most of the reduction and the resampler only the last step.
+// JpgResize averages the decoded gray rows into the fitted size with a box filter:
+// each decoded pixel is added to the output pixel it falls in using 16.16 fixed point steps.
+// Rows are pushed in order and every finished output row is handed to a callback.
+#ifndef jpg_resize_h
+#define jpg_resize_h
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// maxScale: 3 for tjpgd and JPEGDEC (1/8)
+static inline uint8_t jpgFit(uint16_t imgW, uint16_t imgH, uint16_t dispW, uint16_t dispH,
+                             uint16_t &outW, uint16_t &outH, uint8_t maxScale = 3)
+{
+  outW = imgW;
+  outH = imgH;
+  // Never upscale
+  if (imgW > dispW || imgH > dispH) {
+    if ((uint32_t)imgW * dispH > (uint32_t)imgH * dispW) {
+      outW = dispW;
+      outH = (uint32_t)imgH * dispW / imgW;
+    } else {
+      outH = dispH;
+      outW = (uint32_t)imgW * dispH / imgH;
+    }
+    if (outW == 0) outW = 1;
+    if (outH == 0) outH = 1;
+  }
+  uint8_t scale = maxScale;
+  while (scale > 0 && ((imgW >> scale) < outW || (imgH >> scale) < outH)) scale--;
+  return scale;
+}
+
+class JpgResize
+{
+  public:
+    typedef void (*RowCallback)(const uint8_t *line, uint16_t y);
+
+    ~JpgResize() { end(); }
+
+    // inW x inH decoded rows to outW x outH (outW <= inW, outH <= inH)
+    bool begin(uint16_t inW, uint16_t inH, uint16_t outW, uint16_t outH)
+    {
+      end();
+      _inW = inW;
+      _inH = inH;
+      _outW = outW;
+      _outH = outH;
+      // Rounded up steps never skip an output pixel and the last input lands in the last one
+      _stepY = (((uint32_t)outH << 16) + inH - 1) / inH;
+      _xmap = (uint16_t*)malloc(inW * sizeof(uint16_t));
+      _cols = (uint16_t*)calloc(outW, sizeof(uint16_t));
+      _sum = (uint32_t*)calloc(outW, sizeof(uint32_t));
+      _out = (uint8_t*)malloc(outW);
+      if (!_xmap || !_cols || !_sum || !_out) {
+        end();
+        return false;
+      }
+      uint32_t stepX = (((uint32_t)outW << 16) + inW - 1) / inW;
+      for (uint16_t ix = 0; ix < inW; ix++) {
+        uint16_t ox = ((uint32_t)ix * stepX) >> 16;
+        if (ox >= outW) ox = outW - 1;
+        _xmap[ix] = ox;
+        _cols[ox]++;
+      }
+      _rows = 0;
+      return true;
+    }
+
+    void end()
+    {
+      free(_xmap);
+      free(_cols);
+      free(_sum);
+      free(_out);
+      _xmap = NULL;
+      _cols = NULL;
+      _sum = NULL;
+      _out = NULL;
+    }
+
+    // Adds the decoded row iy. Calls row() when the output row it belongs to is complete
+    void pushRow(const uint8_t *line, uint16_t iy, RowCallback row)
+    {
+      for (uint16_t ix = 0; ix < _inW; ix++) _sum[_xmap[ix]] += line[ix];
+      _rows++;
+      uint16_t oy = _outY(iy);
+      if (iy + 1 < _inH && _outY(iy + 1) == oy) return;
+
+      for (uint16_t ox = 0; ox < _outW; ox++) {
+        _out[ox] = _sum[ox] / ((uint32_t)_cols[ox] * _rows);
+      }
+      memset(_sum, 0, _outW * sizeof(uint32_t));
+      _rows = 0;
+      row(_out, oy);
+    }
+
+  private:
+    uint16_t _inW = 0;
+    uint16_t _inH = 0;
+    uint16_t _outW = 0;
+    uint16_t _outH = 0;
+    uint32_t _stepY = 0;
+    uint16_t *_xmap = NULL;  // Output column of every input column
+    uint16_t *_cols = NULL;  // Input columns in every output column
+    uint32_t *_sum = NULL;
+    uint8_t *_out = NULL;
+    uint16_t _rows = 0;      // Input rows in the current output row
+
+    uint16_t _outY(uint16_t iy) {
+      uint16_t oy = ((uint32_t)iy * _stepY) >> 16;
+      return (oy < _outH) ? oy : _outH - 1;
+    }
+};
+#endif
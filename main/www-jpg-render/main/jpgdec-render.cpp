@@ -29,6 +29,8 @@
 #include <math.h> // round + pow
 // JPG decoder from @bitbank2
 #include "JPEGDEC.h"
+#include "jpg-resize.h"
+#include <dither.h>
 
 
 JPEGDEC jpeg;
@@ -36,9 +38,28 @@ JPEGDEC jpeg;
 // On true it looses rotation. Experimental, does not work alright yet. Hint:
 // Check if an uint16_t buffer can be copied in a uint8_t buffer directly
 #define JPEG_CPY_FRAMEBUFFER false
-
-// Dither space allocation
-uint8_t * dither_space;
+// Images bigger than the display are decoded at 1/2, 1/4 or 1/8 and resampled to fit it keeping
+// the aspect ratio. On false they are decoded at full size and clipped
+#define JPG_FIT_TO_DISPLAY true
+// Before the full decode a 1/8 scale version (DC coefficients only) is drawn upscaled in black & white
+// and refreshed with a fast waveform, so something shows up while the quality update is prepared
+#define JPG_PROGRESSIVE_PREVIEW true
+#define JPG_PREVIEW_MODE MODE_DU
+
+// Dither space allocation: allocated per image since it needs 16 lines of the decoded width
+uint8_t * dither_space = NULL;
+
+// Fit to display: decoded MCU rows are kept in stripe and resized when a row is complete
+#define JPG_MAX_MCU_HEIGHT 16
+uint8_t * stripe = NULL;
+uint16_t decoded_width = 0;
+uint16_t decoded_height = 0;
+uint16_t render_width = 0;
+uint16_t render_height = 0;
+bool jpg_resized = false;
+JpgResize resize;
+int padding_x = 0;
+int padding_y = 0;
 
 // Affects the gamma to calculate gray (lower is darker/higher contrast)
 // Nice test values: 0.9 1.2 1.4 higher and is too bright
@@ -91,6 +112,7 @@ uint32_t buffer_pos = 0;
 uint32_t time_download = 0;
 uint32_t time_decomp = 0;
 uint32_t time_render = 0;
+uint32_t time_preview = 0;
 uint16_t ep_width = 0;
 uint16_t ep_height = 0;
 
@@ -144,6 +166,33 @@ uint64_t startTime = 0;
 // Refactored by @martinberlin for EPDiy as a Jpeg download and render example
 //====================================================================================
 
+void jpegResizedRow(const uint8_t *line, uint16_t y)
+{
+  for (uint16_t x = 0; x < render_width; x++) {
+    display.drawPixel(x + padding_x, y + padding_y, line[x]);
+  }
+}
+
+// Expands the dithered 4 bit pixels to gamma corrected grays and resizes them once the row is complete
+void JPEGDrawResize(JPEGDRAW *pDraw)
+{
+  // JPEGDither() packs 2 pixels per byte, first one in the high nibble. Lines are (iWidth+1)/2 bytes
+  const uint8_t *pixels = (const uint8_t *)pDraw->pPixels;
+  const int16_t pitch = (pDraw->iWidth + 1) / 2;
+  for (int16_t yy = 0; yy < pDraw->iHeight && yy < JPG_MAX_MCU_HEIGHT; yy++) {
+    for (int16_t xx = 0; xx < pDraw->iWidth && pDraw->x + xx < decoded_width; xx++) {
+      uint8_t col = pixels[yy * pitch + xx / 2];
+      col = (xx & 1) ? col & 0xf : col >> 4;
+      stripe[yy * decoded_width + pDraw->x + xx] = gamme_curve[col *16];
+    }
+  }
+  // Last MCUs of the row
+  if (pDraw->x + pDraw->iWidth < decoded_width) return;
+  for (int16_t yy = 0; yy < pDraw->iHeight && yy < JPG_MAX_MCU_HEIGHT && pDraw->y + yy < decoded_height; yy++) {
+    resize.pushRow(&stripe[yy * decoded_width], pDraw->y + yy, jpegResizedRow);
+  }
+}
+
 /*
  * Used with jpeg.setPixelType(FOUR_BIT_DITHERED)
  */
@@ -152,15 +201,23 @@ int JPEGDraw4Bits(JPEGDRAW *pDraw)
 {
   uint32_t render_start = esp_timer_get_time();
 
+  if (jpg_resized) {
+    JPEGDrawResize(pDraw);
+  } else {
   #if JPEG_CPY_FRAMEBUFFER
   // Highly experimental: Does not support rotation and gamma correction (Can be washed out compared to JPEG_CPY_FRAMEBUFFER false)
+  // Centered like the preview when the image is smaller. Even x: 2 pixels per framebuffer byte
+  const int16_t cpy_x = pDraw->x + (padding_x > 0 ? padding_x & ~1 : 0);
+  const int16_t cpy_y = pDraw->y + (padding_y > 0 ? padding_y : 0);
   for (uint16_t yy = 0; yy < pDraw->iHeight; yy++) {
     // Copy directly horizontal MCU pixels in EPD fb
-    display.cpyFramebuffer(pDraw->x, pDraw->y+yy, &pDraw->pPixels[(yy * pDraw->iWidth)>>2], pDraw->iWidth);
+    display.cpyFramebuffer(cpy_x, cpy_y + yy, &pDraw->pPixels[(yy * pDraw->iWidth)>>2], pDraw->iWidth);
   }
 
   #else 
-    // Rotation aware
+    // Rotation aware. Centered with the same padding as the preview, so it covers it
+    const int16_t x0 = pDraw->x + padding_x;
+    const int16_t y0 = pDraw->y + padding_y;
     for (int16_t xx = 0; xx < pDraw->iWidth; xx+=4) {
       for (int16_t yy = 0; yy < pDraw->iHeight; yy++) {
         uint16_t col = pDraw->pPixels[ (xx + (yy * pDraw->iWidth)) >>2 ];
@@ -169,10 +226,10 @@ int JPEGDraw4Bits(JPEGDRAW *pDraw)
         uint8_t col2 = (col >> 4) & 0xf;
         uint8_t col3 = (col >> 8) & 0xf;
         uint8_t col4 = (col >> 12) & 0xf;
-        display.drawPixel(pDraw->x + xx, pDraw->y + yy, gamme_curve[col1 *16]);
-        display.drawPixel(pDraw->x + xx + 1, pDraw->y + yy, gamme_curve[col2 *16]);
-        display.drawPixel(pDraw->x + xx + 2, pDraw->y + yy, gamme_curve[col3 *16]);
-        display.drawPixel(pDraw->x + xx + 3, pDraw->y + yy, gamme_curve[col4 *16]);
+        display.drawPixel(x0 + xx, y0 + yy, gamme_curve[col1 *16]);
+        display.drawPixel(x0 + xx + 1, y0 + yy, gamme_curve[col2 *16]);
+        display.drawPixel(x0 + xx + 2, y0 + yy, gamme_curve[col3 *16]);
+        display.drawPixel(x0 + xx + 3, y0 + yy, gamme_curve[col4 *16]);
 
         /* if (yy==0 && mcu_count==0) {
           printf("1.%d %d %d %d ",col1,col2,col3,col4);
@@ -180,6 +237,7 @@ int JPEGDraw4Bits(JPEGDRAW *pDraw)
       }
     }
   #endif
+  }
 
   mcu_count++;
   time_render += (esp_timer_get_time() - render_start) / 1000;
@@ -190,6 +248,71 @@ void deepsleep(){
     esp_deep_sleep(1000000LL * 60 * CONFIG_DEEPSLEEP_MINUTES_AFTER_RENDER);
 }
 
+//====================================================================================
+//   Progressive preview: 1/8 scale grayscale decode drawn upscaled in the render area
+//====================================================================================
+uint16_t preview_width = 0;
+uint16_t preview_height = 0;
+// Ordered dither needs no error buffers and the blocks arrive out of raster order. MODE_DU only shows black and white
+Dither preview_dither(DITHER_BLUE_NOISE, DITHER_BW);
+
+int JPEGDrawPreview(JPEGDRAW *pDraw)
+{
+  const uint8_t *pixels = (const uint8_t *)pDraw->pPixels;
+  for (int16_t yy = 0; yy < pDraw->iHeight && pDraw->y + yy < preview_height; yy++) {
+    int py = pDraw->y + yy;
+    int y0 = (uint32_t)py * render_height / preview_height;
+    int y1 = (uint32_t)(py + 1) * render_height / preview_height;
+    for (int16_t xx = 0; xx < pDraw->iWidth && pDraw->x + xx < preview_width; xx++) {
+      int px = pDraw->x + xx;
+      int x0 = (uint32_t)px * render_width / preview_width;
+      int x1 = (uint32_t)(px + 1) * render_width / preview_width;
+      uint8_t gray = gamme_curve[pixels[yy * pDraw->iWidth + xx]];
+      for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+          display.drawPixel(x + padding_x, y + padding_y, preview_dither.pixel(gray, x, y) ? 255 : 0);
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+void previewJpeg(uint8_t *source_buf) {
+  uint32_t preview_start = esp_timer_get_time();
+
+  if (!jpeg.openRAM(source_buf, img_buf_pos, JPEGDrawPreview)) {
+    ESP_LOGE("jpeg.openRAM", "Failed with error: %d", jpeg.getLastError());
+    return;
+  }
+  #if JPG_FIT_TO_DISPLAY
+    jpgFit(jpeg.getWidth(), jpeg.getHeight(), display.width(), display.height(), render_width, render_height);
+  #else
+    render_width = jpeg.getWidth();
+    render_height = jpeg.getHeight();
+  #endif
+  padding_x = ((int)display.width() - (int)render_width) / 2;
+  padding_y = ((int)display.height() - (int)render_height) / 2;
+  preview_width = jpeg.getWidth() >> 3;
+  preview_height = jpeg.getHeight() >> 3;
+
+  if (preview_width == 0 || preview_height == 0) {
+    jpeg.close();
+    return;
+  }
+  jpeg.setPixelType(EIGHT_BIT_GRAYSCALE);
+  if (jpeg.decode(0, 0, JPEG_SCALE_EIGHTH)) {
+    display.update(JPG_PREVIEW_MODE);
+    time_preview = (esp_timer_get_time() - preview_start) / 1000;
+    ESP_LOGI("preview", "%d ms - %dx%d preview decoded and refreshed", time_preview, preview_width, preview_height);
+    // Only in the framebuffer: no preview pixel is left where the full decode does not draw
+    display.fillRect(padding_x, padding_y, render_width, render_height, 255);
+  } else {
+    ESP_LOGE("jpeg.decode", "Preview failed with error: %d", jpeg.getLastError());
+  }
+  jpeg.close();
+}
+
 //====================================================================================
 //   This function opens source_buf Jpeg image file and primes the decoder
 //====================================================================================
@@ -199,14 +322,43 @@ int decodeJpeg(uint8_t *source_buf, int xpos, int ypos) {
   if (jpeg.openRAM(source_buf, img_buf_pos, JPEGDraw4Bits)) {
 
     jpeg.setPixelType(FOUR_BIT_DITHERED);
-    
-    if (jpeg.decodeDither(dither_space, 0))
+
+    uint8_t scale = 0;
+    #if JPG_FIT_TO_DISPLAY
+      scale = jpgFit(jpeg.getWidth(), jpeg.getHeight(), display.width(), display.height(), render_width, render_height);
+    #else
+      render_width = jpeg.getWidth();
+      render_height = jpeg.getHeight();
+    #endif
+    decoded_width = jpeg.getWidth() >> scale;
+    decoded_height = jpeg.getHeight() >> scale;
+    jpg_resized = (render_width != decoded_width || render_height != decoded_height);
+    padding_x = ((int)display.width() - (int)render_width) / 2;
+    padding_y = ((int)display.height() - (int)render_height) / 2;
+    ESP_LOGI("decode", "%dx%d decoded at 1/%d rendered: %dx%d", jpeg.getWidth(), jpeg.getHeight(), 1 << scale, render_width, render_height);
+
+    dither_space = (uint8_t *)heap_caps_malloc((decoded_width + 16) * 16, MALLOC_CAP_SPIRAM);
+    if (jpg_resized) {
+      stripe = (uint8_t *)heap_caps_malloc(decoded_width * JPG_MAX_MCU_HEIGHT, MALLOC_CAP_8BIT);
+    }
+    if (dither_space == NULL || (jpg_resized && (stripe == NULL ||
+        !resize.begin(decoded_width, decoded_height, render_width, render_height)))) {
+      ESP_LOGE("decode", "Could not allocate the buffers for a %d px wide image", decoded_width);
+    }
+    // JPEG_SCALE_HALF, JPEG_SCALE_QUARTER and JPEG_SCALE_EIGHTH are 1 << scale
+    else if (jpeg.decodeDither(dither_space, scale ? (1 << scale) : 0))
       {
         time_decomp = (esp_timer_get_time() - decode_start)/1000 - time_render;
         ESP_LOGI("decode", "%d ms - %dx%d image MCUs:%d", time_decomp, jpeg.getWidth(), jpeg.getHeight(), mcu_count);
       } else {
         ESP_LOGE("jpeg.decode", "Failed with error: %d", jpeg.getLastError());
       }
+    free(dither_space);
+    free(stripe);
+    dither_space = NULL;
+    stripe = NULL;
+    resize.end();
+    jpg_resized = false;
 
   } else {
     ESP_LOGE("jpeg.openRAM", "Failed with error: %d", jpeg.getLastError());
@@ -259,6 +411,10 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
           printf("%d bytes read from %s\n", img_buf_pos, IMG_URL);
           time_download = (esp_timer_get_time()-startTime)/1000;
 
+          #if JPG_PROGRESSIVE_PREVIEW
+            previewJpeg(source_buf);
+            ESP_LOGI("preview", "%d ms - first paint after download start", time_download + time_preview);
+          #endif
           decodeJpeg(source_buf, 0, 0);
           
           ESP_LOGI("www-dw", "%d ms - download", time_download);
@@ -266,7 +422,7 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
           // Refresh display
           display.update();
 
-          ESP_LOGI("total", "%d ms - total time spent\n", time_download+time_decomp+time_render);
+          ESP_LOGI("total", "%d ms - total time spent\n", time_download+time_preview+time_decomp+time_render);
         } else {
           printf("HTTP on finish got status code: %d\n", esp_http_client_get_status_code(evt->client));
         }
@@ -433,11 +589,6 @@ void app_main() {
   ep_width = display.width();
   ep_height = display.height();
   printf("JPGDEC version @bitbank2\n");
-  dither_space = (uint8_t *)heap_caps_malloc(ep_width *16, MALLOC_CAP_SPIRAM);
-  if (dither_space == NULL) {
-      ESP_LOGE("main", "Initial alloc ditherSpace failed!");
-  }
-
   // Should be big enough to allocate the JPEG file size, width * height should suffice
   source_buf = (uint8_t *)heap_caps_malloc(ep_width * ep_height, MALLOC_CAP_SPIRAM);
   if (source_buf == NULL) {